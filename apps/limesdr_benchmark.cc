@@ -0,0 +1,609 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+// Streaming benchmark and soak test of LimeSuite Source/Sink blocks.
+// Every combination of sample rate, channel mode, data format, FIFO size and latency
+// profile is streamed for the given duration and one result record per combination is
+// printed as JSON line or CSV row, so results of different hosts and LimeSuite versions
+// can be compared.
+
+#include <LimeSuite.h>
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/top_block.h>
+#include <limesdr/sink.h>
+#include <limesdr/source.h>
+#include <pmt/pmt.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct options {
+    std::string serial;
+    std::vector<double> rates = {5e6, 10e6, 20e6};
+    // Channel mode of source/sink make(): A(0), B(1), MIMO(2)
+    std::vector<int> modes = {0};
+    // Data format of source/sink make(): F32(0), I16(1), I12(2)
+    std::vector<int> formats = {0};
+    // FIFO size in samples, 0 keeps size chosen by latency profile
+    std::vector<uint32_t> fifo_sizes = {0};
+    // Latency profile: low(0), balanced(1), throughput(2)
+    std::vector<int> profiles = {1};
+    double duration = 10;
+    double warmup = 1;
+    double freq = 1e9;
+    bool loopback = false;
+    // Loopback bursts are timed this long after the newest received sample
+    double lead = 0.01;
+    bool csv = false;
+    // Results file, blocks print their info to stdout
+    std::string output;
+};
+
+const char* mode_names[] = {"A", "B", "MIMO"};
+const char* format_names[] = {"f32", "i16", "i12"};
+const char* profile_names[] = {"low", "balanced", "throughput"};
+
+int find_name(const char* const* names, int count, const std::string& name) {
+    for (int i = 0; i < count; i++)
+        if (name == names[i])
+            return i;
+    std::cerr << "ERROR: limesdr_benchmark: unknown value " << name << std::endl;
+    exit(1);
+}
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+void usage() {
+    std::cout
+        << "Usage: limesdr_benchmark [options]\n"
+           "  --serial SERIAL        device serial (first device if empty)\n"
+           "                         \"mock[:options]\" benchmarks host path without hardware\n"
+           "  --rates R1,R2          sample rates in S/s (default 5e6,10e6,20e6)\n"
+           "  --modes M1,M2          channel modes A,B,MIMO (default A)\n"
+           "  --formats F1,F2        data formats f32,i16,i12 (default f32)\n"
+           "  --fifo S1,S2           FIFO sizes in samples, 0 uses profile size (default 0)\n"
+           "  --profiles P1,P2       latency profiles low,balanced,throughput\n"
+           "                         (default balanced)\n"
+           "  --duration SECONDS     measurement time of each combination (default 10)\n"
+           "  --warmup SECONDS       time streamed before measurement starts (default 1)\n"
+           "  --freq HZ              RX and TX center frequency (default 1e9)\n"
+           "  --loopback             send timed TX bursts and report TX->RX latency of\n"
+           "                         bursts detected in RX (TX connected to RX)\n"
+           "  --lead MS              bursts are timed this long after newest RX sample\n"
+           "                         (default 10)\n"
+           "  --csv                  print CSV instead of JSON lines\n"
+           "  --output FILE          write results to file instead of stdout\n";
+}
+
+options parse_options(int argc, char** argv) {
+    options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--loopback") {
+            opt.loopback = true;
+        } else if (arg == "--csv") {
+            opt.csv = true;
+        } else if (arg == "--help" || arg == "-h") {
+            usage();
+            exit(0);
+        } else if (!has_value) {
+            usage();
+            exit(1);
+        } else if (arg == "--serial") {
+            opt.serial = argv[++i];
+        } else if (arg == "--rates") {
+            opt.rates.clear();
+            for (const std::string& item : split(argv[++i]))
+                opt.rates.push_back(std::stod(item));
+        } else if (arg == "--modes") {
+            opt.modes.clear();
+            for (const std::string& item : split(argv[++i]))
+                opt.modes.push_back(find_name(mode_names, 3, item));
+        } else if (arg == "--formats") {
+            opt.formats.clear();
+            for (const std::string& item : split(argv[++i]))
+                opt.formats.push_back(find_name(format_names, 3, item));
+        } else if (arg == "--fifo") {
+            opt.fifo_sizes.clear();
+            for (const std::string& item : split(argv[++i]))
+                opt.fifo_sizes.push_back(std::stoul(item));
+        } else if (arg == "--profiles") {
+            opt.profiles.clear();
+            for (const std::string& item : split(argv[++i]))
+                opt.profiles.push_back(find_name(profile_names, 3, item));
+        } else if (arg == "--duration") {
+            opt.duration = std::stod(argv[++i]);
+        } else if (arg == "--warmup") {
+            opt.warmup = std::stod(argv[++i]);
+        } else if (arg == "--freq") {
+            opt.freq = std::stod(argv[++i]);
+        } else if (arg == "--lead") {
+            opt.lead = std::stod(argv[++i]) / 1e3;
+        } else if (arg == "--output") {
+            opt.output = argv[++i];
+        } else {
+            usage();
+            exit(1);
+        }
+    }
+    return opt;
+}
+
+// Busy and total jiffies of every core from /proc/stat
+struct cpu_times {
+    std::vector<uint64_t> busy;
+    std::vector<uint64_t> total;
+};
+
+cpu_times read_cpu_times() {
+    cpu_times times;
+    std::ifstream stat("/proc/stat");
+    std::string line;
+    while (std::getline(stat, line)) {
+        // Aggregated "cpu" line is skipped, only "cpuN" lines are used
+        if (line.compare(0, 3, "cpu") != 0 || line.size() < 4 || line[3] == ' ')
+            continue;
+        std::istringstream fields(line.substr(line.find(' ')));
+        uint64_t value, total = 0, idle = 0;
+        for (int i = 0; fields >> value; i++) {
+            total += value;
+            // idle and iowait
+            if (i == 3 || i == 4)
+                idle += value;
+        }
+        times.busy.push_back(total - idle);
+        times.total.push_back(total);
+    }
+    return times;
+}
+
+std::vector<double> cpu_usage(const cpu_times& start, const cpu_times& end) {
+    std::vector<double> usage;
+    for (size_t i = 0; i < std::min(start.total.size(), end.total.size()); i++) {
+        uint64_t total = end.total[i] - start.total[i];
+        usage.push_back(total ? 100.0 * (end.busy[i] - start.busy[i]) / total : 0);
+    }
+    return usage;
+}
+
+// Timed bursts sent by burst_source waiting to be detected by counting_sink
+struct loopback_probe {
+    typedef std::chrono::steady_clock clock;
+
+    struct burst {
+        uint64_t timestamp;
+        clock::time_point sent;
+    };
+
+    std::mutex mutex;
+    std::vector<burst> pending;
+    std::vector<double> latency;
+    uint64_t sent = 0;
+    uint64_t detected = 0;
+    // Device timestamp of the newest received sample, 0 until first rx_time tag
+    std::atomic<uint64_t> rx_timestamp{0};
+};
+
+// Full scale of integer formats: I16 is scaled to 16 bits, I12 keeps 12-bit range
+float full_scale(int format) { return (format == 1) ? 32767.0f : 2047.0f; }
+
+// Peak of one sample relative to full scale in any stream format
+float sample_peak(const void* items, int format, int index) {
+    if (format == 0) {
+        const float* iq = static_cast<const float*>(items) + 2 * index;
+        return std::max(std::abs(iq[0]), std::abs(iq[1]));
+    }
+    const int16_t* iq = static_cast<const int16_t*>(items) + 2 * index;
+    return std::max(std::abs(iq[0]), std::abs(iq[1])) / full_scale(format);
+}
+
+// Counts received samples and finds dropped samples from rx_time tags of every channel:
+// source tags every timestamp discontinuity, so samples missing between tags were dropped.
+// With loopback probe, rising edges of channel 0 are matched against sent bursts.
+class counting_sink : public gr::sync_block {
+    public:
+#ifdef LIMESDR_GR_STD_SPTR
+    typedef std::shared_ptr<counting_sink> sptr;
+#else
+    typedef boost::shared_ptr<counting_sink> sptr;
+#endif
+
+    counting_sink(int channels, int format, double rate, loopback_probe* probe)
+        : gr::sync_block("counting_sink",
+                         gr::io_signature::make(channels,
+                                                channels,
+                                                (format == 0) ? 2 * sizeof(float)
+                                                              : 2 * sizeof(int16_t)),
+                         gr::io_signature::make(0, 0, 0)),
+          format(format),
+          rate(rate),
+          probe(probe) {}
+
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> dropped{0};
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items) {
+        for (size_t i = 0; i < input_items.size(); i++) {
+            channel_data& ch = channel[i];
+            tags.clear();
+            get_tags_in_range(tags, i, nitems_read(i), nitems_read(i) + noutput_items, TIME_TAG);
+            for (const gr::tag_t& tag : tags) {
+                uint64_t secs = pmt::to_uint64(pmt::tuple_ref(tag.value, 0));
+                double fracs = pmt::to_double(pmt::tuple_ref(tag.value, 1));
+                int64_t timestamp = llround(secs * rate + fracs * rate);
+                if (ch.tagged) {
+                    int64_t missing =
+                        timestamp - ch.base_timestamp - (int64_t)(tag.offset - ch.base_offset);
+                    if (missing > 0)
+                        dropped += missing;
+                }
+                ch.tagged = true;
+                ch.base_timestamp = timestamp;
+                ch.base_offset = tag.offset;
+            }
+        }
+        if (probe && channel[0].tagged)
+            this->detect(input_items[0], noutput_items);
+        samples += noutput_items;
+        return noutput_items;
+    }
+
+    private:
+    const pmt::pmt_t TIME_TAG = pmt::string_to_symbol("rx_time");
+    // Bursts are sent at 0.7 of full scale
+    const float threshold = 0.25f;
+    std::vector<gr::tag_t> tags;
+    int format;
+    double rate;
+    loopback_probe* probe;
+    struct channel_data {
+        bool tagged = false;
+        int64_t base_timestamp = 0;
+        uint64_t base_offset = 0;
+    } channel[2];
+    bool above = false;
+
+    uint64_t timestamp_of(uint64_t offset) const {
+        return channel[0].base_timestamp + (offset - channel[0].base_offset);
+    }
+
+    void detect(const void* items, int count) {
+        uint64_t first = nitems_read(0);
+        probe->rx_timestamp = this->timestamp_of(first + count);
+        for (int i = 0; i < count; i++) {
+            bool high = sample_peak(items, format, i) > threshold;
+            if (high && !above)
+                this->match(this->timestamp_of(first + i));
+            above = high;
+        }
+    }
+
+    // Edge within 1 ms of burst tx_time is the burst, bursts left behind were lost
+    void match(uint64_t timestamp) {
+        auto now = loopback_probe::clock::now();
+        uint64_t tolerance = (uint64_t)(rate / 1e3);
+        std::lock_guard<std::mutex> lock(probe->mutex);
+        auto it = probe->pending.begin();
+        while (it != probe->pending.end() && it->timestamp + tolerance < timestamp)
+            it = probe->pending.erase(it);
+        if (it == probe->pending.end() || it->timestamp > timestamp + tolerance)
+            return;
+        probe->latency.push_back(std::chrono::duration<double>(now - it->sent).count());
+        probe->detected++;
+        probe->pending.erase(it);
+    }
+};
+
+// Sends timed bursts of constant amplitude every interval on all channels once device time
+// is known from received samples
+class burst_source : public gr::sync_block {
+    public:
+#ifdef LIMESDR_GR_STD_SPTR
+    typedef std::shared_ptr<burst_source> sptr;
+#else
+    typedef boost::shared_ptr<burst_source> sptr;
+#endif
+
+    burst_source(int channels, int format, double rate, double lead, loopback_probe* probe)
+        : gr::sync_block("burst_source",
+                         gr::io_signature::make(0, 0, 0),
+                         gr::io_signature::make(channels,
+                                                channels,
+                                                (format == 0) ? 2 * sizeof(float)
+                                                              : 2 * sizeof(int16_t))),
+          channels(channels),
+          format(format),
+          rate(rate),
+          lead((uint64_t)(lead * rate)),
+          length((uint64_t)(rate / 1e3)),
+          probe(probe) {}
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items) {
+        if (remaining == 0) {
+            auto now = loopback_probe::clock::now();
+            uint64_t rx_timestamp = probe->rx_timestamp;
+            if (rx_timestamp == 0 || now < next_burst) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                return 0;
+            }
+            next_burst = now + interval;
+            this->start_burst(rx_timestamp + lead, now);
+        }
+        int items = (int)std::min<uint64_t>(noutput_items, remaining);
+        for (size_t i = 0; i < output_items.size(); i++)
+            this->fill(output_items[i], items);
+        remaining -= items;
+        if (remaining == 0)
+            for (size_t i = 0; i < output_items.size(); i++)
+                add_item_tag(i, nitems_written(i) + items - 1, EOB_TAG, pmt::PMT_T);
+        return items;
+    }
+
+    private:
+    const pmt::pmt_t TIME_TAG = pmt::string_to_symbol("tx_time");
+    const pmt::pmt_t SOB_TAG = pmt::string_to_symbol("tx_sob");
+    const pmt::pmt_t EOB_TAG = pmt::string_to_symbol("tx_eob");
+    const std::chrono::milliseconds interval{100};
+    int channels;
+    int format;
+    double rate;
+    uint64_t lead;
+    uint64_t length;
+    loopback_probe* probe;
+    uint64_t remaining = 0;
+    loopback_probe::clock::time_point next_burst;
+
+    void start_burst(uint64_t timestamp, loopback_probe::clock::time_point now) {
+        uint64_t secs = (uint64_t)(timestamp / rate);
+        pmt::pmt_t time =
+            pmt::make_tuple(pmt::from_uint64(secs), pmt::from_double(timestamp / rate - secs));
+        for (int i = 0; i < channels; i++) {
+            add_item_tag(i, nitems_written(i), SOB_TAG, pmt::PMT_T);
+            add_item_tag(i, nitems_written(i), TIME_TAG, time);
+        }
+        remaining = length;
+        std::lock_guard<std::mutex> lock(probe->mutex);
+        probe->pending.push_back({timestamp, now});
+        probe->sent++;
+    }
+
+    void fill(void* items, int count) {
+        if (format == 0) {
+            float* iq = static_cast<float*>(items);
+            std::fill(iq, iq + 2 * count, 0.7f);
+        } else {
+            int16_t* iq = static_cast<int16_t*>(items);
+            std::fill(iq, iq + 2 * count, (int16_t)(0.7f * full_scale(format)));
+        }
+    }
+};
+
+struct result {
+    double rate;
+    int mode;
+    int format;
+    uint32_t fifo_size;
+    int profile;
+    // Sample rate set on device
+    double actual_rate = 0;
+    double elapsed = 0;
+    uint64_t samples = 0;
+    uint64_t dropped = 0;
+    uint64_t underruns = 0;
+    uint64_t bursts_sent = 0;
+    uint64_t bursts_detected = 0;
+    std::vector<double> latency;
+    std::vector<double> cpu;
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty())
+        return NAN;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p / 100 * values.size()))];
+}
+
+result run(const options& opt, double rate, int mode, int format, uint32_t fifo, int profile) {
+    result res;
+    res.rate = rate;
+    res.mode = mode;
+    res.format = format;
+    res.fifo_size = fifo;
+    res.profile = profile;
+    int channels = (mode == 2) ? 2 : 1;
+
+    gr::top_block_sptr tb = gr::make_top_block("limesdr_benchmark");
+    gr::limesdr::source::sptr source =
+        gr::limesdr::source::make(opt.serial, mode, "", false, format);
+    source->set_latency_profile(profile);
+    if (fifo > 0)
+        source->set_buffer_size(fifo);
+    // Device may not reach requested rate exactly, drops are counted at its rate
+    res.actual_rate = source->set_sample_rate(rate);
+    source->set_center_freq(opt.freq);
+    loopback_probe probe;
+    counting_sink::sptr counter(
+        new counting_sink(channels, format, res.actual_rate, opt.loopback ? &probe : nullptr));
+    for (int i = 0; i < channels; i++)
+        tb->connect(source, i, counter, i);
+
+    gr::limesdr::sink::sptr sink;
+    if (opt.loopback) {
+        sink = gr::limesdr::sink::make(opt.serial, mode, "", "", format);
+        sink->set_latency_profile(profile);
+        if (fifo > 0)
+            sink->set_buffer_size(fifo);
+        sink->set_sample_rate(rate);
+        sink->set_center_freq(opt.freq);
+        burst_source::sptr bursts(
+            new burst_source(channels, format, res.actual_rate, opt.lead, &probe));
+        for (int i = 0; i < channels; i++)
+            tb->connect(bursts, i, sink, i);
+    }
+
+    tb->start();
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.warmup));
+
+    uint64_t samples_start = counter->samples;
+    uint64_t dropped_start = counter->dropped;
+    uint64_t underruns_start = sink ? sink->get_underruns() : 0;
+    cpu_times cpu_start = read_cpu_times();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(opt.duration));
+    {
+        // Bursts of warmup are not measured
+        std::lock_guard<std::mutex> lock(probe.mutex);
+        probe.latency.clear();
+        probe.sent = probe.detected = 0;
+    }
+    // Without loopback RX latency is measured by the source once per second, sample it
+    // more often to get its distribution over the run
+    while (std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!opt.loopback)
+            res.latency.push_back(source->get_stream_latency());
+    }
+    res.elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    res.samples = counter->samples - samples_start;
+    res.dropped = counter->dropped - dropped_start;
+    res.underruns = sink ? sink->get_underruns() - underruns_start : 0;
+    res.cpu = cpu_usage(cpu_start, read_cpu_times());
+    if (opt.loopback) {
+        std::lock_guard<std::mutex> lock(probe.mutex);
+        res.latency = probe.latency;
+        res.bursts_sent = probe.sent;
+        res.bursts_detected = probe.detected;
+    }
+
+    tb->stop();
+    tb->wait();
+    return res;
+}
+
+void print_csv_header(std::ostream& out) {
+    out << "rate,actual_rate,mode,format,fifo,profile,elapsed_s,msps,samples,dropped,drop_rate,"
+           "underruns,bursts_sent,bursts_detected,latency_p50_ms,latency_p90_ms,latency_p99_ms,"
+           "latency_max_ms,cpu_percent"
+        << std::endl;
+}
+
+void print_result(std::ostream& out, const options& opt, const result& res) {
+    double msps = res.samples / res.elapsed / 1e6;
+    // Samples are counted per channel, drops of all channels
+    uint64_t expected = res.samples * ((res.mode == 2) ? 2 : 1) + res.dropped;
+    double drop_rate = expected ? (double)res.dropped / expected : 0;
+    double p50 = percentile(res.latency, 50) * 1e3;
+    double p90 = percentile(res.latency, 90) * 1e3;
+    double p99 = percentile(res.latency, 99) * 1e3;
+    double max = percentile(res.latency, 100) * 1e3;
+    std::ostringstream cpu;
+    for (size_t i = 0; i < res.cpu.size(); i++)
+        cpu << (i ? (opt.csv ? ";" : ",") : "") << std::round(res.cpu[i] * 10) / 10;
+
+    if (opt.csv) {
+        out << res.rate << "," << res.actual_rate << "," << mode_names[res.mode] << ","
+            << format_names[res.format] << "," << res.fifo_size << ","
+            << profile_names[res.profile] << "," << res.elapsed << "," << msps << ","
+            << res.samples << "," << res.dropped << "," << drop_rate << "," << res.underruns
+            << "," << res.bursts_sent << "," << res.bursts_detected << "," << p50 << "," << p90
+            << "," << p99 << "," << max << "," << cpu.str() << std::endl;
+        return;
+    }
+    out << "{\"rate\":" << res.rate << ",\"actual_rate\":" << res.actual_rate
+        << ",\"mode\":\"" << mode_names[res.mode]
+        << "\",\"format\":\"" << format_names[res.format] << "\",\"fifo\":" << res.fifo_size
+        << ",\"profile\":\"" << profile_names[res.profile] << "\",\"elapsed_s\":" << res.elapsed
+        << ",\"msps\":" << msps << ",\"samples\":" << res.samples
+        << ",\"dropped\":" << res.dropped << ",\"drop_rate\":" << drop_rate
+        << ",\"underruns\":" << res.underruns;
+    if (opt.loopback)
+        out << ",\"bursts_sent\":" << res.bursts_sent
+            << ",\"bursts_detected\":" << res.bursts_detected;
+    // NaN is not valid JSON
+    if (!res.latency.empty())
+        out << ",\"latency_ms\":{\"p50\":" << p50 << ",\"p90\":" << p90 << ",\"p99\":" << p99
+            << ",\"max\":" << max << "}";
+    out << ",\"cpu_percent\":[" << cpu.str() << "]}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    options opt = parse_options(argc, argv);
+
+    std::ofstream file;
+    if (!opt.output.empty()) {
+        file.open(opt.output);
+        if (!file) {
+            std::cerr << "ERROR: limesdr_benchmark: can't open " << opt.output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = opt.output.empty() ? std::cout : file;
+
+    char host[256] = {0};
+    gethostname(host, sizeof(host) - 1);
+    // Leading record identifies host and LimeSuite version of the results
+    if (opt.csv) {
+        out << "# host " << host << ", LimeSuite " << LMS_GetLibraryVersion() << ", loopback "
+            << (opt.loopback ? "on" : "off") << std::endl;
+        print_csv_header(out);
+    } else {
+        out << "{\"host\":\"" << host << "\",\"limesuite\":\"" << LMS_GetLibraryVersion()
+            << "\",\"loopback\":" << (opt.loopback ? "true" : "false") << "}" << std::endl;
+    }
+
+    for (int profile : opt.profiles)
+        for (uint32_t fifo : opt.fifo_sizes)
+            for (int format : opt.formats)
+                for (int mode : opt.modes)
+                    for (double rate : opt.rates)
+                        print_result(out, opt, run(opt, rate, mode, format, fifo, profile));
+    return 0;
+}
@@ -23,6 +23,12 @@
 
 #include <gnuradio/attributes.h>
 
+// GNU Radio 3.9 and later hold blocks in std::shared_ptr instead of boost::shared_ptr,
+// LIMESDR_GR_STD_SPTR is defined by the build when compiling against them
+#ifdef LIMESDR_GR_STD_SPTR
+#include <memory>
+#endif
+
 #ifdef gnuradio_limesdr_EXPORTS
 #define LIMESDR_API __GR_ATTR_EXPORT
 #else
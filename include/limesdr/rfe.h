@@ -25,6 +25,7 @@
 #include <limesdr/api.h>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace gr {
 namespace limesdr {
@@ -82,6 +83,37 @@ public:
      * @return 0 on success, other on failure (see LimeRFE error codes)
      */
     int set_notch(int enable);
+    /**
+     * Enable or disable TDD mode switching. When enabled LimeSDR sink switches LimeRFE to TX
+     * at the start of every burst and back to RX after the burst has been transmitted.
+     *
+     * @param   enable TDD state: 0 - disable; 1 - enable
+     *
+     * @note GPIO communication is recommended, USB switching latency is much higher
+     * @return 0 on success, other on failure
+     */
+    int set_tdd(int enable);
+    /**
+     * Get duration of the last TDD mode switch
+     *
+     * @return switch duration in microseconds
+     */
+    double get_tdd_latency();
+    /**
+     * Get the longest TDD mode switch duration since TDD has been enabled
+     *
+     * @return switch duration in microseconds
+     */
+    double get_tdd_max_latency();
+    /**
+     * Get LimeRFE board state cached by the device handler health monitor, so the board is
+     * not accessed by the call. Monitor is started by LimeSuite Source/Sink
+     * set_health_monitor().
+     *
+     * @return RX channel, TX channel, RX port, TX port, mode, notch, attenuation, enable SWR
+     * and SWR source, empty if the board has not been polled yet
+     */
+    std::vector<int> get_cached_state();
 
 private:
     rfe_dev_t* rfe_dev = nullptr;
@@ -95,6 +127,8 @@ private:
                                   0,
                                   0 };
     int sdr_device_num = 0;
+    int comm_type = 0;
+    bool tdd = false;
 
     void print_error(int error);
 
@@ -28,7 +28,11 @@ namespace gr {
 namespace limesdr {
 class LIMESDR_API sink : virtual public gr::block {
     public:
+#ifdef LIMESDR_GR_STD_SPTR
+    typedef std::shared_ptr<sink> sptr;
+#else
     typedef boost::shared_ptr<sink> sptr;
+#endif
     /*!
      * @brief Return a shared_ptr to a new instance of sink.
      *
@@ -42,14 +46,19 @@ class LIMESDR_API sink : virtual public gr::block {
      *
      * @param filename Path to file if file switch is turned on.
      *
-     * @param length_tag_name Name of stream burst length tag
+     * @param length_tag_name Name of stream burst length tag. Bursts can also be marked
+     * with tx_sob and tx_eob tags, tx_time tag sets burst transmit time.
+     *
+     * @param data_format Stream data format: F32(0), I16(1), I12(2).
+     * F32 inputs gr_complex, I16 and I12 input interleaved int16 I/Q (sc16).
      *
      * @return a new limesdr sink block object
      */
     static sptr make(std::string serial,
                      int channel_mode,
                      const std::string& filename,
-                     const std::string& length_tag_name);
+                     const std::string& length_tag_name,
+                     int data_format = 0);
     /**
      * Set center frequency
      *
@@ -122,7 +131,7 @@ class LIMESDR_API sink : virtual public gr::block {
      */
     virtual double set_sample_rate(double rate) = 0;
     /**
-     * Set oversampling for both channels.
+     * Set oversampling for both channels. Invalid value is reported and nothing is changed.
      *
      * @param oversample Oversampling value (0 (default),1,2,4,8,16,32).
      */
@@ -135,12 +144,193 @@ class LIMESDR_API sink : virtual public gr::block {
      * @param   channel  Channel selection: A(LMS_CH_0),B(LMS_CH_1).
      */
     virtual void calibrate(double bandw, int channel = 0) = 0;
+    /**
+     * Reuse DC/IQ corrections of previous calibration at the same LO, bandwidth and
+     * gain band instead of running full calibration. Corrections are stored per board
+     * serial on disk and invalidated when they age out (one week) or chip temperature
+     * changes. Setting applies to the whole device and must be set before calibrate().
+     *
+     * @param   enable  Enable or disable calibration cache.
+     */
+    virtual void set_calibration_cache(bool enable) = 0;
+    /**
+     * Save device registers and settings to binary snapshot file. Snapshot is
+     * restored by passing file with .snap extension as block settings file,
+     * which is much faster than loading .ini file.
+     *
+     * @param   filename  Path to snapshot file.
+     *
+     * @return  true if success
+     */
+    virtual bool save_snapshot(const std::string& filename) = 0;
     /**
      * Set stream buffer size
      *
      * @param   size FIFO buffer size in samples
      */
     virtual void set_buffer_size(uint32_t size) = 0;
+    /**
+     * Set stream latency profile.
+     * Profile selects throughputVsLatency and FIFO size of the stream,
+     * when changed while streaming the stream is rebuilt.
+     *
+     * @param   profile  Low latency(0), Balanced(1, default), Max throughput(2)
+     */
+    virtual void set_latency_profile(int profile) = 0;
+    /**
+     * Override throughputVsLatency value selected by latency profile.
+     * When changed while streaming the stream is rebuilt.
+     *
+     * @param   value  Optimize stream for latency(0.0) - throughput(1.0), -1 uses profile value.
+     */
+    virtual void set_throughput_vs_latency(double value) = 0;
+    /**
+     * Get throughputVsLatency value used by the stream.
+     *
+     * @return  effective throughputVsLatency value
+     */
+    virtual double get_throughput_vs_latency() = 0;
+    /**
+     * Get FIFO size used by the stream.
+     *
+     * @return  effective FIFO size in samples
+     */
+    virtual uint32_t get_fifo_size() = 0;
+    /**
+     * Get measured stream latency.
+     * TX latency is the time between sample entering the block and leaving
+     * the device. Sum of source and sink latency gives round-trip latency.
+     *
+     * @return  latency in seconds
+     */
+    virtual double get_stream_latency() = 0;
+    /**
+     * Set rate of stream status reports published on "telemetry" message port.
+     * Report is a dictionary with fifoFilledCount, fifoSize, underrun, overrun,
+     * droppedPackets (counted since previous report), linkRate, timestamp and channel.
+     * Status is not collected when the port is not connected.
+     *
+     * @param   rate_hz  Reports per second per channel, 0 disables reports (default 1).
+     */
+    virtual void set_telemetry_rate(double rate_hz) = 0;
+    /**
+     * @return  telemetry report rate in Hz
+     */
+    virtual double get_telemetry_rate() = 0;
+    /**
+     * Start background health monitor of device handler. LimeSuite chip temperature,
+     * reference clock and CGEN PLL lock of every open device and LimeRFE board state are
+     * polled at a low rate into a cached snapshot, so getters and reports don't access the
+     * hardware. Monitor is shared by all blocks, the last set rate applies.
+     * Snapshot is published on "health" message port as a dictionary with sequence, time,
+     * temperature, ref_clk, ext_clk, cgen_locked and rfe_mode, rfe_channel_rx,
+     * rfe_channel_tx, rfe_attenuation, rfe_notch when LimeRFE is used.
+     *
+     * @param   rate_hz  Polls per second (max 10), 0 stops the monitor.
+     */
+    virtual void set_health_monitor(double rate_hz) = 0;
+    /**
+     * @return  cached LMS7002M chip temperature in degrees Celsius, NaN if not polled yet
+     */
+    virtual double get_temperature() = 0;
+    /**
+     * @return  cached CGEN PLL lock state, false if not polled yet
+     */
+    virtual bool get_clock_locked() = 0;
+    /**
+     * Pre-tune LO synthesizer to every frequency of the list and cache its register state.
+     * Hops to table entries then only write cached LMS7002M SX registers,
+     * which is much faster than a full retune. Current frequency is kept.
+     *
+     * @param   freqs  RF frequencies in Hz.
+     *
+     * @return  number of hop table entries
+     */
+    virtual int set_hop_table(const std::vector<double>& freqs) = 0;
+    /**
+     * Retune to hop table entry. Hops can also be triggered by "hop" message port
+     * with entry index as integer or as value of "hop" key in a dictionary,
+     * or by "tx_hop" stream tag, which hops before the tagged sample is sent.
+     *
+     * @param   index  Hop table entry index.
+     *
+     * @return  RF frequency of the entry in Hz, 0 if index is invalid
+     */
+    virtual double hop(int index) = 0;
+    /**
+     * @return  time spent on the last hop in seconds
+     */
+    virtual double get_last_hop_duration() = 0;
+    /**
+     * @return  number of hops done
+     */
+    virtual uint64_t get_hop_count() = 0;
+    /**
+     * Enable TX staging mode.
+     * general_work only copies samples into a host ring buffer and a feeder thread sends
+     * them in whole packets, keeping device FIFO filled to the target level, so bursty
+     * upstream blocks don't run the FIFO dry. Stream tags are not used in this mode.
+     *
+     * @note Setting is applied when stream is started.
+     *
+     * @param   enable      Enable(true) or disable(false) TX staging mode.
+     *
+     * @param   ring_size   Ring buffer size in samples per channel (0 - quarter of sample rate).
+     *
+     * @param   fill_level  Target device FIFO fill as fraction of FIFO size (0-1].
+     *
+     * @param   cpu         CPU core feeder thread is pinned to (-1 - not pinned).
+     */
+    virtual void
+    set_tx_thread(bool enable, uint32_t ring_size = 0, double fill_level = 0.5, int cpu = -1) = 0;
+    /**
+     * Get ring buffer size used in TX staging mode.
+     *
+     * @return  ring buffer size in samples per channel
+     */
+    virtual uint32_t get_ring_size() = 0;
+    /**
+     * Get number of device FIFO underruns since stream start.
+     *
+     * @return  underrun count
+     */
+    virtual uint64_t get_underruns() = 0;
+    /**
+     * Set what is done with bursts whose tx_time is already in the past compared to
+     * device hardware time. Every late burst is reported on "late" message port
+     * as a dictionary with late_count, lateness_us, timestamp and policy keys.
+     *
+     * @param   policy  Send immediately without timestamp(0, default), drop burst(1),
+     *                  shift this and all later bursts by the lateness(2).
+     */
+    virtual void set_late_policy(int policy) = 0;
+    /**
+     * @return  number of late bursts since stream start
+     */
+    virtual uint64_t get_late_count() = 0;
+    /**
+     * @return  lateness of the last late burst in microseconds
+     */
+    virtual double get_last_lateness() = 0;
+    /**
+     * Start streams of this block together with all other blocks that enabled
+     * synchronized start, possibly on different devices sharing reference clock and PPS.
+     * Streams are armed in start() and the last armed block starts all of them,
+     * enables PPS mode on every device (sample counters reset on each PPS edge)
+     * and measures timestamp offsets between devices on the next PPS edge.
+     * Must be set before the flowgraph is started.
+     * @note tx_time is then relative to the last PPS edge.
+     *
+     * @param   enable    Enable or disable synchronized start.
+     *
+     * @param   fref_MHz  External reference clock frequency in MHz (0 keeps current clock).
+     */
+    virtual void set_sync_start(bool enable, double fref_MHz = 0) = 0;
+    /**
+     * @return  timestamp offset of every device in synchronized start group
+     *          to the first one in samples, measured on last synchronized start
+     */
+    virtual std::vector<double> get_sync_offsets() = 0;
     /**
      * Set TCXO DAC.
      * @note Care must be taken as this parameter is returned to default value only after power off.
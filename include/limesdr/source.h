@@ -28,7 +28,11 @@ namespace gr {
 namespace limesdr {
 class LIMESDR_API source : virtual public gr::block {
     public:
+#ifdef LIMESDR_GR_STD_SPTR
+    typedef std::shared_ptr<source> sptr;
+#else
     typedef boost::shared_ptr<source> sptr;
+#endif
 
     /*!
      * @brief Return a shared_ptr to a new instance of source.
@@ -43,10 +47,18 @@ class LIMESDR_API source : virtual public gr::block {
      *
      * @param filename Path to file if file switch is turned on.
      *
+     * @param enable_PPS_mode Report raw PPS sample counter instead of LimeSDR timestamps.
+     *
+     * @param data_format Stream data format: F32(0), I16(1), I12(2).
+     * F32 outputs gr_complex, I16 and I12 output interleaved int16 I/Q (sc16).
+     *
      * @return a new limesdr source block object
      */
-    static sptr
-    make(std::string serial, int channel_mode, const std::string& filename, bool enable_PPS_mode);
+    static sptr make(std::string serial,
+                     int channel_mode,
+                     const std::string& filename,
+                     bool enable_PPS_mode,
+                     int data_format = 0);
 
     virtual bool set_ext_clk(double fref_Mhz) = 0;
     virtual bool disable_ext_clk() = 0;
@@ -122,11 +134,36 @@ class LIMESDR_API source : virtual public gr::block {
      */
     virtual double set_sample_rate(double rate) = 0;
     /**
-     * Set oversampling for both channels.
+     * Set oversampling for both channels. Invalid value is reported and nothing is changed,
+     * also rejected while channelizer is on, its decimation sets oversampling.
      *
      * @param oversample Oversampling value (0 (default),1,2,4,8,16,32).
      */
     virtual void set_oversampling(int oversample) = 0;
+
+    /**
+     * Configure hardware channelizer of the channel. LMS7002M decimates samples, channel NCO
+     * moves channel frequency to baseband and GFIR limits channel bandwidth, so the host
+     * receives only the narrowband channel. Sample rate set before is the monitored band
+     * around LO, output sample rate is sample rate / decimation.
+     * Following set_sample_rate() and set_center_freq() calls keep the channels in place.
+     * rx_freq and rx_rate tags follow channelizer settings.
+     *
+     * @param   channel_freq  Center frequency of the channel in Hz. Channel must fit into
+     *                        monitored band.
+     *
+     * @param   bandwidth     GFIR bandwidth in Hz, 0 leaves GFIR off.
+     *
+     * @param   decimation    Hardware decimation (1,2,4,8,16,32) shared by both channels.
+     *                        0 turns channelizer of the channel off, sample rate is restored
+     *                        when no channel is left.
+     *
+     * @param   channel       Channel selection: A(LMS_CH_0),B(LMS_CH_1).
+     *
+     * @return  output sample rate in S/s
+     */
+    virtual double
+    set_channelizer(double channel_freq, double bandwidth, int decimation, int channel = 0) = 0;
     /**
      * Perform device calibration.
      *
@@ -135,12 +172,300 @@ class LIMESDR_API source : virtual public gr::block {
      * @param   channel  Channel selection: A(LMS_CH_0),B(LMS_CH_1).
      */
     virtual void calibrate(double bandw, int channel = 0) = 0;
+    /**
+     * Reuse DC/IQ corrections of previous calibration at the same LO, bandwidth and
+     * gain band instead of running full calibration. Corrections are stored per board
+     * serial on disk and invalidated when they age out (one week) or chip temperature
+     * changes. Setting applies to the whole device and must be set before calibrate().
+     *
+     * @param   enable  Enable or disable calibration cache.
+     */
+    virtual void set_calibration_cache(bool enable) = 0;
+
+    /**
+     * Correct DC offset and IQ imbalance left after on-chip corrections in host, in place on
+     * output buffer (complex float output only). Estimates start from the state after
+     * calibrate() or retune with fast acquisition and are then tracked slowly.
+     *
+     * @param   enable         Enable or disable host side correction.
+     *
+     * @param   tracking_step  Tracking step, every 10 ms of samples. 0 freezes estimates
+     *                         after acquisition.
+     */
+    virtual void set_iq_correction(bool enable, float tracking_step = 0.01) = 0;
+
+    /**
+     * Get current host side correction estimates of the channel.
+     *
+     * @param   channel  Channel selection: A(LMS_CH_0),B(LMS_CH_1).
+     *
+     * @return  DC offset and IQ imbalance coefficient w, samples are corrected
+     *          as x + w * conj(x) - DC correction
+     */
+    virtual std::vector<gr_complex> get_iq_correction(int channel = 0) = 0;
+    /**
+     * Save device registers and settings to binary snapshot file. Snapshot is
+     * restored by passing file with .snap extension as block settings file,
+     * which is much faster than loading .ini file.
+     *
+     * @param   filename  Path to snapshot file.
+     *
+     * @return  true if success
+     */
+    virtual bool save_snapshot(const std::string& filename) = 0;
     /**
      * Set stream buffer size
      *
      * @param   size FIFO buffer size in samples
      */
     virtual void set_buffer_size(uint32_t size) = 0;
+    /**
+     * Enable dedicated RX reader thread.
+     * Reader thread drains device into ring buffer and general_work only copies samples from
+     * it, so LimeSuite FIFO doesn't overflow when downstream blocks stall for a moment.
+     *
+     * @note Setting is applied when stream is started.
+     *
+     * @param   enable     Enable(true) or disable(false) RX reader thread.
+     *
+     * @param   ring_size  Ring buffer size in samples per channel (0 - quarter of sample rate).
+     *
+     * @param   cpu        CPU core reader thread is pinned to (-1 - not pinned).
+     */
+    virtual void set_rx_thread(bool enable, uint32_t ring_size = 0, int cpu = -1) = 0;
+    /**
+     * Get ring buffer size used by RX reader thread.
+     *
+     * @return  ring buffer size in samples per channel
+     */
+    virtual uint32_t get_ring_size() = 0;
+    /**
+     * Get number of times ring buffer overflowed since stream start.
+     *
+     * @return  ring buffer overflow count
+     */
+    virtual uint64_t get_ring_overflows() = 0;
+    /**
+     * Get number of samples dropped because ring buffer was full.
+     *
+     * @return  dropped sample count per channel
+     */
+    virtual uint64_t get_ring_dropped_samples() = 0;
+    /**
+     * Record raw complex int16 samples straight to disk instead of output ports.
+     * Recording thread receives samples directly into aligned disk buffers written
+     * with O_DIRECT, so no float conversion, GNU Radio buffer or page cache is involved.
+     * MIMO channels are written to filename_ch0 and filename_ch1 (before extension).
+     * Serial, frequency, sample rate, start timestamp, timestamp gaps and stream
+     * status drops are written to filename.json when recording stops.
+     *
+     * @note Setting is applied when stream is started, block doesn't produce
+     * output samples while recording.
+     *
+     * @param   filename  Capture file to create, empty string disables recording.
+     */
+    virtual void set_recording(const std::string& filename) = 0;
+    /**
+     * Get number of samples written to capture file since stream start.
+     *
+     * @return  recorded sample count per channel
+     */
+    virtual uint64_t get_recorded_samples() = 0;
+    /**
+     * Get number of samples discarded because disk didn't keep up with the stream.
+     *
+     * @return  discarded sample count per channel
+     */
+    virtual uint64_t get_recording_dropped_samples() = 0;
+    /**
+     * Set stream latency profile.
+     * Profile selects throughputVsLatency and FIFO size of the stream,
+     * when changed while streaming the stream is rebuilt.
+     *
+     * @param   profile  Low latency(0), Balanced(1, default), Max throughput(2)
+     */
+    virtual void set_latency_profile(int profile) = 0;
+    /**
+     * Override throughputVsLatency value selected by latency profile.
+     * When changed while streaming the stream is rebuilt.
+     *
+     * @param   value  Optimize stream for latency(0.0) - throughput(1.0), -1 uses profile value.
+     */
+    virtual void set_throughput_vs_latency(double value) = 0;
+    /**
+     * Get throughputVsLatency value used by the stream.
+     *
+     * @return  effective throughputVsLatency value
+     */
+    virtual double get_throughput_vs_latency() = 0;
+    /**
+     * Get FIFO size used by the stream.
+     *
+     * @return  effective FIFO size in samples
+     */
+    virtual uint32_t get_fifo_size() = 0;
+    /**
+     * Get measured stream latency.
+     * RX latency is the time between sample arriving at the device and leaving
+     * the block. Sum of source and sink latency gives round-trip latency.
+     *
+     * @return  latency in seconds
+     */
+    virtual double get_stream_latency() = 0;
+    /**
+     * Set rate of stream status reports published on "telemetry" message port.
+     * Report is a dictionary with fifoFilledCount, fifoSize, underrun, overrun,
+     * droppedPackets (counted since previous report), linkRate, timestamp and channel.
+     * Status is not collected when the port is not connected.
+     *
+     * @param   rate_hz  Reports per second per channel, 0 disables reports (default 1).
+     */
+    virtual void set_telemetry_rate(double rate_hz) = 0;
+    /**
+     * @return  telemetry report rate in Hz
+     */
+    virtual double get_telemetry_rate() = 0;
+    /**
+     * Start background health monitor of device handler. LimeSuite chip temperature,
+     * reference clock and CGEN PLL lock of every open device and LimeRFE board state are
+     * polled at a low rate into a cached snapshot, so getters and reports don't access the
+     * hardware. Monitor is shared by all blocks, the last set rate applies.
+     * Snapshot is published on "health" message port as a dictionary with sequence, time,
+     * temperature, ref_clk, ext_clk, cgen_locked and rfe_mode, rfe_channel_rx,
+     * rfe_channel_tx, rfe_attenuation, rfe_notch when LimeRFE is used.
+     *
+     * @param   rate_hz  Polls per second (max 10), 0 stops the monitor.
+     */
+    virtual void set_health_monitor(double rate_hz) = 0;
+    /**
+     * @return  cached LMS7002M chip temperature in degrees Celsius, NaN if not polled yet
+     */
+    virtual double get_temperature() = 0;
+    /**
+     * @return  cached CGEN PLL lock state, false if not polled yet
+     */
+    virtual bool get_clock_locked() = 0;
+    /**
+     * Pre-tune LO synthesizer to every frequency of the list and cache its register state.
+     * Hops to table entries then only write cached LMS7002M SX registers,
+     * which is much faster than a full retune. Current frequency is kept.
+     *
+     * @param   freqs  RF frequencies in Hz.
+     *
+     * @return  number of hop table entries
+     */
+    virtual int set_hop_table(const std::vector<double>& freqs) = 0;
+    /**
+     * Retune to hop table entry. Hops can also be triggered by "hop" message port
+     * with entry index as integer or as value of "hop" key in a dictionary.
+     *
+     * @param   index  Hop table entry index.
+     *
+     * @return  RF frequency of the entry in Hz, 0 if index is invalid
+     */
+    virtual double hop(int index) = 0;
+    /**
+     * Schedule hop at given device time, see set_center_freq_at().
+     *
+     * @param   index    Hop table entry index.
+     *
+     * @param   rx_time  Device time in seconds, same time base as rx_time tags.
+     */
+    virtual void hop_at(int index, double rx_time) = 0;
+    /**
+     * @return  time spent on the last hop in seconds
+     */
+    virtual double get_last_hop_duration() = 0;
+    /**
+     * @return  number of hops done
+     */
+    virtual uint64_t get_hop_count() = 0;
+    /**
+     * Emit rx_freq and rx_rate tags together with every rx_time tag.
+     * Tag values are prepared when frequency or sample rate is changed,
+     * so tagging on the receive path doesn't build them.
+     *
+     * @param   enable  Emit rx_time, rx_freq and rx_rate as one bundle (default off).
+     */
+    virtual void set_tag_bundle(bool enable) = 0;
+    /**
+     * Schedule RF frequency change at given device time.
+     * Retune is executed by a background thread when device time reaches rx_time,
+     * so several retunes can be queued ahead while streaming. rx_time, rx_freq and
+     * rx_rate tags are placed on the first sample received after the change took effect.
+     * Pending commands are dropped when the stream is stopped.
+     *
+     * @param   freq     RF frequency in Hz.
+     *
+     * @param   rx_time  Device time in seconds, same time base as rx_time tags.
+     *
+     * @return  true if retune was scheduled, false if stream is not running or freq is out
+     *          of LO range
+     */
+    virtual bool set_center_freq_at(double freq, double rx_time) = 0;
+    /**
+     * Schedule NCO frequency change at given device time.
+     *
+     * @param   nco_freq  NCO frequency in Hz.
+     *
+     * @param   channel   Channel index.
+     *
+     * @param   rx_time   Device time in seconds, same time base as rx_time tags.
+     *
+     * @return  true if change was scheduled, false if stream is not running
+     */
+    virtual bool set_nco_at(float nco_freq, int channel, double rx_time) = 0;
+    /**
+     * Drop all scheduled commands that are not executed yet.
+     */
+    virtual void clear_timed_commands() = 0;
+    /**
+     * Start streams of this block together with all other blocks that enabled
+     * synchronized start, possibly on different devices sharing reference clock and PPS.
+     * Streams are armed in start() and the last armed block starts all of them,
+     * enables PPS mode on every device (sample counters reset on each PPS edge)
+     * and measures timestamp offsets between devices on the next PPS edge.
+     * Must be set before the flowgraph is started.
+     * @note PPS transitions are tagged as with enable_PPS_mode.
+     *
+     * @param   enable    Enable or disable synchronized start.
+     *
+     * @param   fref_MHz  External reference clock frequency in MHz (0 keeps current clock).
+     */
+    virtual void set_sync_start(bool enable, double fref_MHz = 0) = 0;
+    /**
+     * @return  timestamp offset of every device in synchronized start group
+     *          to the first one in samples, measured on last synchronized start
+     */
+    virtual std::vector<double> get_sync_offsets() = 0;
+    /**
+     * Enable PPS disciplined timing. PPS mode counter resets are turned into a running model
+     * of PPS seconds and sample offset of the last PPS edge. rx_time tags carry absolute time
+     * instead of the raw counter and the PPS edge sample is tagged with rx_pps (tuple of
+     * PPS seconds and samples since the edge, 0 on the exact edge sample). rx_rate_error tag
+     * (ppm) reports sample rate error measured between edges.
+     * Receives are ended at the predicted edge, so edge sample starts an output buffer.
+     *
+     * @note Enables PPS mode, must be set before the flowgraph is started.
+     *
+     * @param   enable  Enable PPS disciplined timing.
+     */
+    virtual void set_pps_disciplined(bool enable) = 0;
+    /**
+     * Set PPS seconds of the next PPS edge. By default seconds of the first edge are taken
+     * from host clock rounded to the nearest second.
+     *
+     * @param   seconds  Time of the next PPS edge in seconds.
+     */
+    virtual void set_pps_time(uint64_t seconds) = 0;
+    /**
+     * @return  sample rate error measured between the last two PPS edges in ppm
+     */
+    virtual double get_pps_rate_error() = 0;
+    /**
+     * @return  number of PPS edges detected since stream start
+     */
+    virtual uint64_t get_pps_edges() = 0;
     /**
      * Set TCXO DAC.
      * @note Care must be taken as this parameter is returned to default value only after power off.
@@ -153,6 +478,24 @@ class LIMESDR_API source : virtual public gr::block {
      */
     virtual void set_tcxo_dac(uint16_t dacVal = 125) = 0;
 };
+
+/**
+ * Connect to several devices in parallel before source and sink blocks are created.
+ * Device list is read once per process and blocks created later reuse connected devices,
+ * which shortens startup of flowgraphs with many devices.
+ *
+ * @param   serials  Device serials (use "LimeUtil --find" to find them).
+ *
+ * @return  number of devices opened
+ */
+LIMESDR_API int preopen_devices(const std::vector<std::string>& serials);
+
+/**
+ * Switch PA path of sink blocks off and disable TX channels of all connected devices in
+ * parallel. Call it before stopping flowgraph that can be killed, so no carrier is left
+ * on air while streams and devices are being closed.
+ */
+LIMESDR_API void quiesce_devices();
 } // namespace limesdr
 } // namespace gr
 
@@ -0,0 +1,141 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "calibration_cache.h"
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static void make_directory(const std::string& path) {
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+std::string calibration_cache::default_path(const std::string& serial) {
+#ifdef _WIN32
+    const char* home = std::getenv("APPDATA");
+#else
+    const char* home = std::getenv("HOME");
+#endif
+    std::string dir = (home != NULL) ? std::string(home) + "/.limesdr" : ".limesdr";
+    make_directory(dir);
+    dir += "/calibration";
+    make_directory(dir);
+    return dir + "/" + serial + ".cal";
+}
+
+void calibration_cache::open(const std::string& file) {
+    path = file;
+    is_open = true;
+    entries.clear();
+
+    std::ifstream in(path);
+    std::string line;
+    int64_t now = std::time(NULL);
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        entry e;
+        if (!(fields >> e.direction >> e.channel >> e.lo >> e.bandwidth >> e.gain_band >>
+              e.temperature >> e.time))
+            continue;
+        uint16_t value;
+        while (fields >> value)
+            e.values.push_back(value);
+        if (now - e.time < LIMESDR_CAL_MAX_AGE)
+            entries.push_back(e);
+    }
+    std::cout << "INFO: calibration_cache::open(): " << entries.size()
+              << " calibrations loaded from " << path << std::endl;
+}
+
+void calibration_cache::close() { is_open = false; }
+
+bool calibration_cache::matches(const entry& a, const entry& b) const {
+    return a.direction == b.direction && a.channel == b.channel && a.gain_band == b.gain_band &&
+           std::fabs(a.lo - b.lo) <= LIMESDR_CAL_LO_TOLERANCE &&
+           std::fabs(a.bandwidth - b.bandwidth) <= LIMESDR_CAL_BW_TOLERANCE * b.bandwidth;
+}
+
+bool calibration_cache::find(const entry& key, entry& match) {
+    if (!is_open)
+        return false;
+    bool found = false;
+    bool changed = false;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (key.time - it->time >= LIMESDR_CAL_MAX_AGE ||
+            (matches(key, *it) &&
+             std::fabs(key.temperature - it->temperature) > LIMESDR_CAL_TEMP_TOLERANCE)) {
+            it = entries.erase(it);
+            changed = true;
+            continue;
+        }
+        if (matches(key, *it) &&
+            (!found || std::fabs(key.lo - it->lo) < std::fabs(key.lo - match.lo))) {
+            match = *it;
+            found = true;
+        }
+        ++it;
+    }
+    if (changed)
+        save();
+    return found;
+}
+
+void calibration_cache::store(const entry& calibration) {
+    if (!is_open)
+        return;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (matches(calibration, *it))
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+    entries.push_back(calibration);
+    save();
+}
+
+void calibration_cache::save() {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cout << "ERROR: calibration_cache::save(): unable to write " << path << std::endl;
+        return;
+    }
+    out << "# direction channel lo bandwidth gain_band temperature time values..." << std::endl;
+    for (const entry& e : entries) {
+        out << e.direction << " " << e.channel << " " << std::fixed << e.lo << " "
+            << e.bandwidth << " " << e.gain_band << " " << e.temperature << " " << e.time;
+        for (uint16_t value : e.values)
+            out << " " << value;
+        out << std::endl;
+    }
+}
@@ -0,0 +1,105 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CALIBRATION_CACHE_H
+#define CALIBRATION_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Calibration is reused if LO is within this distance of calibrated LO (Hz)
+#define LIMESDR_CAL_LO_TOLERANCE 1e6
+// Calibration is reused if bandwidth is within this fraction of calibrated bandwidth
+#define LIMESDR_CAL_BW_TOLERANCE 0.1
+// Calibration is invalidated when chip temperature drifts more than this (deg C)
+#define LIMESDR_CAL_TEMP_TOLERANCE 5.0
+// Calibration ages out after this time (seconds)
+#define LIMESDR_CAL_MAX_AGE (7 * 24 * 3600)
+// Gains are grouped into bands of this width (dB), calibration is valid within one band
+#define LIMESDR_CAL_GAIN_BAND_DB 10
+
+/**
+ * Persistent store of DC/IQ correction values of one board, so that LMS_Calibrate doesn't
+ * have to be repeated at the same operating point on every flowgraph start.
+ * Entries are kept in a text file, one entry per line.
+ */
+class calibration_cache {
+    public:
+    struct entry {
+        int direction;
+        int channel;
+        double lo;
+        double bandwidth;
+        int gain_band;
+        double temperature;
+        // Calibration time in seconds since epoch
+        int64_t time;
+        std::vector<uint16_t> values;
+    };
+
+    /**
+     * Default cache file of the board, directory is created if needed.
+     *
+     * @param   serial  Board serial.
+     */
+    static std::string default_path(const std::string& serial);
+
+    /**
+     * Load entries from file and enable the cache.
+     *
+     * @param   path  Cache file.
+     */
+    void open(const std::string& path);
+
+    /**
+     * Disable the cache, file is kept.
+     */
+    void close();
+
+    bool enabled() const { return is_open; }
+
+    /**
+     * Find entry for operating point. Aged entries and entries calibrated at a different
+     * temperature are removed.
+     *
+     * @param   key    Operating point (values are not used).
+     *
+     * @param   match  Returns matching entry with the closest LO.
+     *
+     * @return  true if entry was found
+     */
+    bool find(const entry& key, entry& match);
+
+    /**
+     * Store entry, replacing entries of the same operating point, and save the file.
+     */
+    void store(const entry& calibration);
+
+    private:
+    std::string path;
+    bool is_open = false;
+    std::vector<entry> entries;
+
+    bool matches(const entry& a, const entry& b) const;
+    void save();
+};
+
+#endif
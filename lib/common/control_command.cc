@@ -0,0 +1,89 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "control_command.h"
+
+static const pmt::pmt_t FREQ_KEY = pmt::string_to_symbol("freq");
+static const pmt::pmt_t GAIN_KEY = pmt::string_to_symbol("gain");
+static const pmt::pmt_t BW_KEY = pmt::string_to_symbol("bw");
+static const pmt::pmt_t NCO_KEY = pmt::string_to_symbol("nco");
+static const pmt::pmt_t CHAN_KEY = pmt::string_to_symbol("chan");
+static const pmt::pmt_t TIME_KEY = pmt::string_to_symbol("time");
+static const pmt::pmt_t STATUS_KEY = pmt::string_to_symbol("status");
+static const pmt::pmt_t ERROR_KEY = pmt::string_to_symbol("error");
+
+// Read numeric value of key, false if key is present but value is not a number
+static bool get_number(const pmt::pmt_t& dict, const pmt::pmt_t& key, double& value) {
+    pmt::pmt_t item = pmt::dict_ref(dict, key, pmt::PMT_NIL);
+    if (pmt::is_null(item))
+        return true;
+    if (!pmt::is_real(item) && !pmt::is_integer(item))
+        return false;
+    value = pmt::to_double(item);
+    return true;
+}
+
+bool control_command::parse(const pmt::pmt_t& message, std::string& error) {
+    msg = message;
+    if (!pmt::is_dict(message)) {
+        error = "command must be a dictionary";
+        return false;
+    }
+    double chan = 0;
+    if (!get_number(message, FREQ_KEY, freq) || !get_number(message, GAIN_KEY, gain) ||
+        !get_number(message, BW_KEY, bw) || !get_number(message, NCO_KEY, nco) ||
+        !get_number(message, CHAN_KEY, chan) || !get_number(message, TIME_KEY, time)) {
+        error = "command values must be numbers";
+        return false;
+    }
+    channel = (int)chan;
+    if (channel != 0 && channel != 1) {
+        error = "chan must be 0 or 1";
+        return false;
+    }
+    if (!std::isnan(freq) && freq <= 0) {
+        error = "freq must be more than 0 Hz";
+        return false;
+    }
+    if (!std::isnan(gain) && (gain < 0 || gain > 73)) {
+        error = "gain must be in range [0, 73] dB";
+        return false;
+    }
+    if (!std::isnan(bw) && bw < 0) {
+        error = "bw must not be negative";
+        return false;
+    }
+    if (std::isnan(freq) && std::isnan(gain) && std::isnan(bw) && std::isnan(nco)) {
+        error = "command has no freq, gain, bw or nco";
+        return false;
+    }
+    return true;
+}
+
+pmt::pmt_t control_command::reply(const std::string& error) const {
+    // Invalid command which is not a dictionary is returned under "command" key
+    pmt::pmt_t reply = pmt::is_dict(msg)
+                           ? msg
+                           : pmt::dict_add(pmt::make_dict(), pmt::string_to_symbol("command"), msg);
+    if (error.empty())
+        return pmt::dict_add(reply, STATUS_KEY, pmt::string_to_symbol("ok"));
+    reply = pmt::dict_add(reply, STATUS_KEY, pmt::string_to_symbol("error"));
+    return pmt::dict_add(reply, ERROR_KEY, pmt::string_to_symbol(error));
+}
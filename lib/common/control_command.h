@@ -0,0 +1,75 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CONTROL_COMMAND_H
+#define CONTROL_COMMAND_H
+
+#include <cmath>
+#include <mutex>
+#include <pmt/pmt.h>
+#include <string>
+
+static const pmt::pmt_t COMMAND_PORT = pmt::string_to_symbol("command");
+static const pmt::pmt_t COMMAND_REPLY_PORT = pmt::string_to_symbol("command_reply");
+
+/**
+ * Settings change received on "command" message port as PMT dictionary with optional
+ * freq, gain, bw, nco, chan and time keys. Values are validated when the message
+ * is received, so applying the command in device control worker can't fail on bad input.
+ */
+struct control_command {
+    pmt::pmt_t msg = pmt::PMT_NIL;
+    int channel = 0;
+    double freq = NAN;
+    double gain = NAN;
+    double bw = NAN;
+    double nco = NAN;
+    // Device time to apply command at, NAN to apply as soon as possible
+    double time = NAN;
+
+    /**
+     * @param   message  Command dictionary.
+     *
+     * @param   error    Returns description of invalid command.
+     *
+     * @return  true if command is valid
+     */
+    bool parse(const pmt::pmt_t& message, std::string& error);
+
+    /**
+     * Reply published on "command_reply" port: command dictionary with status key
+     * ("ok" or "error") and error key describing failure.
+     *
+     * @param   error  Empty if command was applied.
+     */
+    pmt::pmt_t reply(const std::string& error) const;
+};
+
+/**
+ * Shared by block and commands queued for it. Block clears alive flag under the mutex
+ * when it is destroyed, so commands still waiting in device control worker are dropped
+ * and command being applied is finished first.
+ */
+struct command_guard {
+    std::mutex mutex;
+    bool alive = true;
+};
+
+#endif
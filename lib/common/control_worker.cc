@@ -0,0 +1,84 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "control_worker.h"
+
+control_worker::~control_worker() { stop(); }
+
+void control_worker::post(command cmd) { post_at(clock::now(), std::move(cmd)); }
+
+void control_worker::post_at(clock::time_point when, command cmd) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.emplace(std::make_pair(when, sequence++), std::move(cmd));
+    if (!running) {
+        running = true;
+        thread = std::thread(&control_worker::loop, this, ++generation);
+    }
+    cond.notify_one();
+}
+
+void control_worker::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.clear();
+}
+
+size_t control_worker::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+void control_worker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.clear();
+        running = false;
+        cond.notify_one();
+    }
+    if (!thread.joinable())
+        return;
+    // Called by a command: thread exits when the command returns, so it can't be joined here
+    if (thread.get_id() == std::this_thread::get_id())
+        thread.detach();
+    else
+        thread.join();
+}
+
+void control_worker::loop(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Detached thread must not continue after post_at() started a new one
+    while (running && id == generation) {
+        if (queue.empty()) {
+            cond.wait(lock);
+            continue;
+        }
+        auto next = queue.begin();
+        if (next->first.first > clock::now()) {
+            cond.wait_until(lock, next->first.first);
+            continue;
+        }
+        command cmd = std::move(next->second);
+        queue.erase(next);
+        // Commands may post new commands, so don't hold the lock while executing
+        lock.unlock();
+        cmd();
+        lock.lock();
+    }
+}
@@ -0,0 +1,91 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef CONTROL_WORKER_H
+#define CONTROL_WORKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * Background thread executing device control commands at scheduled host time.
+ * Commands scheduled for the same time are executed in the order they were posted.
+ * The thread is started on the first posted command.
+ */
+class control_worker {
+    public:
+    typedef std::function<void()> command;
+    typedef std::chrono::steady_clock clock;
+
+    control_worker() {}
+    ~control_worker();
+
+    /**
+     * Execute command as soon as possible.
+     */
+    void post(command cmd);
+
+    /**
+     * Execute command at given host time (immediately if it has already passed).
+     *
+     * @param   when  Host time to execute command at.
+     *
+     * @param   cmd   Command to execute.
+     */
+    void post_at(clock::time_point when, command cmd);
+
+    /**
+     * Drop commands waiting for execution.
+     */
+    void clear();
+
+    /**
+     * Number of commands waiting for execution.
+     */
+    size_t pending();
+
+    /**
+     * Drop waiting commands and join the thread. Called from a command, the thread is
+     * detached and exits after the command returns.
+     */
+    void stop();
+
+    private:
+    // Key is execution time and sequence number to keep posting order
+    std::map<std::pair<clock::time_point, uint64_t>, command> queue;
+    uint64_t sequence = 0;
+    bool running = false;
+    // Incremented for each started thread
+    uint64_t generation = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+
+    void loop(uint64_t id);
+};
+
+#endif
@@ -19,11 +19,28 @@
  */
 
 #include "device_handler.h"
+#include "register_snapshot.h"
 #include <LMS7002M_parameters.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <ctime>
 #include <lime/ADF4002.h> //external clock input configuration
 #include <lime/lms7_device.h>
-
-device_handler::~device_handler() { delete list; }
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+device_handler::~device_handler() {
+    health.stop();
+    stop_sync_measure();
+    join_closers();
+    delete list;
+}
 
 void device_handler::error(int device_number) {
     // std::cout << "ERROR: " << LMS_GetLastErrorMessage() << std::endl;
@@ -35,44 +52,112 @@ lms_device_t* device_handler::get_device(int device_number) {
     return this->device_vector[device_number].address;
 }
 
-int device_handler::open_device(std::string& serial) {
+stream_backend& device_handler::get_stream_backend(int device_number) {
+    return *this->device_vector[device_number].backend;
+}
 
-    int device_number;
-    std::string search_name;
-    std::cout << "##################" << std::endl;
-    std::cout << "Connecting to device" << std::endl;
+bool device_handler::is_mock(int device_number) {
+    return this->device_vector[device_number].mock != nullptr;
+}
 
-    // Print device and library information only once
-    if (list_read == false) {
-        std::cout << "##################" << std::endl;
-        std::cout << "LimeSuite version: " << LMS_GetLibraryVersion() << std::endl;
-        std::cout << "gr-limesdr version: " << GR_LIMESDR_VER << std::endl;
-        std::cout << "##################" << std::endl;
+std::recursive_mutex& device_handler::get_device_mutex(int device_number) {
+    return *this->device_vector[device_number].mutex;
+}
 
-        device_count = LMS_GetDeviceList(list);
-        if (device_count < 1) {
-            std::cout << "ERROR: device_handler::open_device(): No Lime devices found."
-                      << std::endl;
-            exit(0);
-        }
-        std::cout << "Device list:" << std::endl;
+void device_handler::post_command(int device_number, control_worker::command cmd) {
+    device_vector[device_number].commands->post(std::move(cmd));
+}
 
-        for (int i = 0; i < device_count; i++) {
-            std::cout << "Nr.:" << i << " device:" << list[i] << std::endl;
-            device_vector.push_back(device());
-        }
-        std::cout << "##################" << std::endl;
+device_handler::shadow_config*
+device_handler::get_shadow(int device_number, bool direction, int channel) {
+    if (channel < 0 || channel > 1)
+        return nullptr;
+    return &device_vector[device_number].shadow[direction][channel];
+}
+
+void device_handler::invalidate_shadow(int device_number) {
+    for (auto& direction : device_vector[device_number].shadow)
+        for (auto& channel : direction)
+            channel = shadow_config();
+}
+
+int device_handler::apply_config(int device_number,
+                                 bool direction,
+                                 int channel,
+                                 const channel_config& config) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    shadow_config* shadow = get_shadow(device_number, direction, channel);
+    if (shadow == nullptr) {
+        std::cout << "ERROR: device_handler::apply_config(): channel must be 0 or 1." << std::endl;
+        return 0;
+    }
+    // Filters are tuned at the final LO and gain is set after filter tuning
+    int changed = 0;
+    if (!std::isnan(config.rf_freq) && (float)config.rf_freq != shadow->requested.rf_freq) {
+        set_rf_freq(device_number, direction, channel, config.rf_freq);
+        changed++;
+    }
+    if (!std::isnan(config.analog_bandw) &&
+        config.analog_bandw != shadow->requested.analog_bandw) {
+        set_analog_filter(device_number, direction, channel, config.analog_bandw);
+        changed++;
+    }
+    if (!std::isnan(config.digital_bandw) &&
+        config.digital_bandw != shadow->requested.digital_bandw) {
+        set_digital_filter(device_number, direction, channel, config.digital_bandw);
+        changed++;
+    }
+    if (!std::isnan(config.gain_dB) && (unsigned)config.gain_dB != shadow->requested.gain_dB) {
+        set_gain(device_number, direction, channel, (unsigned)config.gain_dB);
+        changed++;
+    }
+    return changed;
+}
+
+channel_config device_handler::get_config(int device_number, bool direction, int channel) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    shadow_config* shadow = get_shadow(device_number, direction, channel);
+    return (shadow != nullptr) ? shadow->applied : channel_config();
+}
+
+void device_handler::read_device_list(bool required) {
+    // Device list is read once and reused by every block of the process
+    if (list_read == true)
+        return;
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "##################" << std::endl;
+    std::cout << "LimeSuite version: " << LMS_GetLibraryVersion() << std::endl;
+    std::cout << "gr-limesdr version: " << GR_LIMESDR_VER << std::endl;
+    std::cout << "##################" << std::endl;
+
+    device_count = LMS_GetDeviceList(list);
+    if (device_count < 1 && !required) {
+        // Only mock devices are used
+        device_count = 0;
         list_read = true;
+        return;
     }
+    if (device_count < 1) {
+        std::cout << "ERROR: device_handler::open_device(): No Lime devices found." << std::endl;
+        exit(0);
+    }
+    std::cout << "Device list:" << std::endl;
 
-    if (serial.empty()) {
-        std::cout << "INFO: device_handler::open_device(): no serial number. Using first device in "
-                     "the list."
-                  << std::endl
-                  << "Use \"LimeUtil --find\" in terminal to find prefered device serial."
-                  << std::endl;
+    for (int i = 0; i < device_count; i++) {
+        std::cout << "Nr.:" << i << " device:" << list[i] << std::endl;
+        device_vector.push_back(device());
     }
+    std::cout << "INFO: device_handler::read_device_list(): " << device_count
+              << " devices found in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                           start)
+                     .count()
+              << " ms." << std::endl;
+    std::cout << "##################" << std::endl;
+    list_read = true;
+}
 
+int device_handler::find_device(std::string& serial) {
     // Identify device by serial number
     for (int i = 0; i < device_count; i++) {
         std::string device_string(list[i]);
@@ -82,32 +167,73 @@ int device_handler::open_device(std::string& serial) {
 
         // If serial is left empty, use first device in list
         if (serial.empty()) {
-            device_number = i;
             serial = aquired_serial;
-            break;
+            return i;
         } else if (aquired_serial == serial) {
-            device_number = i;
-            break;
-        }
-        // If program was unable to find device in list print error and stop program
-        else if (i == device_count - 1 && (aquired_serial != serial)) {
-            std::cout << "Unable to find LMS device with serial " << serial << "." << std::endl;
-            std::cout << "##################" << std::endl;
-            close_all_devices();
+            return i;
         }
     }
+    return -1;
+}
+
+lms_device_t* device_handler::connect(int device_number, const std::string& serial) {
+    lms_device_t* address = NULL;
+    if (LMS_Open(&address, list[device_number], NULL) != LMS_SUCCESS)
+        return NULL;
+    LMS_Init(address);
+    const lms_dev_info_t* info = LMS_GetDeviceInfo(address);
+    // Print in one go, several devices can be connected in parallel
+    std::ostringstream message;
+    message << "Using device: " << info->deviceName << "(" << serial
+            << ") GW: " << info->gatewareVersion << " FW: " << info->firmwareVersion << std::endl;
+    std::cout << message.str();
+    return address;
+}
+
+int device_handler::open_device(std::string& serial) {
+    std::lock_guard<std::mutex> lock(open_mutex);
+    // Device closed by previous flowgraph may still be resetting
+    join_closers();
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "##################" << std::endl;
+    std::cout << "Connecting to device" << std::endl;
+
+    mock_backend::settings mock_config;
+    if (mock_backend::parse(serial, mock_config))
+        return open_mock(serial, mock_config);
+
+    read_device_list();
+
+    if (serial.empty()) {
+        std::cout << "INFO: device_handler::open_device(): no serial number. Using first device in "
+                     "the list."
+                  << std::endl
+                  << "Use \"LimeUtil --find\" in terminal to find prefered device serial."
+                  << std::endl;
+    }
+
+    int device_number = find_device(serial);
+    // If program was unable to find device in list print error and stop program
+    if (device_number < 0) {
+        std::cout << "Unable to find LMS device with serial " << serial << "." << std::endl;
+        std::cout << "##################" << std::endl;
+        close_all_devices();
+    }
 
     // If device slot is empty, open and initialize device
     if (device_vector[device_number].address == NULL) {
-        if (LMS_Open(&device_vector[device_number].address, list[device_number], NULL) !=
-            LMS_SUCCESS)
+        device_vector[device_number].address = connect(device_number, serial);
+        device_vector[device_number].serial = serial;
+        if (device_vector[device_number].address == NULL)
             exit(0);
-        LMS_Init(device_vector[device_number].address);
-        const lms_dev_info_t* info = LMS_GetDeviceInfo(device_vector[device_number].address);
-        std::cout << "Using device: " << info->deviceName << "(" << serial
-                  << ") GW: " << info->gatewareVersion << " FW: " << info->firmwareVersion
-                  << std::endl;
+        device_vector[device_number].backend.reset(
+            new lms_stream_backend(device_vector[device_number].address));
         ++open_devices; // Count open devices
+        std::cout << "INFO: device_handler::open_device(): device ready in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                               start)
+                         .count()
+                  << " ms." << std::endl;
         std::cout << "##################" << std::endl;
         std::cout << std::endl;
     }
@@ -124,6 +250,86 @@ int device_handler::open_device(std::string& serial) {
                           // connection in other functions
 }
 
+int device_handler::open_mock(const std::string& serial, const mock_backend::settings& config) {
+    // Mock devices are numbered after devices of the list, so list numbering doesn't change
+    read_device_list(false);
+    for (int i = device_count; i < (int)device_vector.size(); i++) {
+        if (device_vector[i].serial == serial) {
+            std::cout << "Previously created mock device number " << i << " is used." << std::endl;
+            std::cout << "##################" << std::endl;
+            std::cout << std::endl;
+            return i;
+        }
+    }
+    if (device_vector.size() >= LIMESDR_MAX_DEVICES) {
+        std::cout << "ERROR: device_handler::open_mock(): no more than " << LIMESDR_MAX_DEVICES
+                  << " devices can be used." << std::endl;
+        close_all_devices();
+    }
+    device_vector.push_back(device());
+    int device_number = device_vector.size() - 1;
+    device_vector[device_number].serial = serial;
+    device_vector[device_number].mock = new mock_backend(config);
+    device_vector[device_number].backend.reset(device_vector[device_number].mock);
+    std::cout << "INFO: device_handler::open_mock(): mock device number " << device_number
+              << " ready (" << serial << "), no hardware is used." << std::endl;
+    std::cout << "##################" << std::endl;
+    std::cout << std::endl;
+    return device_number;
+}
+
+int device_handler::preopen(const std::vector<std::string>& serials) {
+    std::lock_guard<std::mutex> lock(open_mutex);
+    auto start = std::chrono::steady_clock::now();
+    join_closers();
+    read_device_list();
+
+    std::vector<int> numbers;
+    std::vector<std::string> found_serials;
+    for (std::string serial : serials) {
+        int device_number = find_device(serial);
+        if (device_number < 0) {
+            std::cout << "ERROR: device_handler::preopen(): unable to find LMS device with serial "
+                      << serial << "." << std::endl;
+            continue;
+        }
+        if (device_vector[device_number].address != NULL ||
+            std::find(numbers.begin(), numbers.end(), device_number) != numbers.end())
+            continue;
+        numbers.push_back(device_number);
+        found_serials.push_back(serial);
+    }
+
+    // LMS_Open and LMS_Init of different devices don't depend on each other
+    std::vector<lms_device_t*> addresses(numbers.size(), NULL);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numbers.size(); i++)
+        threads.emplace_back(
+            [&, i]() { addresses[i] = connect(numbers[i], found_serials[i]); });
+    for (auto& thread : threads)
+        thread.join();
+
+    int opened = 0;
+    for (size_t i = 0; i < numbers.size(); i++) {
+        if (addresses[i] == NULL) {
+            std::cout << "ERROR: device_handler::preopen(): failed to open device with serial "
+                      << found_serials[i] << "." << std::endl;
+            continue;
+        }
+        device_vector[numbers[i]].address = addresses[i];
+        device_vector[numbers[i]].serial = found_serials[i];
+        device_vector[numbers[i]].backend.reset(new lms_stream_backend(addresses[i]));
+        ++open_devices;
+        ++opened;
+    }
+    std::cout << "INFO: device_handler::preopen(): " << opened << " devices opened in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                           start)
+                     .count()
+              << " ms." << std::endl;
+    return opened;
+}
+
 void device_handler::close_device(int device_number, int block_type) {
     // Check if other block finished and close device
     if (device_vector[device_number].source_flag == false ||
@@ -131,13 +337,19 @@ void device_handler::close_device(int device_number, int block_type) {
         if (device_vector[device_number].address != NULL) {
             std::cout << std::endl;
             std::cout << "##################" << std::endl;
-            if (LMS_Reset(this->device_vector[device_number].address) != LMS_SUCCESS)
-                error(device_number);
-            if (LMS_Close(this->device_vector[device_number].address) != LMS_SUCCESS)
-                error(device_number);
-            std::cout << "INFO: device_handler::close_device(): Disconnected from device number "
+            // Commands must not reach closed device
+            device_vector[device_number].commands->stop();
+            {
+                // Health monitor polls under device mutex
+                std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+                close_async(device_vector[device_number].address, device_number);
+                device_vector[device_number].address = NULL;
+                device_vector[device_number].backend.reset();
+                device_vector[device_number].tx_quiesce = nullptr;
+                invalidate_shadow(device_number);
+            }
+            std::cout << "INFO: device_handler::close_device(): Disconnecting from device number "
                       << device_number << "." << std::endl;
-            device_vector[device_number].address = NULL;
             std::cout << "##################" << std::endl;
             std::cout << std::endl;
         }
@@ -154,19 +366,171 @@ void device_handler::close_device(int device_number, int block_type) {
     }
 }
 
+void device_handler::close_async(lms_device_t* address, int device_number) {
+    std::lock_guard<std::mutex> lock(closers_mutex);
+    closers.emplace_back([address, device_number]() {
+        auto start = std::chrono::steady_clock::now();
+        bool success = (LMS_Reset(address) == LMS_SUCCESS);
+        success = (LMS_Close(address) == LMS_SUCCESS) && success;
+        // Print in one go, several devices are closed in parallel
+        std::ostringstream message;
+        if (success)
+            message << "INFO: device_handler::close_device(): Disconnected from device number "
+                    << device_number << " in "
+                    << std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count()
+                    << " ms." << std::endl;
+        else
+            message << "ERROR: device_handler::close_device(): failed to reset and close device "
+                       "number "
+                    << device_number << "." << std::endl;
+        std::cout << message.str();
+    });
+}
+
+void device_handler::join_closers() {
+    std::vector<std::thread> pending;
+    {
+        std::lock_guard<std::mutex> lock(closers_mutex);
+        pending.swap(closers);
+    }
+    for (auto& thread : pending)
+        thread.join();
+}
+
 void device_handler::close_all_devices() {
     if (close_flag == false) {
-        for (int i = 0; i <= open_devices; i++) {
+        close_flag = true;
+        health.stop();
+        // Nothing is transmitted while devices are being reset
+        quiesce();
+        for (size_t i = 0; i < device_vector.size(); i++) {
             if (this->device_vector[i].address != NULL) {
-                LMS_Reset(this->device_vector[i].address);
-                LMS_Close(this->device_vector[i].address);
+                close_async(this->device_vector[i].address, i);
+                this->device_vector[i].address = NULL;
             }
         }
-        close_flag = true;
+        join_closers();
         exit(0);
     }
 }
 
+void device_handler::quiesce_device(int device_number) {
+    device& dev = device_vector[device_number];
+    // Lock may be held by thread that is stuck in LimeSuite or is calling error(), so waiting
+    // is limited. TX is switched off in any case.
+    std::unique_lock<std::recursive_mutex> lock(*dev.mutex, std::defer_lock);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (!lock.try_lock() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    lms_device_t* address = dev.address;
+    if (address == NULL)
+        return;
+    // Hook captures sink block, which clears it under device lock before it is destroyed
+    if (lock.owns_lock() && dev.tx_quiesce)
+        dev.tx_quiesce();
+    int channels = LMS_GetNumChannels(address, LMS_CH_TX);
+    for (int i = 0; i < channels && i < 2; i++)
+        LMS_EnableChannel(address, LMS_CH_TX, i, false);
+}
+
+void device_handler::quiesce() {
+    auto start = std::chrono::steady_clock::now();
+    // Each device is switched off on its own thread, so slow USB link of one device
+    // doesn't keep others transmitting
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < device_vector.size(); i++) {
+        if (device_vector[i].address != NULL)
+            threads.emplace_back(&device_handler::quiesce_device, this, (int)i);
+    }
+    for (auto& thread : threads)
+        thread.join();
+    if (!threads.empty())
+        std::cout << "INFO: device_handler::quiesce(): TX of " << threads.size()
+                  << " devices switched off in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                               start)
+                         .count()
+                  << " ms." << std::endl;
+}
+
+void device_handler::set_tx_quiesce(int device_number, std::function<void()> hook) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    device_vector[device_number].tx_quiesce = std::move(hook);
+}
+
+#ifndef _WIN32
+static const int quiesce_signals[] = {SIGINT, SIGTERM, SIGHUP};
+static struct sigaction previous_actions[3];
+static int signal_pipe[2] = {-1, -1};
+// Serializes handler installation of block start with restore by watcher thread
+static std::mutex signal_mutex;
+
+static void quiesce_signal_handler(int signal) {
+    // Only async-signal-safe calls are allowed here, TX is switched off by watcher thread
+    int saved_errno = errno;
+    unsigned char value = signal;
+    ssize_t ret = write(signal_pipe[1], &value, 1);
+    (void)ret;
+    errno = saved_errno;
+}
+#endif
+
+void device_handler::install_signal_handlers() {
+#ifndef _WIN32
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    if (signal_pipe[0] < 0) {
+        if (pipe(signal_pipe) != 0) {
+            std::cout << "ERROR: device_handler::install_signal_handlers(): unable to create "
+                         "pipe: "
+                      << std::strerror(errno) << "." << std::endl;
+            signal_pipe[0] = signal_pipe[1] = -1;
+            return;
+        }
+        std::thread([this]() {
+            while (true) {
+                unsigned char value;
+                ssize_t ret = read(signal_pipe[0], &value, 1);
+                if (ret < 0 && errno == EINTR)
+                    continue;
+                if (ret != 1)
+                    return;
+                this->quiesce();
+                // Chain to handler of application (e.g. Python) or default action, which
+                // stops flowgraph or terminates process. Next flowgraph start installs
+                // quiesce handler again.
+                {
+                    std::lock_guard<std::mutex> lock(signal_mutex);
+                    for (int i = 0; i < 3; i++) {
+                        if (quiesce_signals[i] == value)
+                            sigaction(value, &previous_actions[i], nullptr);
+                    }
+                }
+                kill(getpid(), value);
+            }
+        }).detach();
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = quiesce_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    for (int i = 0; i < 3; i++) {
+        struct sigaction current;
+        sigaction(quiesce_signals[i], nullptr, &current);
+        // Already installed, or ignored signal (e.g. SIGHUP under nohup) must not stop
+        // transmission
+        if (current.sa_handler == quiesce_signal_handler || current.sa_handler == SIG_IGN)
+            continue;
+        previous_actions[i] = current;
+        sigaction(quiesce_signals[i], &action, nullptr);
+    }
+#endif
+}
+
 void device_handler::check_blocks(int device_number,
                                   int block_type,
                                   int channel_mode,
@@ -230,11 +594,252 @@ void device_handler::check_blocks(int device_number,
     }
 }
 
+// LMS7002M register sections of snapshot, sections from 0x0100 are duplicated for both channels
+static const struct {
+    uint16_t first;
+    uint16_t last;
+    bool per_channel;
+} snapshot_sections[] = {{0x0020, 0x002F, false}, // LimeLight
+                         {0x0081, 0x0082, false}, // EN_DIR, AFE
+                         {0x0084, 0x008C, false}, // BIAS, XBUF, CGEN
+                         {0x0092, 0x00A7, false}, // LDO
+                         {0x00AD, 0x00AE, false}, // CDS
+                         {0x0100, 0x011A, true},  // TRF, TBB, RFE, RBB
+                         {0x011C, 0x0126, true},  // SX, TRX gain
+                         {0x0200, 0x020C, true},  // TxTSP
+                         {0x0240, 0x0261, true},  // TxNCO
+                         {0x0280, 0x02A7, true},  // TxGFIR1
+                         {0x02C0, 0x02E7, true},  // TxGFIR2
+                         {0x0300, 0x03A7, true},  // TxGFIR3
+                         {0x0400, 0x040F, true},  // RxTSP
+                         {0x0440, 0x0461, true},  // RxNCO
+                         {0x0480, 0x04A7, true},  // RxGFIR1
+                         {0x04C0, 0x04E7, true},  // RxGFIR2
+                         {0x0500, 0x05A7, true},  // RxGFIR3
+                         {0x05C0, 0x05CC, false}, // DC calibration
+                         {0x0600, 0x0606, false}, // RSSI, PDET, temperature
+                         {0x0640, 0x0641, false}};
+// CGEN is retuned by LMS_SetSampleRate on restore, saved VCO settings could leave it unlocked
+#define SNAPSHOT_CGEN_FIRST 0x0086
+#define SNAPSHOT_CGEN_LAST 0x008C
+// DC calibration, RSSI, PDET and temperature are read-only or board specific, saved only
+#define SNAPSHOT_BOARD_FIRST 0x05C0
+#define SNAPSHOT_BOARD_LAST 0x0606
+// FPGA registers of snapshot: board ID/version (0x0000-0x0003) and stream control
+// (0x0009, 0x000A) are saved but not restored
+#define SNAPSHOT_FPGA_COUNT 0x20
+
+static bool lms_restored(uint16_t address) {
+    return !(address >= SNAPSHOT_CGEN_FIRST && address <= SNAPSHOT_CGEN_LAST) &&
+           !(address >= SNAPSHOT_BOARD_FIRST && address <= SNAPSHOT_BOARD_LAST);
+}
+
+static bool fpga_restored(uint16_t address) {
+    return address > 0x0003 && address != 0x0009 && address != 0x000A;
+}
+
+bool device_handler::save_snapshot(int device_number, const std::string& filename) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return false;
+    auto start = std::chrono::high_resolution_clock::now();
+    lms_device_t* device = get_device(device_number);
+    lime::LMS7_Device* lms7 = static_cast<lime::LMS7_Device*>(device);
+    lime::LMS7002M* chip = lms7->GetLMS();
+    register_snapshot snapshot;
+
+    lime::LMS7002M::Channel active_channel = chip->GetActiveChannel();
+    for (int channel = 0; channel <= 2; channel++) {
+        if (channel > 0)
+            chip->SetActiveChannel((lime::LMS7002M::Channel)channel);
+        std::vector<uint16_t> addresses;
+        for (const auto& section : snapshot_sections) {
+            if (section.per_channel == (channel > 0)) {
+                for (uint32_t address = section.first; address <= section.last; address++)
+                    addresses.push_back(address);
+            }
+        }
+        std::vector<uint16_t> values(addresses.size());
+        if (chip->SPI_read_batch(addresses.data(), values.data(), addresses.size()) != 0) {
+            std::cout << "ERROR: device_handler::save_snapshot(): failed to read LMS7002M "
+                         "registers."
+                      << std::endl;
+            chip->SetActiveChannel(active_channel);
+            return false;
+        }
+        for (size_t i = 0; i < addresses.size(); i++)
+            snapshot.lms.push_back({(uint16_t)channel, addresses[i], values[i]});
+    }
+    chip->SetActiveChannel(active_channel);
+
+    std::vector<uint32_t> fpga_addresses(SNAPSHOT_FPGA_COUNT);
+    std::vector<uint32_t> fpga_values(SNAPSHOT_FPGA_COUNT);
+    for (int i = 0; i < SNAPSHOT_FPGA_COUNT; i++)
+        fpga_addresses[i] = i;
+    if (lms7->GetConnection()->ReadRegisters(
+            fpga_addresses.data(), fpga_values.data(), SNAPSHOT_FPGA_COUNT) != 0) {
+        std::cout << "ERROR: device_handler::save_snapshot(): failed to read FPGA registers."
+                  << std::endl;
+        return false;
+    }
+    for (int i = 0; i < SNAPSHOT_FPGA_COUNT; i++)
+        snapshot.fpga.push_back({(uint16_t)fpga_addresses[i], (uint16_t)fpga_values[i]});
+
+    double host_rate = 0;
+    double rf_rate = 0;
+    LMS_GetSampleRate(device, LMS_CH_RX, LMS_CH_0, &host_rate, &rf_rate);
+    snapshot.sample_rate = host_rate;
+    snapshot.oversample = (host_rate > 0) ? (uint32_t)std::lround(rf_rate / host_rate) : 0;
+    for (int direction = 0; direction < 2; direction++) {
+        for (int channel = 0; channel < 2; channel++) {
+            channel_config& config = snapshot.config[direction][channel];
+            config = device_vector[device_number].shadow[direction][channel].applied;
+            // Values set outside device_handler (e.g. .ini file) are read back
+            if (std::isnan(config.rf_freq))
+                LMS_GetLOFrequency(device, direction, channel, &config.rf_freq);
+            if (std::isnan(config.analog_bandw))
+                LMS_GetLPFBW(device, direction, channel, &config.analog_bandw);
+            if (std::isnan(config.gain_dB)) {
+                unsigned gain = 0;
+                if (LMS_GetGaindB(device, direction, channel, &gain) == LMS_SUCCESS)
+                    config.gain_dB = gain;
+            }
+        }
+    }
+
+    if (!snapshot.save(filename)) {
+        std::cout << "ERROR: device_handler::save_snapshot(): unable to write " << filename
+                  << std::endl;
+        return false;
+    }
+    std::cout << "INFO: device_handler::save_snapshot(): " << snapshot.lms.size()
+              << " LMS7002M and " << snapshot.fpga.size() << " FPGA registers saved to "
+              << filename << " in "
+              << std::chrono::duration<double, std::milli>(
+                     std::chrono::high_resolution_clock::now() - start)
+                     .count()
+              << " ms." << std::endl;
+    return true;
+}
+
+bool device_handler::load_snapshot(int device_number, const std::string& filename) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return false;
+    auto start = std::chrono::high_resolution_clock::now();
+    register_snapshot snapshot;
+    if (!snapshot.load(filename))
+        return false;
+    lms_device_t* device = get_device(device_number);
+    lime::LMS7_Device* lms7 = static_cast<lime::LMS7_Device*>(device);
+
+    // Sample rate first: it retunes CGEN and FPGA interface clocks
+    if (snapshot.sample_rate > 0 &&
+        LMS_SetSampleRate(device, snapshot.sample_rate, snapshot.oversample) != LMS_SUCCESS) {
+        std::cout << "ERROR: device_handler::load_snapshot(): failed to set sample rate."
+                  << std::endl;
+        return false;
+    }
+
+    // One batch: shared registers, then registers of each channel selected through MAC,
+    // finally MAC register value from snapshot
+    std::vector<uint16_t> addresses;
+    std::vector<uint16_t> values;
+    uint16_t mac_register = 0;
+    for (const auto& reg : snapshot.lms) {
+        if (reg.channel == 0 && reg.address == LMS7_MAC.address)
+            mac_register = reg.value;
+    }
+    for (uint16_t channel = 0; channel <= 2; channel++) {
+        if (channel > 0) {
+            addresses.push_back(LMS7_MAC.address);
+            values.push_back((mac_register & ~0x0003) | channel);
+        }
+        for (const auto& reg : snapshot.lms) {
+            if (reg.channel != channel || reg.address == LMS7_MAC.address ||
+                !lms_restored(reg.address))
+                continue;
+            addresses.push_back(reg.address);
+            values.push_back(reg.value);
+        }
+    }
+    addresses.push_back(LMS7_MAC.address);
+    values.push_back(mac_register);
+    if (lms7->GetLMS()->SPI_write_batch(addresses.data(), values.data(), addresses.size(), true) !=
+        0) {
+        std::cout << "ERROR: device_handler::load_snapshot(): failed to write LMS7002M registers."
+                  << std::endl;
+        return false;
+    }
+
+    // SX VCO selection and CSW tuning words of other board could leave LO unlocked,
+    // so both synthesizers are retuned to saved frequency
+    for (int direction = 0; direction < 2; direction++) {
+        double freq = snapshot.config[direction][LMS_CH_0].rf_freq;
+        if (std::isnan(freq))
+            freq = snapshot.config[direction][LMS_CH_1].rf_freq;
+        if (std::isnan(freq) || freq <= 0)
+            continue;
+        if (LMS_SetLOFrequency(device, direction, LMS_CH_0, freq) != LMS_SUCCESS) {
+            std::cout << "ERROR: device_handler::load_snapshot(): failed to tune "
+                      << (direction ? "TX" : "RX") << " LO to " << freq << " Hz." << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<uint32_t> fpga_addresses;
+    std::vector<uint32_t> fpga_values;
+    for (const auto& reg : snapshot.fpga) {
+        if (fpga_restored(reg.address)) {
+            fpga_addresses.push_back(reg.address);
+            fpga_values.push_back(reg.value);
+        }
+    }
+    if (!fpga_addresses.empty() &&
+        lms7->GetConnection()->WriteRegisters(
+            fpga_addresses.data(), fpga_values.data(), fpga_addresses.size()) != 0) {
+        std::cout << "ERROR: device_handler::load_snapshot(): failed to write FPGA registers."
+                  << std::endl;
+        return false;
+    }
+
+    // Registers now hold snapshot configuration, so shadow matches it
+    for (int direction = 0; direction < 2; direction++) {
+        for (int channel = 0; channel < 2; channel++) {
+            shadow_config& shadow = device_vector[device_number].shadow[direction][channel];
+            shadow.applied = snapshot.config[direction][channel];
+            shadow.requested = snapshot.config[direction][channel];
+            shadow.requested.rf_freq = (float)shadow.requested.rf_freq;
+        }
+    }
+    std::cout << "INFO: device_handler::load_snapshot(): " << addresses.size()
+              << " LMS7002M and " << fpga_addresses.size() << " FPGA registers restored from "
+              << filename << " in "
+              << std::chrono::duration<double, std::milli>(
+                     std::chrono::high_resolution_clock::now() - start)
+                     .count()
+              << " ms." << std::endl;
+    return true;
+}
+
 void device_handler::settings_from_file(int device_number,
                                         const std::string& filename,
                                         int* pAntenna_tx) {
-    if (LMS_LoadConfig(device_handler::getInstance().get_device(device_number), filename.c_str()))
-        device_handler::getInstance().error(device_number);
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return;
+    std::string extension(LIMESDR_SNAPSHOT_EXT);
+    if (filename.size() > extension.size() &&
+        filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0) {
+        if (!load_snapshot(device_number, filename))
+            device_handler::getInstance().error(device_number);
+    } else {
+        if (LMS_LoadConfig(device_handler::getInstance().get_device(device_number),
+                           filename.c_str()))
+            device_handler::getInstance().error(device_number);
+        // Whole chip configuration is replaced by the file
+        invalidate_shadow(device_number);
+    }
 
     // Set LimeSDR-Mini switches based on .ini file
     int antenna_rx = LMS_PATH_NONE;
@@ -262,7 +867,36 @@ void device_handler::settings_from_file(int device_number,
         device_handler::getInstance().get_device(device_number), LMS_CH_RX, LMS_CH_0, antenna_rx);
 }
 
+int device_handler::get_packet_samples(int data_format, int channels) {
+    const int payload = 4080; // 4096 byte packet without 16 byte header
+    int sample_bytes = (data_format == LIMESDR_FMT_I16) ? 4 : 3;
+    return payload / sample_bytes / std::max(channels, 1);
+}
+
+void device_handler::get_latency_profile(int profile,
+                                         double samp_rate,
+                                         double& throughput_vs_latency,
+                                         uint32_t& fifo_size) {
+    switch (profile) {
+    case LIMESDR_LATENCY_LOW: // ~1 ms of buffering, smallest USB transfers
+        throughput_vs_latency = 0.0;
+        fifo_size = std::max<uint32_t>((uint32_t)samp_rate / 1000, 8192);
+        break;
+    case LIMESDR_LATENCY_THROUGHPUT: // ~250 ms of buffering, largest USB transfers
+        throughput_vs_latency = 1.0;
+        fifo_size = (uint32_t)samp_rate / 4;
+        break;
+    default: // Balanced, ~100 ms of buffering
+        throughput_vs_latency = 0.5;
+        fifo_size = (uint32_t)samp_rate / 10;
+        break;
+    }
+}
+
 void device_handler::enable_channels(int device_number, int channel_mode, bool direction) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return;
     std::cout << "INFO: device_handler::enable_channels(): ";
     if (channel_mode < 2) {
 
@@ -301,6 +935,8 @@ void device_handler::enable_channels(int device_number, int channel_mode, bool d
 
 
 void device_handler::set_PPS_mode(int device_number, bool PPS_mode) {
+    if (is_mock(device_number))
+        return;
     // ESA mod.
     // Enable PPS in (1) disable (0)
     if (PPS_mode == true) {
@@ -315,6 +951,8 @@ void device_handler::set_PPS_mode(int device_number, bool PPS_mode) {
 }
 
 bool device_handler::disable_ext_clk(int device_number) {
+    if (is_mock(device_number))
+        return true;
 
     std::cout << "Disabling external reference clock\n";
     double val;
@@ -324,10 +962,151 @@ bool device_handler::disable_ext_clk(int device_number) {
             ->GetConnection();
     port->CustomParameterRead(&id, &val, 1, nullptr);
     port->CustomParameterWrite(&id, &val, 1, "");
+    device_vector[device_number].ext_clk = false;
     return true;
 }
 
+void device_handler::sync_join() {
+    std::lock_guard<std::mutex> lock(sync_mutex);
+    sync.expected++;
+}
+
+void device_handler::sync_leave() {
+    std::lock_guard<std::mutex> lock(sync_mutex);
+    if (sync.expected > 0)
+        sync.expected--;
+}
+
+void device_handler::sync_start(int device_number,
+                                lms_stream_t* streams,
+                                int count,
+                                std::atomic<bool>* started) {
+    std::lock_guard<std::mutex> lock(sync_mutex);
+    for (int i = 0; i < count; i++)
+        sync.streams.push_back({device_number, &streams[i], started});
+    sync.armed++;
+    std::cout << "INFO: device_handler::sync_start(): device [" << device_number
+              << "] armed for synchronized start (" << sync.armed << "/" << sync.expected << ")"
+              << std::endl;
+    // Streams of this block stay stopped until the last group member arms
+    if (sync.armed >= sync.expected)
+        start_sync_group();
+}
+
+void device_handler::sync_cancel(lms_stream_t* streams, int count) {
+    // Measuring thread reads streams that are going to be destroyed
+    stop_sync_measure();
+    std::lock_guard<std::mutex> lock(sync_mutex);
+    size_t armed = sync.streams.size();
+    sync.streams.erase(std::remove_if(sync.streams.begin(),
+                                      sync.streams.end(),
+                                      [&](const sync_group::member& m) {
+                                          return m.stream >= streams && m.stream < streams + count;
+                                      }),
+                       sync.streams.end());
+    if (sync.streams.size() != armed && sync.armed > 0)
+        sync.armed--;
+}
+
+std::vector<double> device_handler::get_sync_offsets() {
+    std::lock_guard<std::mutex> lock(sync_offsets_mutex);
+    return sync.offsets;
+}
+
+void device_handler::stop_sync_measure() {
+    sync_measure_abort = true;
+    if (sync_measure.joinable())
+        sync_measure.join();
+    sync_measure_abort = false;
+}
+
+void device_handler::start_sync_group() {
+    // First armed stream of every device is used to read device hardware time
+    std::vector<sync_group::member> reference;
+    for (auto& m : sync.streams) {
+        bool found = false;
+        for (auto& r : reference)
+            found |= (r.device_number == m.device_number);
+        if (!found)
+            reference.push_back(m);
+    }
+    // Sample counters of all devices reset on the same PPS edge from now on
+    for (auto& r : reference)
+        set_PPS_mode(r.device_number, true);
+
+    for (auto& m : sync.streams) {
+        if (get_stream_backend(m.device_number).start(m.stream) != LMS_SUCCESS) {
+            std::cout << "ERROR: device_handler::start_sync_group(): failed to start stream of "
+                         "device ["
+                      << m.device_number << "]" << std::endl;
+            error(m.device_number);
+        }
+        *m.started = true;
+    }
+    sync.streams.clear();
+    sync.armed = 0;
+    {
+        std::lock_guard<std::mutex> offsets_lock(sync_offsets_mutex);
+        sync.offsets.clear();
+    }
+    if (reference.empty())
+        return;
+    // Waiting for PPS edge here would keep start() and stop() of other blocks waiting
+    stop_sync_measure();
+    sync_measure = std::thread(&device_handler::measure_sync_offsets, this, reference);
+}
+
+void device_handler::measure_sync_offsets(std::vector<sync_group::member> reference) {
+    // Wait for PPS edge: hardware timestamp of reference device goes back to zero
+    lms_stream_status_t status;
+    stream_backend& backend = get_stream_backend(reference[0].device_number);
+    backend.status(reference[0].stream, &status);
+    uint64_t last = status.timestamp;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2000);
+    bool edge = false;
+    while (!edge && !sync_measure_abort && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (backend.status(reference[0].stream, &status) != LMS_SUCCESS)
+            continue;
+        edge = status.timestamp < last;
+        last = status.timestamp;
+    }
+    if (sync_measure_abort)
+        return;
+    if (!edge) {
+        std::cout << "ERROR: device_handler::measure_sync_offsets(): no PPS edge detected, "
+                     "timestamps of devices are not aligned"
+                  << std::endl;
+        return;
+    }
+
+    // Read hardware time of every device back to back, host time between reads is
+    // subtracted so only the difference of sample counters is left. Rate comes from the same
+    // backend read, so mock devices are measured like hardware
+    std::vector<uint64_t> timestamps(reference.size());
+    std::vector<double> rates(reference.size());
+    std::vector<std::chrono::steady_clock::time_point> read_times(reference.size());
+    for (size_t i = 0; i < reference.size(); i++) {
+        get_stream_backend(reference[i].device_number).status(reference[i].stream, &status);
+        read_times[i] = std::chrono::steady_clock::now();
+        timestamps[i] = status.timestamp;
+        rates[i] = status.sampleRate;
+    }
+    std::lock_guard<std::mutex> offsets_lock(sync_offsets_mutex);
+    for (size_t i = 0; i < reference.size(); i++) {
+        double elapsed = std::chrono::duration<double>(read_times[i] - read_times[0]).count();
+        double offset = (double)timestamps[i] - (double)timestamps[0] - elapsed * rates[i];
+        sync.offsets.push_back(offset);
+        std::cout << "INFO: device_handler::measure_sync_offsets(): device ["
+                  << reference[i].device_number << "] timestamp offset " << offset
+                  << " samples" << std::endl;
+    }
+}
+
 bool device_handler::set_ext_clk(int device_number, double fref_Mhz) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return true;
     lime::ADF4002* m_pModule;
     m_pModule = new lime::ADF4002();
 
@@ -387,11 +1166,19 @@ bool device_handler::set_ext_clk(int device_number, double fref_Mhz) {
         std::cout << "ADF configuration failed\n";
         return false;
     } else {
+        device_vector[device_number].ext_clk = true;
         return true;
     }
 }
 void device_handler::set_samp_rate(int device_number, double& rate) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
     std::cout << "INFO: device_handler::set_samp_rate(): ";
+    if (is_mock(device_number)) {
+        device_vector[device_number].mock->set_rate(rate);
+        rate = device_vector[device_number].mock->get_rate();
+        std::cout << "mock device sampling rate: " << rate / 1e6 << " MS/s." << std::endl;
+        return;
+    }
     if (LMS_SetSampleRate(device_handler::getInstance().get_device(device_number), rate, 0) !=
         LMS_SUCCESS)
         device_handler::getInstance().error(device_number);
@@ -405,41 +1192,68 @@ void device_handler::set_samp_rate(int device_number, double& rate) {
         device_handler::getInstance().error(device_number);
     std::cout << "set sampling rate: " << host_value / 1e6 << " MS/s." << std::endl;
     rate = host_value; // Get the real rate back;
+    // Digital filter coefficients depend on sample rate
+    for (auto& direction : device_vector[device_number].shadow)
+        for (auto& channel : direction)
+            channel.requested.digital_bandw = NAN;
 }
 
-void device_handler::set_oversampling(int device_number, int oversample) {
-    if (oversample == 0 || oversample == 1 || oversample == 2 || oversample == 4 ||
-        oversample == 8 || oversample == 16 || oversample == 32) {
-        std::cout << "INFO: device_handler::set_oversampling(): ";
-        double host_value;
-        double rf_value;
-        if (LMS_GetSampleRate(device_handler::getInstance().get_device(device_number),
-                              LMS_CH_RX,
-                              LMS_CH_0,
-                              &host_value,
-                              &rf_value))
-            device_handler::getInstance().error(device_number);
-
-        if (LMS_SetSampleRate(device_handler::getInstance().get_device(device_number),
-                              host_value,
-                              oversample) != LMS_SUCCESS)
-            device_handler::getInstance().error(device_number);
+double device_handler::get_samp_rate(int device_number) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return device_vector[device_number].mock->get_rate();
+    double host_value = 0;
+    if (LMS_GetSampleRate(get_device(device_number), LMS_CH_RX, LMS_CH_0, &host_value, NULL) !=
+        LMS_SUCCESS)
+        return 0;
+    return host_value;
+}
 
-        std::cout << "Oversampling set to: " << oversample << std::endl;
-    } else {
+bool device_handler::set_oversampling(int device_number, int oversample) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (oversample != 0 && oversample != 1 && oversample != 2 && oversample != 4 &&
+        oversample != 8 && oversample != 16 && oversample != 32) {
         std::cout << "ERROR: device_handler::set_oversampling(): valid oversample values are: "
-                     "0,1,2,4,8,16,32."
+                     "0,1,2,4,8,16,32, oversampling is not changed."
                   << std::endl;
-        close_all_devices();
+        return false;
     }
+    if (is_mock(device_number))
+        return true;
+    std::cout << "INFO: device_handler::set_oversampling(): ";
+    double host_value;
+    double rf_value;
+    if (LMS_GetSampleRate(device_handler::getInstance().get_device(device_number),
+                          LMS_CH_RX,
+                          LMS_CH_0,
+                          &host_value,
+                          &rf_value))
+        device_handler::getInstance().error(device_number);
+
+    if (LMS_SetSampleRate(device_handler::getInstance().get_device(device_number),
+                          host_value,
+                          oversample) != LMS_SUCCESS)
+        device_handler::getInstance().error(device_number);
+
+    std::cout << "Oversampling set to: " << oversample << std::endl;
+    for (auto& direction : device_vector[device_number].shadow)
+        for (auto& channel : direction)
+            channel.requested.digital_bandw = NAN;
+    return true;
 }
 
 double device_handler::set_rf_freq(int device_number, bool direction, int channel, float rf_freq) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return rf_freq;
     if (rf_freq <= 0) {
         std::cout << "ERROR: device_handler::set_rf_freq(): rf_freq must be more than 0 Hz."
                   << std::endl;
         close_all_devices();
     } else {
+        shadow_config* shadow = get_shadow(device_number, direction, channel);
+        if (shadow != nullptr && shadow->requested.rf_freq == rf_freq)
+            return shadow->applied.rf_freq;
         std::cout << "INFO: device_handler::set_rf_freq(): ";
         if (LMS_SetLOFrequency(device_handler::getInstance().get_device(device_number),
                                direction,
@@ -454,35 +1268,243 @@ double device_handler::set_rf_freq(int device_number, bool direction, int channe
         std::string s_dir[2] = {"RX", "TX"};
         std::cout << "RF frequency set [" << s_dir[direction] << "]: " << value / 1e6 << " MHz."
                   << std::endl;
+        // LO is shared by both channels of one direction
+        for (auto& channel_shadow : device_vector[device_number].shadow[direction]) {
+            channel_shadow.requested.rf_freq = rf_freq;
+            channel_shadow.applied.rf_freq = value;
+        }
         return value;
     }
 }
 
+bool device_handler::check_rf_freq(int device_number, bool direction, double rf_freq) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (std::isnan(rf_freq) || rf_freq <= 0)
+        return false;
+    if (is_mock(device_number))
+        return true;
+    lms_range_t range;
+    // Range is unknown, set_rf_freq() reports the failure
+    if (LMS_GetLOFrequencyRange(get_device(device_number), direction, &range) != LMS_SUCCESS)
+        return true;
+    return rf_freq >= range.min && rf_freq <= range.max;
+}
+
+// Select synthesizer through MAC field of register 0x0020: SXR(1) for RX, SXT(2) for TX
+static uint16_t select_sx(lms_device_t* device, bool direction) {
+    uint16_t mac = 0;
+    LMS_ReadLMSReg(device, 0x0020, &mac);
+    LMS_WriteLMSReg(device, 0x0020, (mac & ~0x0003) | (direction == LMS_CH_TX ? 2 : 1));
+    return mac;
+}
+
+int device_handler::set_hop_table(int device_number,
+                                  bool direction,
+                                  const std::vector<double>& freqs) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    lms_device_t* device = device_handler::getInstance().get_device(device_number);
+    std::vector<hop_entry>& table = device_vector[device_number].hop_table[direction];
+    table.clear();
+    if (is_mock(device_number)) {
+        for (double freq : freqs)
+            table.push_back({freq, {0}});
+        return table.size();
+    }
+
+    double current_freq = 0;
+    LMS_GetLOFrequency(device, direction, LMS_CH_0, &current_freq);
+    uint16_t current_regs[LIMESDR_SX_REG_COUNT];
+    uint16_t mac = select_sx(device, direction);
+    for (int i = 0; i < LIMESDR_SX_REG_COUNT; i++)
+        LMS_ReadLMSReg(device, LIMESDR_SX_REG_FIRST + i, &current_regs[i]);
+    LMS_WriteLMSReg(device, 0x0020, mac);
+
+    for (double freq : freqs) {
+        if (LMS_SetLOFrequency(device, direction, LMS_CH_0, freq) != LMS_SUCCESS) {
+            std::cout << "ERROR: device_handler::set_hop_table(): failed to tune to " << freq / 1e6
+                      << " MHz, entry skipped." << std::endl;
+            continue;
+        }
+        hop_entry entry;
+        LMS_GetLOFrequency(device, direction, LMS_CH_0, &entry.freq);
+        mac = select_sx(device, direction);
+        for (int i = 0; i < LIMESDR_SX_REG_COUNT; i++)
+            LMS_ReadLMSReg(device, LIMESDR_SX_REG_FIRST + i, &entry.regs[i]);
+        LMS_WriteLMSReg(device, 0x0020, mac);
+        table.push_back(entry);
+    }
+
+    // Return synthesizer to where it was before pre-tuning
+    mac = select_sx(device, direction);
+    for (int i = 0; i < LIMESDR_SX_REG_COUNT; i++)
+        LMS_WriteLMSReg(device, LIMESDR_SX_REG_FIRST + i, current_regs[i]);
+    LMS_WriteLMSReg(device, 0x0020, mac);
+
+    std::string s_dir[2] = {"RX", "TX"};
+    std::cout << "INFO: device_handler::set_hop_table(): " << table.size() << " "
+              << s_dir[direction] << " hop frequencies cached, current "
+              << current_freq / 1e6 << " MHz restored." << std::endl;
+    return table.size();
+}
+
+double device_handler::hop(int device_number, bool direction, size_t index, double& duration) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    const std::vector<hop_entry>& table = device_vector[device_number].hop_table[direction];
+    if (index >= table.size()) {
+        std::cout << "ERROR: device_handler::hop(): hop index " << index
+                  << " is out of hop table range." << std::endl;
+        duration = 0;
+        return 0;
+    }
+    if (is_mock(device_number)) {
+        duration = 0;
+        return table[index].freq;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    lms_device_t* device = device_handler::getInstance().get_device(device_number);
+    uint16_t mac = select_sx(device, direction);
+    for (int i = 0; i < LIMESDR_SX_REG_COUNT; i++)
+        LMS_WriteLMSReg(device, LIMESDR_SX_REG_FIRST + i, table[index].regs[i]);
+    LMS_WriteLMSReg(device, 0x0020, mac);
+    duration = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start)
+                   .count();
+    // LO was changed behind LimeSuite, next set_rf_freq() must be applied
+    for (auto& channel_shadow : device_vector[device_number].shadow[direction]) {
+        channel_shadow.requested.rf_freq = NAN;
+        channel_shadow.applied.rf_freq = table[index].freq;
+    }
+    return table[index].freq;
+}
+
+// DC/IQ correction values written by LMS_Calibrate for RX(0) and TX(1)
+static const std::vector<LMS7Parameter> calibration_params[2] = {
+    {LMS7_DCOFFI_RFE,
+     LMS7_DCOFFQ_RFE,
+     LMS7_GCORRI_RXTSP,
+     LMS7_GCORRQ_RXTSP,
+     LMS7_IQCORR_RXTSP,
+     LMS7_GC_BYP_RXTSP,
+     LMS7_PH_BYP_RXTSP},
+    {LMS7_DCCORRI_TXTSP,
+     LMS7_DCCORRQ_TXTSP,
+     LMS7_GCORRI_TXTSP,
+     LMS7_GCORRQ_TXTSP,
+     LMS7_IQCORR_TXTSP,
+     LMS7_DC_BYP_TXTSP,
+     LMS7_GC_BYP_TXTSP,
+     LMS7_PH_BYP_TXTSP}};
+
+// Correction registers are per channel, channel is selected through MAC field
+static std::vector<uint16_t> read_corrections(lms_device_t* device, int direction, int channel) {
+    uint16_t mac = 0;
+    LMS_ReadParam(device, LMS7_MAC, &mac);
+    LMS_WriteParam(device, LMS7_MAC, channel + 1);
+    std::vector<uint16_t> values;
+    for (const LMS7Parameter& param : calibration_params[direction]) {
+        uint16_t value = 0;
+        LMS_ReadParam(device, param, &value);
+        values.push_back(value);
+    }
+    LMS_WriteParam(device, LMS7_MAC, mac);
+    return values;
+}
+
+static void write_corrections(lms_device_t* device,
+                              int direction,
+                              int channel,
+                              const std::vector<uint16_t>& values) {
+    uint16_t mac = 0;
+    LMS_ReadParam(device, LMS7_MAC, &mac);
+    LMS_WriteParam(device, LMS7_MAC, channel + 1);
+    for (size_t i = 0; i < values.size(); i++)
+        LMS_WriteParam(device, calibration_params[direction][i], values[i]);
+    LMS_WriteParam(device, LMS7_MAC, mac);
+}
+
+static calibration_cache::entry
+calibration_point(lms_device_t* device, int direction, int channel, double lo, double bandwidth) {
+    calibration_cache::entry point;
+    point.direction = direction;
+    point.channel = channel;
+    point.lo = lo;
+    point.bandwidth = bandwidth;
+    unsigned gain = 0;
+    LMS_GetGaindB(device, direction, channel, &gain);
+    point.gain_band = gain / LIMESDR_CAL_GAIN_BAND_DB;
+    float_type temperature = 0;
+    LMS_GetChipTemperature(device, 0, &temperature);
+    point.temperature = temperature;
+    point.time = std::time(NULL);
+    return point;
+}
+
+void device_handler::set_calibration_cache(int device_number, bool enable) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    calibration_cache& cache = device_vector[device_number].calibrations;
+    if (enable && !cache.enabled())
+        cache.open(calibration_cache::default_path(device_vector[device_number].serial));
+    else if (!enable)
+        cache.close();
+}
+
 void device_handler::calibrate(int device_number, int direction, int channel, double bandwidth) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return;
     std::cout << "INFO: device_handler::calibrate(): ";
     double rf_freq = 0;
     LMS_GetLOFrequency(
         device_handler::getInstance().get_device(device_number), direction, channel, &rf_freq);
+
+    calibration_cache& cache = device_vector[device_number].calibrations;
+    calibration_cache::entry point;
+    if (cache.enabled()) {
+        point =
+            calibration_point(get_device(device_number), direction, channel, rf_freq, bandwidth);
+        calibration_cache::entry match;
+        if (cache.find(point, match) &&
+            match.values.size() == calibration_params[direction].size()) {
+            write_corrections(get_device(device_number), direction, channel, match.values);
+            std::cout << "calibration loaded from cache (LO " << match.lo / 1e6
+                      << " MHz, bandwidth " << match.bandwidth / 1e6 << " MHz)." << std::endl;
+            return;
+        }
+    }
+    int result;
     if (rf_freq > 31e6) // Normal calibration
-        LMS_Calibrate(device_handler::getInstance().get_device(device_number),
-                      direction,
-                      channel,
-                      bandwidth,
-                      0);
+        result = LMS_Calibrate(device_handler::getInstance().get_device(device_number),
+                               direction,
+                               channel,
+                               bandwidth,
+                               0);
     else { // Workaround
         LMS_SetLOFrequency(
             device_handler::getInstance().get_device(device_number), direction, channel, 50e6);
-        LMS_Calibrate(device_handler::getInstance().get_device(device_number),
-                      direction,
-                      channel,
-                      bandwidth,
-                      0);
+        result = LMS_Calibrate(device_handler::getInstance().get_device(device_number),
+                               direction,
+                               channel,
+                               bandwidth,
+                               0);
         LMS_SetLOFrequency(
             device_handler::getInstance().get_device(device_number), direction, channel, rf_freq);
     }
+    // Corrections of failed calibration must not be reused
+    if (result != LMS_SUCCESS) {
+        std::cout << "WARNING: device_handler::calibrate(): calibration failed, result is not "
+                     "cached."
+                  << std::endl;
+        return;
+    }
+    if (cache.enabled()) {
+        point.values = read_corrections(get_device(device_number), direction, channel);
+        cache.store(point);
+    }
 }
 
 void device_handler::set_antenna(int device_number, int channel, int direction, int antenna) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return;
     std::cout << "INFO: device_handler::set_antenna(): ";
     LMS_SetAntenna(
         device_handler::getInstance().get_device(device_number), direction, channel, antenna);
@@ -501,8 +1523,15 @@ double device_handler::set_analog_filter(int device_number,
                                          bool direction,
                                          int channel,
                                          double analog_bandw) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return analog_bandw;
     if (channel == 0 || channel == 1) {
         if (direction == LMS_CH_TX || direction == LMS_CH_RX) {
+            // LPF tuning can glitch the stream, don't repeat it for the same bandwidth
+            shadow_config* shadow = get_shadow(device_number, direction, channel);
+            if (shadow->requested.analog_bandw == analog_bandw)
+                return shadow->applied.analog_bandw;
             std::cout << "INFO: device_handler::set_analog_filter(): ";
             LMS_SetLPFBW(device_handler::getInstance().get_device(device_number),
                          direction,
@@ -514,6 +1543,8 @@ double device_handler::set_analog_filter(int device_number,
                          direction,
                          channel,
                          &analog_value);
+            shadow->requested.analog_bandw = analog_bandw;
+            shadow->applied.analog_bandw = analog_value;
             return analog_value;
         } else {
             std::cout << "ERROR: device_handler::set_analog_filter(): direction must be "
@@ -532,8 +1563,14 @@ double device_handler::set_digital_filter(int device_number,
                                           bool direction,
                                           int channel,
                                           double digital_bandw) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return digital_bandw;
     if (channel == 0 || channel == 1) {
         if (direction == LMS_CH_TX || direction == LMS_CH_RX) {
+            shadow_config* shadow = get_shadow(device_number, direction, channel);
+            if (shadow->requested.digital_bandw == digital_bandw)
+                return digital_bandw;
             bool enable = (digital_bandw > 0) ? true : false;
             std::cout << "INFO: device_handler::set_digital_filter(): ";
             LMS_SetGFIRLPF(device_handler::getInstance().get_device(device_number),
@@ -547,6 +1584,8 @@ double device_handler::set_digital_filter(int device_number,
                 std::cout << digital_bandw / 1e6 << " MHz." << std::endl;
             else
                 std::cout << "disabled" << std::endl;
+            shadow->requested.digital_bandw = digital_bandw;
+            shadow->applied.digital_bandw = digital_bandw;
             return digital_bandw;
         } else {
             std::cout << "ERROR: device_handler::set_digital_filter(): direction must be "
@@ -563,7 +1602,13 @@ double device_handler::set_digital_filter(int device_number,
 
 unsigned
 device_handler::set_gain(int device_number, bool direction, int channel, unsigned gain_dB) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return gain_dB;
     if (gain_dB >= 0 && gain_dB <= 73) {
+        shadow_config* shadow = get_shadow(device_number, direction, channel);
+        if (shadow != nullptr && shadow->requested.gain_dB == gain_dB)
+            return shadow->applied.gain_dB;
         std::cout << "INFO: device_handler::set_gain(): ";
         LMS_SetGaindB(
             device_handler::getInstance().get_device(device_number), direction, channel, gain_dB);
@@ -577,6 +1622,10 @@ device_handler::set_gain(int device_number, bool direction, int channel, unsigne
                       &gain_value);
         std::cout << "set gain [" << s_dir[direction] << "] CH" << channel << ": " << gain_value
                   << " dB." << std::endl;
+        if (shadow != nullptr) {
+            shadow->requested.gain_dB = gain_dB;
+            shadow->applied.gain_dB = gain_value;
+        }
         return gain_value;
     } else {
         std::cout << "ERROR: device_handler::set_gain(): valid gain range [0, 73] " << std::endl;
@@ -585,6 +1634,9 @@ device_handler::set_gain(int device_number, bool direction, int channel, unsigne
 }
 
 void device_handler::set_nco(int device_number, bool direction, int channel, float nco_freq) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return;
     std::string s_dir[2] = {"RX", "TX"};
     std::cout << "INFO: device_handler::set_nco(): ";
     if (nco_freq == 0) {
@@ -627,11 +1679,16 @@ void device_handler::set_nco(int device_number, bool direction, int channel, flo
 }
 
 void device_handler::disable_DC_corrections(int device_number) {
+    if (is_mock(device_number))
+        return;
     LMS_WriteParam(device_handler::getInstance().get_device(device_number), LMS7_DC_BYP_RXTSP, 1);
     LMS_WriteParam(device_handler::getInstance().get_device(device_number), LMS7_DCLOOP_STOP, 1);
 }
 
 void device_handler::set_tcxo_dac(int device_number, uint16_t dacVal) {
+    std::lock_guard<std::recursive_mutex> lock(get_device_mutex(device_number));
+    if (is_mock(device_number))
+        return;
     if (dacVal >= 0 && dacVal <= 65535) {
         std::cout << "INFO: device_handler::set_tcxo_dac(): ";
         float_type dac_value = dacVal;
@@ -651,7 +1708,12 @@ void device_handler::set_tcxo_dac(int device_number, uint16_t dacVal) {
     }
 }
 
-void device_handler::set_rfe_device(rfe_dev_t* rfe_dev) { rfe_device.rfe_dev = rfe_dev; }
+void device_handler::set_rfe_device(rfe_dev_t* rfe_dev) {
+    std::lock_guard<std::mutex> lock(rfe_device.mutex);
+    rfe_device.rfe_dev = rfe_dev;
+    if (!rfe_dev)
+        rfe_device.tdd = false;
+}
 
 void device_handler::update_rfe_channels() {
     if (rfe_device.rfe_dev) {
@@ -668,3 +1730,109 @@ void device_handler::update_rfe_channels() {
                   << std::endl;
     }
 }
+
+void device_handler::set_rfe_tdd(rfe_dev_t* rfe_dev, bool enable) {
+    std::lock_guard<std::mutex> lock(rfe_device.mutex);
+    if (rfe_dev)
+        rfe_device.rfe_dev = rfe_dev;
+    rfe_device.tdd = enable && rfe_device.rfe_dev;
+    // Mode is unknown until the first switch
+    rfe_device.mode = -1;
+    rfe_device.last_switch_us = 0;
+    rfe_device.max_switch_us = 0;
+    rfe_device.switch_count = 0;
+    std::cout << "INFO: device_handler::set_rfe_tdd(): LimeRFE TDD switching "
+              << (rfe_device.tdd ? "enabled" : "disabled") << std::endl;
+}
+
+bool device_handler::rfe_tdd_enabled() { return rfe_device.tdd; }
+
+int device_handler::rfe_switch(bool tx) {
+    int mode = tx ? RFE_MODE_TX : RFE_MODE_RX;
+    // Checked on every burst, so link lock is taken only when mode really changes
+    if (!rfe_device.tdd || rfe_device.mode == mode)
+        return 0;
+    std::lock_guard<std::mutex> lock(rfe_device.mutex);
+    if (!rfe_device.tdd || rfe_device.mode == mode)
+        return 0;
+    // Called on every burst, so nothing is printed unless switching fails
+    auto t1 = std::chrono::high_resolution_clock::now();
+    int error = RFE_Mode(rfe_device.rfe_dev, mode);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    if (error != 0) {
+        std::cout << "ERROR: device_handler::rfe_switch(): failed to switch LimeRFE to "
+                  << (tx ? "TX" : "RX") << " mode, error " << error << std::endl;
+        rfe_device.mode = -1;
+        return error;
+    }
+    rfe_device.mode = mode;
+    // Stats are written under link lock only, read without it
+    double elapsed = std::chrono::duration<double, std::micro>(t2 - t1).count();
+    rfe_device.last_switch_us = elapsed;
+    rfe_device.max_switch_us = std::max<double>(rfe_device.max_switch_us, elapsed);
+    rfe_device.switch_count++;
+    return 0;
+}
+
+void device_handler::get_rfe_switch_stats(double& last_us, double& max_us, uint64_t& count) {
+    last_us = rfe_device.last_switch_us;
+    max_us = rfe_device.max_switch_us;
+    count = rfe_device.switch_count;
+}
+
+void device_handler::set_rfe_monitor(rfe_dev_t* rfe_dev) {
+    std::lock_guard<std::mutex> lock(rfe_device.mutex);
+    rfe_device.monitored = rfe_dev;
+}
+
+void device_handler::set_health_monitor(double rate_hz) {
+    health.start(rate_hz, [this] { poll_health(); });
+    std::cout << "INFO: device_handler::set_health_monitor(): ";
+    if (health.get_rate() > 0)
+        std::cout << "polling board health at " << health.get_rate() << " Hz" << std::endl;
+    else
+        std::cout << "health monitor stopped" << std::endl;
+}
+
+bool device_handler::get_health(int device_number, health_snapshot& snapshot) {
+    return health.get(device_number, snapshot);
+}
+
+void device_handler::poll_health() {
+    // Device list is being changed, poll in the next pass
+    std::unique_lock<std::mutex> list_lock(open_mutex, std::try_to_lock);
+    if (!list_lock.owns_lock())
+        return;
+    for (int i = 0; i < (int)device_vector.size(); i++) {
+        // Device is being configured, don't wait for it
+        std::unique_lock<std::recursive_mutex> lock(*device_vector[i].mutex, std::try_to_lock);
+        if (!lock.owns_lock() || device_vector[i].address == NULL)
+            continue;
+        lms_device_t* address = device_vector[i].address;
+        health_snapshot snapshot;
+        float_type temperature;
+        if (LMS_GetChipTemperature(address, 0, &temperature) == LMS_SUCCESS)
+            snapshot.temperature = temperature;
+        LMS_GetClockFreq(address, LMS_CLOCK_REF, &snapshot.ref_clk);
+        // CGEN VCO comparators read 1 and 0 when PLL is locked
+        uint16_t cmpho = 0;
+        uint16_t cmplo = 1;
+        LMS_ReadParam(address, LMS7_VCO_CMPHO_CGEN, &cmpho);
+        LMS_ReadParam(address, LMS7_VCO_CMPLO_CGEN, &cmplo);
+        snapshot.cgen_locked = cmpho == 1 && cmplo == 0;
+        snapshot.ext_clk = device_vector[i].ext_clk;
+        health.store(i, snapshot);
+    }
+    list_lock.unlock();
+
+    // Link lock is held for the USB round-trip only, switching in progress skips this poll
+    rfe_boardState state = {0};
+    bool polled = false;
+    {
+        std::unique_lock<std::mutex> rfe_lock(rfe_device.mutex, std::try_to_lock);
+        if (rfe_lock.owns_lock() && rfe_device.monitored)
+            polled = RFE_GetState(rfe_device.monitored, &state) == 0;
+    }
+    if (polled)
+        health.store_rfe(state);
+}
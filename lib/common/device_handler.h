@@ -21,23 +21,66 @@
 #ifndef DEVICE_HANDLER_H
 #define DEVICE_HANDLER_H
 
+#include "calibration_cache.h"
+#include "control_worker.h"
+#include "health_monitor.h"
+#include "mock_backend.h"
+#include "stream_backend.h"
 #include <LimeSuite.h>
+#include <atomic>
 #include <cmath>
+#include <functional>
 #include <iostream>
 #include <limeRFE.h>
 #include <list>
 #include <math.h>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #define LMS_CH_0 0
 #define LMS_CH_1 1
 
+// Devices of the list and mock devices, device_vector is reserved for them so it never
+// reallocates while other threads index it
+#define LIMESDR_MAX_DEVICES 64
+
 #define LimeSDR_Mini 1
 #define LimeNET_Micro 2
 #define LimeSDR_USB 3
 
+// Stream data formats selectable in source/sink blocks
+#define LIMESDR_FMT_F32 0
+#define LIMESDR_FMT_I16 1
+#define LIMESDR_FMT_I12 2
+
+// Stream latency profiles selectable in source/sink blocks
+#define LIMESDR_LATENCY_LOW 0
+#define LIMESDR_LATENCY_BALANCED 1
+#define LIMESDR_LATENCY_THROUGHPUT 2
+
+// Sink policies for bursts with tx_time already in the past
+#define LIMESDR_LATE_SEND 0
+#define LIMESDR_LATE_DROP 1
+#define LIMESDR_LATE_SHIFT 2
+
+// LMS7002M SX (LO synthesizer) registers cached for frequency hopping
+#define LIMESDR_SX_REG_FIRST 0x011C
+#define LIMESDR_SX_REG_COUNT 9
+
+/**
+ * Configuration of one channel and direction. NAN marks values that are not known
+ * (shadow copy) or not requested (apply_config).
+ */
+struct channel_config {
+    double rf_freq = NAN;
+    double analog_bandw = NAN;
+    double digital_bandw = NAN;
+    double gain_dB = NAN;
+};
+
 #define GR_LIMESDR_VER "2.2.7"
 
 class device_handler {
@@ -48,9 +91,24 @@ class device_handler {
     // Calculate open devices to close them all on close_all_devices
     int device_count;
 
+    // SX register state of one pre-tuned frequency
+    struct hop_entry {
+        double freq;
+        uint16_t regs[LIMESDR_SX_REG_COUNT];
+    };
+
+    // Values requested by setter calls and values LimeSuite actually applied
+    struct shadow_config {
+        channel_config requested;
+        channel_config applied;
+    };
+
     struct device {
         // Device address
         lms_device_t* address = NULL;
+        std::string serial;
+        // Serializes configuration of this device only, other devices are not blocked
+        std::unique_ptr<std::recursive_mutex> mutex{new std::recursive_mutex};
 
         // Flags and variables used to check
         // shared settings and blocks usage
@@ -60,21 +118,104 @@ class device_handler {
         int sink_channel_mode = -1;
         std::string source_filename;
         std::string sink_filename;
+
+        // Frequency hopping tables for RX(0) and TX(1) synthesizers
+        std::vector<hop_entry> hop_table[2];
+
+        // DC/IQ corrections of previous calibrations, stored on disk
+        calibration_cache calibrations;
+
+        // Shadow copy of configuration [direction][channel]
+        shadow_config shadow[2][2];
+
+        // Executes commands received on block message ports
+        std::unique_ptr<control_worker> commands{new control_worker};
+
+        // External reference clock has been configured
+        bool ext_clk = false;
+
+        // Sample streams of LimeSuite or mock device
+        std::unique_ptr<stream_backend> backend;
+        // Set for mock device, owned by backend
+        mock_backend* mock = nullptr;
+
+        // Switches TX path of sink block off, called by quiesce()
+        std::function<void()> tx_quiesce;
     };
 
+    // Streams held back until all blocks of synchronized start are armed
+    struct sync_group {
+        struct member {
+            int device_number;
+            lms_stream_t* stream;
+            // Streaming flag of the block, set once its streams are started
+            std::atomic<bool>* started;
+        };
+        // Blocks that requested synchronized start
+        int expected = 0;
+        // Blocks that armed their streams in start()
+        int armed = 0;
+        std::vector<member> streams;
+        // Timestamp offset of each device in group to the first one (in samples)
+        std::vector<double> offsets;
+    } sync;
+    std::mutex sync_mutex;
+
+    // Waits for PPS edge after group start and measures offsets, so start() doesn't block
+    std::thread sync_measure;
+    std::atomic<bool> sync_measure_abort{false};
+    // Guards sync.offsets, measuring thread doesn't take sync_mutex
+    std::mutex sync_offsets_mutex;
+
+    void start_sync_group();
+    void measure_sync_offsets(std::vector<sync_group::member> reference);
+    void stop_sync_measure();
+
+    shadow_config* get_shadow(int device_number, bool direction, int channel);
+    void invalidate_shadow(int device_number);
+
+    // Serializes device list access and opening of devices
+    std::mutex open_mutex;
+    void read_device_list(bool required = true);
+    int find_device(std::string& serial);
+    lms_device_t* connect(int device_number, const std::string& serial);
+    int open_mock(const std::string& serial, const mock_backend::settings& config);
+
     struct rfe_device {
         int rx_channel = 0;
         int tx_channel = 0;
         rfe_dev_t* rfe_dev = nullptr;
+        // TX/RX mode is switched by sink bursts, read by TX streaming path without lock
+        std::atomic<bool> tdd{false};
+        std::atomic<int> mode{-1};
+        // Board polled by health monitor
+        rfe_dev_t* monitored = nullptr;
+        // Serializes LimeRFE link access only, switching and polling are done from other
+        // threads and take milliseconds over USB
+        std::mutex mutex;
+        std::atomic<double> last_switch_us{0};
+        std::atomic<double> max_switch_us{0};
+        std::atomic<uint64_t> switch_count{0};
     } rfe_device;
     // Device list
     lms_info_str_t* list = new lms_info_str_t[20];
-    // Device vector. Adds devices from the list
+    // Device vector. Adds devices from the list, capacity is reserved on construction
     std::vector<device> device_vector;
     // Run close_all_devices once with this flag
     bool close_flag = false;
 
-    device_handler(){};
+    // LMS_Reset and LMS_Close of closed devices run in background, so devices close in parallel
+    std::vector<std::thread> closers;
+    std::mutex closers_mutex;
+    void close_async(lms_device_t* address, int device_number);
+    void join_closers();
+    void quiesce_device(int device_number);
+
+    // Polls board health in background, declared after device_vector it reads
+    health_monitor health;
+    void poll_health();
+
+    device_handler() { device_vector.reserve(LIMESDR_MAX_DEVICES); };
     device_handler(device_handler const&);
     void operator=(device_handler const&);
 
@@ -86,8 +227,6 @@ class device_handler {
     }
     ~device_handler();
 
-    mutable std::recursive_mutex block_mutex;
-
 
     /**
      * Print device error and close all devices.
@@ -103,13 +242,59 @@ class device_handler {
      */
     lms_device_t* get_device(int device_number);
 
+    /**
+     * Get sample stream interface of the device. Blocks use it instead of LMS_*Stream calls,
+     * so that streaming works the same with mock device.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     */
+    stream_backend& get_stream_backend(int device_number);
+
+    /**
+     * Device was opened with "mock" serial and has no hardware behind it.
+     * Configuration calls of mock device aren't passed to LimeSuite and return requested values.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     */
+    bool is_mock(int device_number);
+
+    /**
+     * Get lock of the device. Control calls and block start/stop take it, so that
+     * configuration of one device doesn't wait for other devices. Streaming calls don't use it.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     */
+    std::recursive_mutex& get_device_mutex(int device_number);
+
+    /**
+     * Queue control command of the device. Commands of one device are executed in order
+     * on its own control thread, so message handlers and streaming don't wait for LimeSuite.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   cmd           Command to execute.
+     */
+    void post_command(int device_number, control_worker::command cmd);
+
     /**
      * Connect to the device and create singletone.
+     * Serial "mock" or "mock:key=value,..." creates device without hardware, see mock_backend.
      *
      * @param   serial Device serial from the list of LMS_GetDeviceList.
      */
     int open_device(std::string& serial);
 
+    /**
+     * Connect to several devices in parallel before blocks are created, so that
+     * LMS_Open and LMS_Init of each device don't wait for each other.
+     * Blocks created later reuse already connected devices.
+     *
+     * @param   serials  Device serials from the list of LMS_GetDeviceList.
+     *
+     * @return  number of devices opened
+     */
+    int preopen(const std::vector<std::string>& serials);
+
     /**
      * Disconnect from the device.
      *
@@ -124,6 +309,29 @@ class device_handler {
      */
     void close_all_devices();
 
+    /**
+     * Stop transmitting on all devices in parallel: switch PA path of sink blocks off and
+     * disable TX channels, so no carrier is left on air while process is shutting down.
+     * Device lock is waited for a short time only, so it can be called from error paths.
+     */
+    void quiesce();
+
+    /**
+     * Register TX switch off of sink block, called by quiesce().
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   hook  Function switching PA path off, empty function removes it.
+     */
+    void set_tx_quiesce(int device_number, std::function<void()> hook);
+
+    /**
+     * Quiesce TX on SIGINT, SIGTERM and SIGHUP, then pass signal to handler that was set before.
+     * Handled signal is given back to previous handler, so it is installed again on every
+     * flowgraph start; calls while it is installed do nothing.
+     */
+    void install_signal_handlers();
+
     /**
      * Check what blocks are used for single device.
      *
@@ -139,7 +347,7 @@ class device_handler {
     check_blocks(int device_number, int block_type, int channel_mode, const std::string& filename);
 
     /**
-     * Load settings from .ini file.
+     * Load settings from .ini file or from binary snapshot (.snap file).
      *
      * @param   device_number Device number from the list of LMS_GetDeviceList.
      *
@@ -149,6 +357,55 @@ class device_handler {
      */
     void settings_from_file(int device_number, const std::string& filename, int* antenna_tx);
 
+    /**
+     * Save LMS7002M and FPGA registers together with sample rate and channel
+     * configuration of the device to binary snapshot file.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   filename Path to snapshot file.
+     *
+     * @return  true if success
+     */
+    bool save_snapshot(int device_number, const std::string& filename);
+
+    /**
+     * Restore device from binary snapshot in one register batch.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   filename Path to snapshot file.
+     *
+     * @return  true if success
+     */
+    bool load_snapshot(int device_number, const std::string& filename);
+
+    /**
+     * Get number of samples per channel carried by one LimeSuite USB packet.
+     * F32 and I12 streams use 12-bit compressed link, I16 streams use 16-bit link.
+     *
+     * @param   data_format  Stream data format F32(0), I16(1), I12(2).
+     *
+     * @param   channels  Number of channels interleaved in packet.
+     */
+    int get_packet_samples(int data_format, int channels);
+
+    /**
+     * Get stream settings for selected latency profile.
+     *
+     * @param   profile  Latency profile: Low latency(0), Balanced(1), Max throughput(2)
+     *
+     * @param   samp_rate  Stream sample rate in S/s.
+     *
+     * @param   throughput_vs_latency  Returns throughputVsLatency stream setting.
+     *
+     * @param   fifo_size  Returns FIFO size in samples.
+     */
+    void get_latency_profile(int profile,
+                             double samp_rate,
+                             double& throughput_vs_latency,
+                             uint32_t& fifo_size);
+
     /**
      * Set used channels
      *
@@ -192,6 +449,52 @@ class device_handler {
      */
     bool disable_ext_clk(int device_number);
 
+    /**
+     * Add block to synchronized start group. Streams of group members are started
+     * together on all devices once every member arms them with sync_start().
+     */
+    void sync_join();
+
+    /**
+     * Remove block from synchronized start group.
+     */
+    void sync_leave();
+
+    /**
+     * Arm streams of synchronized start group member. The last member to arm
+     * enables PPS mode on all devices in group and starts all armed streams.
+     * Background thread then waits for the next PPS edge (which resets sample counters
+     * on every device) and measures timestamp offsets between devices.
+     *
+     * @param   device_number  Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   streams        Streams of the block.
+     *
+     * @param   count          Number of streams.
+     *
+     * @param   started        Streaming flag of the block, set when its streams are started.
+     */
+    void
+    sync_start(int device_number, lms_stream_t* streams, int count, std::atomic<bool>* started);
+
+    /**
+     * Remove streams that were armed but not started yet (block stopped before
+     * the whole group was armed).
+     *
+     * @param   streams        Streams of the block.
+     *
+     * @param   count          Number of streams.
+     */
+    void sync_cancel(lms_stream_t* streams, int count);
+
+    /**
+     * Get timestamp offsets measured at last synchronized start.
+     *
+     * @return  offset of every device in group to the first one in samples, empty until
+     *          the first PPS edge after start
+     */
+    std::vector<double> get_sync_offsets();
+
     /**
      * Set the same sample rate for both channels.
      *
@@ -201,14 +504,25 @@ class device_handler {
      */
     void set_samp_rate(int device_number, double& rate);
 
+    /**
+     * Read back host sample rate, which is after hardware decimation.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @return  Sample rate in S/s, 0 on failure.
+     */
+    double get_samp_rate(int device_number);
+
     /**
      * Set oversampling value for both channels
      *
      * @param   device_number Device number from the list of LMS_GetDeviceList.
      *
      * @param   oversample  Oversampling value (0 (default),1,2,4,8,16,32).
+     *
+     * @return  false if value is invalid, nothing is changed then
      */
-    void set_oversampling(int device_number, int oversample);
+    bool set_oversampling(int device_number, int oversample);
 
     /**
      * Set RF frequency of both channels (RX and TX separately).
@@ -225,6 +539,61 @@ class device_handler {
      */
     double set_rf_freq(int device_number, bool direction, int channel, float rf_freq);
 
+    /**
+     * Check RF frequency against LO range of the device, so commands can be rejected
+     * instead of failing in set_rf_freq().
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   direction  Direction of samples RX(LMS_CH_RX), TX(LMS_CH_TX).
+     *
+     * @param   rf_freq  RF frequency in Hz.
+     *
+     * @return  true if LO can be tuned to rf_freq
+     */
+    bool check_rf_freq(int device_number, bool direction, double rf_freq);
+
+    /**
+     * Pre-tune synthesizer to every frequency of the list and cache its SX register state.
+     * Synthesizer state from before the call is restored afterwards.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   direction  Direction of samples RX(LMS_CH_RX), TX(LMS_CH_TX).
+     *
+     * @param   freqs  RF frequencies in Hz.
+     *
+     * @return  number of hop table entries
+     */
+    int set_hop_table(int device_number, bool direction, const std::vector<double>& freqs);
+
+    /**
+     * Retune to hop table entry by writing only cached SX registers.
+     *
+     * @param   device_number Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   direction  Direction of samples RX(LMS_CH_RX), TX(LMS_CH_TX).
+     *
+     * @param   index  Hop table entry index.
+     *
+     * @param   duration  Returns time spent writing registers in seconds.
+     *
+     * @return  RF frequency in Hz of the entry, 0 on error
+     */
+    double hop(int device_number, bool direction, size_t index, double& duration);
+
+    /**
+     * Reuse DC/IQ corrections stored by previous calibrations instead of running
+     * LMS_Calibrate, when calibration at the same operating point (direction, channel,
+     * LO, bandwidth and gain band) exists and chip temperature hasn't changed.
+     * Calibrations are stored per board serial in ~/.limesdr/calibration.
+     *
+     * @param   device_number  Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   enable         Enable or disable the cache.
+     */
+    void set_calibration_cache(int device_number, bool enable);
+
     /**
      * Perform device calibration.
      *
@@ -298,6 +667,31 @@ class device_handler {
      */
     unsigned set_gain(int device_number, bool direction, int channel, unsigned gain_dB);
 
+    /**
+     * Apply several settings of one channel at once. Only values that differ from
+     * the shadow copy of applied configuration are sent, in the order LimeSuite needs them:
+     * LO, analog filter, digital filter, gain. Setters called with unchanged values are
+     * no-ops as well.
+     *
+     * @param   device_number  Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   direction      Select RX or TX.
+     *
+     * @param   channel        Channel index.
+     *
+     * @param   config         Settings to apply, NAN values are left as they are.
+     *
+     * @return  number of settings that were sent to the device
+     */
+    int apply_config(int device_number, bool direction, int channel, const channel_config& config);
+
+    /**
+     * Get shadow copy of applied configuration.
+     *
+     * @return  values applied by LimeSuite, NAN for values never set
+     */
+    channel_config get_config(int device_number, bool direction, int channel);
+
     /**
      * Set NCO (numerically controlled oscillator).
      * By selecting NCO frequency
@@ -337,6 +731,63 @@ class device_handler {
      * Assigns configured LimeSDR channels to LimeRFE for automatic channel switching
      */
     void update_rfe_channels();
+    /**
+     * Enable LimeRFE TX/RX mode switching driven by sink burst start and end.
+     * @param   rfe_dev  Pointer to LimeRFE device descriptor, nullptr disables switching
+     * @param   enable   Enable TDD switching
+     */
+    void set_rfe_tdd(rfe_dev_t* rfe_dev, bool enable);
+    /**
+     * @return true if LimeRFE TDD switching is enabled
+     */
+    bool rfe_tdd_enabled();
+    /**
+     * Switch LimeRFE to TX or RX mode, nothing is done if the board is already in this mode.
+     * Switching time is measured and kept in switch statistics.
+     * @param   tx  true to switch to TX, false to switch to RX
+     * @return 0 on success, other on failure (see LimeRFE error codes)
+     */
+    int rfe_switch(bool tx);
+    /**
+     * Get LimeRFE TDD switch statistics.
+     * @param   last_us  Returns duration of the last switch in microseconds
+     * @param   max_us   Returns the longest switch duration in microseconds
+     * @param   count    Returns number of switches
+     */
+    void get_rfe_switch_stats(double& last_us, double& max_us, uint64_t& count);
+    /**
+     * Get mutex that must be held while accessing LimeRFE board, so control calls don't
+     * interleave with TDD switching and health polling.
+     */
+    std::mutex& get_rfe_mutex() { return rfe_device.mutex; }
+    /**
+     * Register LimeRFE board for health polling.
+     * @param   rfe_dev  Pointer to LimeRFE device descriptor, nullptr stops polling
+     */
+    void set_rfe_monitor(rfe_dev_t* rfe_dev);
+    /**
+     * Start, stop or change rate of background health monitor. All open devices are polled
+     * in one pass. Devices and LimeRFE busy with control calls are skipped and polled in the
+     * next pass, so monitor never delays control.
+     * @param   rate_hz  Polls per second, 0 stops the monitor
+     */
+    void set_health_monitor(double rate_hz);
+    /**
+     * @return  health monitor rate in polls per second, 0 if stopped
+     */
+    double get_health_monitor_rate() { return health.get_rate(); }
+    /**
+     * Get cached health of the device, hardware is not accessed.
+     * @param   device_number  Device number from the list of LMS_GetDeviceList.
+     * @param   snapshot       Returns last polled values
+     * @return  false if device has not been polled yet
+     */
+    bool get_health(int device_number, health_snapshot& snapshot);
+    /**
+     * Get cached LimeRFE board state, hardware is not accessed.
+     * @return  false if LimeRFE has not been polled yet
+     */
+    bool get_rfe_health(rfe_boardState& state) { return health.get_rfe(state); }
 };
 
 
@@ -0,0 +1,230 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "disk_recorder.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#endif
+
+// O_DIRECT requires buffers, sizes and file offsets aligned to logical block size of the
+// device, page size covers all common devices
+#define RECORDER_ALIGNMENT 4096
+
+static char* aligned_alloc_block(size_t size) {
+#ifdef _WIN32
+    return static_cast<char*>(_aligned_malloc(size, RECORDER_ALIGNMENT));
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, RECORDER_ALIGNMENT, size) != 0)
+        return nullptr;
+    return static_cast<char*>(ptr);
+#endif
+}
+
+static void aligned_free_block(char* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+disk_recorder::~disk_recorder() { this->close(); }
+
+bool disk_recorder::open(const std::string& filename,
+                         size_t sample_size,
+                         size_t block_size,
+                         int block_count) {
+    this->close();
+#ifdef _WIN32
+    fd = _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+    direct_io = false;
+#else
+    direct_io = false;
+#ifdef O_DIRECT
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    direct_io = (fd >= 0);
+    // tmpfs and some network file systems reject O_DIRECT
+    if (fd < 0 && errno == EINVAL)
+#endif
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) {
+        std::cout << "ERROR: disk_recorder::open(): unable to create " << filename << ": "
+                  << std::strerror(errno) << "." << std::endl;
+        return false;
+    }
+
+    // Whole samples and whole pages, so every full block keeps file offset aligned
+    size_t unit = sample_size * RECORDER_ALIGNMENT;
+    this->sample_size = sample_size;
+    this->block_size = std::max<size_t>(1, block_size / unit) * unit;
+    blocks.assign(std::max(block_count, 2), block());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].data = aligned_alloc_block(this->block_size);
+        if (blocks[i].data == nullptr) {
+            std::cout << "ERROR: disk_recorder::open(): unable to allocate "
+                      << blocks.size() * this->block_size << " bytes of buffers." << std::endl;
+            this->close();
+            return false;
+        }
+        free_blocks.push_back(i);
+    }
+    current = -1;
+    closing = false;
+    file_offset = 0;
+    committed = 0;
+    dropped = 0;
+    failed = false;
+    writer = std::thread(&disk_recorder::writer_loop, this);
+    return true;
+}
+
+void disk_recorder::close() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (current >= 0 && blocks[current].filled > 0)
+                full_blocks.push_back(current);
+            current = -1;
+            closing = true;
+        }
+        full_cond.notify_one();
+        writer.join();
+    }
+    if (fd >= 0) {
+        // Last block was written padded to alignment
+        uint64_t size = committed * sample_size;
+#ifdef _WIN32
+        _chsize_s(fd, size);
+        _close(fd);
+#else
+        if (ftruncate(fd, size) != 0)
+            std::cout << "ERROR: disk_recorder::close(): unable to truncate file: "
+                      << std::strerror(errno) << "." << std::endl;
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+    for (auto& b : blocks)
+        aligned_free_block(b.data);
+    blocks.clear();
+    free_blocks.clear();
+    full_blocks.clear();
+}
+
+void* disk_recorder::write_ptr(size_t& count) {
+    count = 0;
+    if (fd < 0 || failed)
+        return nullptr;
+    if (current < 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_blocks.empty())
+            return nullptr;
+        current = free_blocks.front();
+        free_blocks.pop_front();
+        blocks[current].filled = 0;
+    }
+    block& b = blocks[current];
+    count = (block_size - b.filled) / sample_size;
+    return b.data + b.filled;
+}
+
+void disk_recorder::commit(size_t count) {
+    if (current < 0 || count == 0)
+        return;
+    block& b = blocks[current];
+    b.filled += count * sample_size;
+    committed += count;
+    if (b.filled < block_size)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        full_blocks.push_back(current);
+        current = -1;
+    }
+    full_cond.notify_one();
+}
+
+void disk_recorder::writer_loop() {
+    while (true) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            full_cond.wait(lock, [this] { return closing || !full_blocks.empty(); });
+            if (full_blocks.empty())
+                return;
+            index = full_blocks.front();
+            full_blocks.pop_front();
+        }
+        if (!failed && !this->write_block(blocks[index])) {
+            failed = true;
+            std::cout << "ERROR: disk_recorder::writer_loop(): write failed: "
+                      << std::strerror(errno) << ", recording stopped." << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        free_blocks.push_back(index);
+    }
+}
+
+bool disk_recorder::write_block(block& b) {
+    size_t length = b.filled;
+    if (direct_io && length % RECORDER_ALIGNMENT != 0) {
+        // Only the last block is partial, file is cut to size on close
+        size_t padded = (length / RECORDER_ALIGNMENT + 1) * RECORDER_ALIGNMENT;
+        std::memset(b.data + length, 0, padded - length);
+        length = padded;
+    }
+
+    size_t written = 0;
+    while (written < length) {
+#ifdef _WIN32
+        _lseeki64(fd, file_offset + written, SEEK_SET);
+        int ret = _write(fd, b.data + written, (unsigned)(length - written));
+#else
+        ssize_t ret = pwrite(fd, b.data + written, length - written, file_offset + written);
+#endif
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        written += ret;
+    }
+
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    // Buffered fallback: start writeback now and drop written pages, so long captures
+    // don't fill page cache and stall writer once dirty limits are reached
+    if (!direct_io) {
+        fdatasync(fd);
+        posix_fadvise(fd, file_offset, length, POSIX_FADV_DONTNEED);
+    }
+#endif
+    file_offset += length;
+    return true;
+}
@@ -0,0 +1,138 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DISK_RECORDER_H
+#define DISK_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes samples of one stream to a raw file bypassing page cache. Producer receives samples
+ * directly into large aligned blocks, writer thread writes filled blocks with O_DIRECT, so
+ * recording doesn't compete with page cache writeback. If file system doesn't support
+ * O_DIRECT, blocks are written buffered and dropped from page cache after each write.
+ */
+class disk_recorder {
+    private:
+    struct block {
+        char* data = nullptr;
+        size_t filled = 0;
+    };
+
+    int fd = -1;
+    bool direct_io = false;
+    size_t sample_size = 0;
+    size_t block_size = 0;
+    std::vector<block> blocks;
+    // Block being filled by producer, -1 if it has to take a free one
+    int current = -1;
+
+    std::deque<int> free_blocks;
+    std::deque<int> full_blocks;
+    std::mutex mutex;
+    std::condition_variable full_cond;
+    bool closing = false;
+    std::thread writer;
+
+    uint64_t file_offset = 0;
+    std::atomic<uint64_t> committed{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> failed{false};
+
+    void writer_loop();
+    bool write_block(block& b);
+
+    public:
+    disk_recorder() {}
+    ~disk_recorder();
+
+    /**
+     * Create file and start writer thread.
+     *
+     * @param   filename     File to create, existing file is overwritten.
+     *
+     * @param   sample_size  Size of one sample in bytes.
+     *
+     * @param   block_size   Size of one write in bytes, rounded to whole samples and pages.
+     *
+     * @param   block_count  Number of blocks, together they absorb disk write stalls.
+     *
+     * @return  true if file was created
+     */
+    bool open(const std::string& filename,
+              size_t sample_size,
+              size_t block_size = 4 << 20,
+              int block_count = 32);
+
+    /**
+     * Write remaining samples, cut file to samples written and stop writer thread.
+     */
+    void close();
+
+    bool is_open() const { return fd >= 0; }
+
+    /**
+     * @return  true if file is written with O_DIRECT
+     */
+    bool direct() const { return direct_io; }
+
+    /**
+     * Get space in current block, so producer could receive samples directly to disk buffer.
+     *
+     * @param   count  Returns number of samples that can be written to returned pointer.
+     *
+     * @return  pointer to free space, nullptr if all blocks are waiting for disk
+     */
+    void* write_ptr(size_t& count);
+
+    /**
+     * Publish samples written to write_ptr() region.
+     */
+    void commit(size_t count);
+
+    /**
+     * Count samples producer had to discard because write_ptr() returned nullptr.
+     */
+    void drop(size_t count) { dropped += count; }
+
+    /**
+     * Total number of samples committed to file.
+     */
+    uint64_t samples() const { return committed; }
+
+    /**
+     * Total number of samples discarded because disk didn't keep up.
+     */
+    uint64_t dropped_samples() const { return dropped; }
+
+    /**
+     * @return  true if a write to file failed, later samples are discarded
+     */
+    bool write_failed() const { return failed; }
+};
+
+#endif
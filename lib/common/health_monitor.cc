@@ -0,0 +1,141 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "health_monitor.h"
+#include <algorithm>
+
+static const pmt::pmt_t KEY_SEQUENCE = pmt::string_to_symbol("sequence");
+static const pmt::pmt_t KEY_TIME = pmt::string_to_symbol("time");
+static const pmt::pmt_t KEY_TEMPERATURE = pmt::string_to_symbol("temperature");
+static const pmt::pmt_t KEY_REF_CLK = pmt::string_to_symbol("ref_clk");
+static const pmt::pmt_t KEY_EXT_CLK = pmt::string_to_symbol("ext_clk");
+static const pmt::pmt_t KEY_CGEN_LOCKED = pmt::string_to_symbol("cgen_locked");
+static const pmt::pmt_t KEY_RFE_MODE = pmt::string_to_symbol("rfe_mode");
+static const pmt::pmt_t KEY_RFE_CHANNEL_RX = pmt::string_to_symbol("rfe_channel_rx");
+static const pmt::pmt_t KEY_RFE_CHANNEL_TX = pmt::string_to_symbol("rfe_channel_tx");
+static const pmt::pmt_t KEY_RFE_ATTENUATION = pmt::string_to_symbol("rfe_attenuation");
+static const pmt::pmt_t KEY_RFE_NOTCH = pmt::string_to_symbol("rfe_notch");
+
+constexpr double health_monitor::max_rate;
+
+health_monitor::~health_monitor() { stop(); }
+
+void health_monitor::start(double rate_hz, poll_function poll) {
+    if (rate_hz <= 0) {
+        stop();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    rate = std::min(rate_hz, max_rate);
+    this->poll = std::move(poll);
+    if (!running) {
+        running = true;
+        thread = std::thread(&health_monitor::loop, this);
+    }
+    // Wake up the thread so the new rate applies immediately
+    cond.notify_one();
+}
+
+void health_monitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        rate = 0;
+        cond.notify_one();
+    }
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id())
+        thread.join();
+}
+
+double health_monitor::get_rate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rate;
+}
+
+void health_monitor::store(int device_number, health_snapshot snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    health_snapshot& cached = snapshots[device_number];
+    snapshot.sequence = cached.sequence + 1;
+    snapshot.time = std::chrono::system_clock::now();
+    cached = snapshot;
+}
+
+void health_monitor::store_rfe(const rfe_boardState& state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rfe_state = state;
+    rfe_valid = true;
+}
+
+bool health_monitor::get(int device_number, health_snapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = snapshots.find(device_number);
+    if (it == snapshots.end())
+        return false;
+    snapshot = it->second;
+    snapshot.rfe_valid = rfe_valid;
+    snapshot.rfe_state = rfe_state;
+    return true;
+}
+
+bool health_monitor::get_rfe(rfe_boardState& state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    state = rfe_state;
+    return rfe_valid;
+}
+
+pmt::pmt_t health_monitor::make_report(const health_snapshot& snapshot) {
+    pmt::pmt_t report = pmt::make_dict();
+    report = pmt::dict_add(report, KEY_SEQUENCE, pmt::from_uint64(snapshot.sequence));
+    report = pmt::dict_add(
+        report,
+        KEY_TIME,
+        pmt::from_double(
+            std::chrono::duration<double>(snapshot.time.time_since_epoch()).count()));
+    report = pmt::dict_add(report, KEY_TEMPERATURE, pmt::from_double(snapshot.temperature));
+    report = pmt::dict_add(report, KEY_REF_CLK, pmt::from_double(snapshot.ref_clk));
+    report = pmt::dict_add(report, KEY_EXT_CLK, pmt::from_bool(snapshot.ext_clk));
+    report = pmt::dict_add(report, KEY_CGEN_LOCKED, pmt::from_bool(snapshot.cgen_locked));
+    if (snapshot.rfe_valid) {
+        report = pmt::dict_add(report, KEY_RFE_MODE, pmt::from_long(snapshot.rfe_state.mode));
+        report = pmt::dict_add(
+            report, KEY_RFE_CHANNEL_RX, pmt::from_long(snapshot.rfe_state.channelIDRX));
+        report = pmt::dict_add(
+            report, KEY_RFE_CHANNEL_TX, pmt::from_long(snapshot.rfe_state.channelIDTX));
+        report = pmt::dict_add(
+            report, KEY_RFE_ATTENUATION, pmt::from_long(snapshot.rfe_state.attValue));
+        report =
+            pmt::dict_add(report, KEY_RFE_NOTCH, pmt::from_long(snapshot.rfe_state.notchOnOff));
+    }
+    return report;
+}
+
+void health_monitor::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        poll_function current = poll;
+        // Poll function stores snapshots, so don't hold the lock while polling
+        lock.unlock();
+        current();
+        lock.lock();
+        if (!running)
+            break;
+        cond.wait_for(lock, std::chrono::duration<double>(1.0 / rate));
+    }
+}
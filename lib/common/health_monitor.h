@@ -0,0 +1,138 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef HEALTH_MONITOR_H
+#define HEALTH_MONITOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limeRFE.h>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <pmt/pmt.h>
+#include <thread>
+
+static const pmt::pmt_t HEALTH_PORT = pmt::string_to_symbol("health");
+
+/**
+ * Board health read by the monitor thread.
+ */
+struct health_snapshot {
+    // Incremented every time the device is polled, 0 if it was never polled
+    uint64_t sequence = 0;
+    // Host time of the poll
+    std::chrono::system_clock::time_point time;
+    // LMS7002M chip temperature in degrees Celsius
+    double temperature = NAN;
+    // Reference clock frequency in Hz
+    double ref_clk = 0;
+    // External reference clock has been configured with set_ext_clk()
+    bool ext_clk = false;
+    // CGEN PLL is locked to reference clock
+    bool cgen_locked = false;
+    // LimeRFE board state, only valid if a LimeRFE board is registered
+    bool rfe_valid = false;
+    rfe_boardState rfe_state = {0};
+};
+
+/**
+ * Background thread polling board health at a fixed low rate.
+ * Polled values are cached, so getters never touch the hardware bus.
+ */
+class health_monitor {
+    public:
+    typedef std::function<void()> poll_function;
+
+    // Polling faster would compete with device control on the same link
+    static constexpr double max_rate = 10.0;
+
+    health_monitor() {}
+    ~health_monitor();
+
+    /**
+     * Start polling or change polling rate of running monitor.
+     *
+     * @param   rate_hz  Polls per second, limited to max_rate. 0 stops the monitor.
+     *
+     * @param   poll     Reads health of all devices and stores it with store().
+     */
+    void start(double rate_hz, poll_function poll);
+
+    /**
+     * Stop polling and join the thread. Cached snapshots are kept.
+     */
+    void stop();
+
+    double get_rate();
+
+    /**
+     * Cache health of device read by the poll function.
+     *
+     * @param   device_number  Device number from the list of LMS_GetDeviceList.
+     *
+     * @param   snapshot       Polled values, sequence and time are filled in.
+     */
+    void store(int device_number, health_snapshot snapshot);
+
+    /**
+     * Cache LimeRFE board state read by the poll function.
+     */
+    void store_rfe(const rfe_boardState& state);
+
+    /**
+     * Get cached health of the device. LimeRFE state is added if it has been polled.
+     *
+     * @return  false if device has not been polled yet
+     */
+    bool get(int device_number, health_snapshot& snapshot);
+
+    /**
+     * Get cached LimeRFE board state.
+     *
+     * @return  false if LimeRFE state has not been polled yet
+     */
+    bool get_rfe(rfe_boardState& state);
+
+    /**
+     * @return  dictionary with sequence, time, temperature, ref_clk, ext_clk, cgen_locked
+     *          and LimeRFE rfe_mode, rfe_channel_rx, rfe_channel_tx, rfe_attenuation
+     *          and rfe_notch if LimeRFE state is valid
+     */
+    static pmt::pmt_t make_report(const health_snapshot& snapshot);
+
+    private:
+    std::map<int, health_snapshot> snapshots;
+    bool rfe_valid = false;
+    rfe_boardState rfe_state = {0};
+
+    double rate = 0;
+    poll_function poll;
+    bool running = false;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+
+    void loop();
+};
+
+#endif
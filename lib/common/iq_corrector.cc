@@ -0,0 +1,138 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "iq_corrector.h"
+#include <algorithm>
+#ifdef HAVE_VOLK
+#include <volk/volk.h>
+#endif
+
+// Samples corrected in one kernel pass
+#define IQ_CHUNK 1024
+// Samples after reset() estimated on every chunk and step used then
+#define IQ_ACQUISITION (64 * IQ_CHUNK)
+#define IQ_ACQUISITION_STEP 0.25f
+
+iq_corrector::iq_corrector()
+    : scratch(IQ_CHUNK), offset(IQ_CHUNK, sample(0, 0)), ones(IQ_CHUNK, sample(1, 0)) {
+    reset();
+}
+
+void iq_corrector::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    dc = sample(0, 0);
+    w = sample(0, 0);
+    acquisition_left = IQ_ACQUISITION;
+    tracking_left = 0;
+}
+
+void iq_corrector::set_tracking(float step, size_t interval) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->step = std::max(0.0f, std::min(step, 1.0f));
+    this->interval = std::max<size_t>(interval, IQ_CHUNK);
+}
+
+iq_corrector::sample iq_corrector::get_dc() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dc;
+}
+
+iq_corrector::sample iq_corrector::get_iq() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return w;
+}
+
+void iq_corrector::correct(sample* samples, size_t count, sample w, sample k) {
+#ifdef HAVE_VOLK
+    if (w != sample(0, 0)) {
+        volk_32fc_conjugate_32fc(scratch.data(), samples, count);
+        volk_32fc_s32fc_multiply_32fc(scratch.data(), scratch.data(), w, count);
+        volk_32f_x2_add_32f(reinterpret_cast<float*>(samples),
+                            reinterpret_cast<const float*>(samples),
+                            reinterpret_cast<const float*>(scratch.data()),
+                            2 * count);
+    }
+    if (k != sample(0, 0)) {
+        if (offset_value != -k) {
+            offset_value = -k;
+            std::fill(offset.begin(), offset.end(), offset_value);
+        }
+        volk_32f_x2_add_32f(reinterpret_cast<float*>(samples),
+                            reinterpret_cast<const float*>(samples),
+                            reinterpret_cast<const float*>(offset.data()),
+                            2 * count);
+    }
+#else
+    // Plain loop on split real/imaginary parts, vectorized by compiler
+    float* iq = reinterpret_cast<float*>(samples);
+    const float wr = w.real(), wi = w.imag(), kr = k.real(), ki = k.imag();
+    for (size_t i = 0; i < count; i++) {
+        float re = iq[2 * i];
+        float im = iq[2 * i + 1];
+        iq[2 * i] = re + wr * re + wi * im - kr;
+        iq[2 * i + 1] = im + wi * re - wr * im - ki;
+    }
+#endif
+}
+
+void iq_corrector::estimate(const sample* samples, size_t count, float step) {
+    sample sum(0, 0);
+    sample square_sum(0, 0);
+    sample power(0, 0);
+#ifdef HAVE_VOLK
+    volk_32fc_x2_dot_prod_32fc(&sum, samples, ones.data(), count);
+    volk_32fc_x2_dot_prod_32fc(&square_sum, samples, samples, count);
+    volk_32fc_x2_conjugate_dot_prod_32fc(&power, samples, samples, count);
+#else
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i];
+        square_sum += samples[i] * samples[i];
+        power += std::norm(samples[i]);
+    }
+#endif
+    sample mean = sum / (float)count;
+    dc += step * mean;
+    // Residual DC would bias imbalance estimate
+    float variance = power.real() / count - std::norm(mean);
+    if (variance > 0) {
+        sample noncircular = square_sum / (float)count - mean * mean;
+        w -= step * noncircular / (2 * variance);
+    }
+}
+
+void iq_corrector::process(sample* samples, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (count > 0) {
+        size_t chunk = std::min(count, (size_t)IQ_CHUNK);
+        this->correct(samples, chunk, w, dc + w * std::conj(dc));
+
+        if (acquisition_left > 0) {
+            this->estimate(samples, chunk, IQ_ACQUISITION_STEP);
+            acquisition_left -= std::min(acquisition_left, chunk);
+        } else if (step > 0 && tracking_left <= chunk) {
+            this->estimate(samples, chunk, step);
+            tracking_left = interval;
+        } else {
+            tracking_left -= std::min(tracking_left, chunk);
+        }
+        samples += chunk;
+        count -= chunk;
+    }
+}
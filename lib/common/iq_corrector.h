@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef IQ_CORRECTOR_H
+#define IQ_CORRECTOR_H
+
+#include <complex>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * Host side DC offset and IQ imbalance correction of complex float samples.
+ * Samples are corrected in place as z = x + w * conj(x) - (dc + w * conj(dc)).
+ * Estimates are updated from corrected samples: DC from residual mean and w from
+ * residual noncircularity E[z^2] / 2E[|z|^2]. After reset() estimate converges on every
+ * chunk of acquisition window, then it is tracked with slow step on one chunk per interval.
+ */
+class iq_corrector {
+    public:
+    typedef std::complex<float> sample;
+
+    iq_corrector();
+
+    /**
+     * Drop estimates and start acquisition again, e.g. after calibration or retune
+     * changed the imbalance left in samples.
+     */
+    void reset();
+
+    /**
+     * @param   step      Tracking step after acquisition, 0 freezes estimates.
+     *
+     * @param   interval  Samples between tracking updates.
+     */
+    void set_tracking(float step, size_t interval);
+
+    /**
+     * Correct samples in place and update estimates.
+     */
+    void process(sample* samples, size_t count);
+
+    sample get_dc();
+    sample get_iq();
+
+    private:
+    std::mutex mutex;
+    sample dc{0, 0};
+    sample w{0, 0};
+    float step = 0.01f;
+    size_t interval = 1 << 16;
+    // Samples left in acquisition window and until next tracking update
+    size_t acquisition_left = 0;
+    size_t tracking_left = 0;
+
+    // Chunk buffers, sized so a chunk stays in L1 cache between kernel passes
+    std::vector<sample> scratch;
+    std::vector<sample> offset;
+    std::vector<sample> ones;
+    sample offset_value{0, 0};
+
+    void correct(sample* samples, size_t count, sample w, sample k);
+    void estimate(const sample* samples, size_t count, float step);
+};
+
+#endif
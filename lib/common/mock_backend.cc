@@ -0,0 +1,288 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "mock_backend.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Test tone period, tone is at 1/64 of sample rate
+#define MOCK_PATTERN_SAMPLES 1024
+#define MOCK_TONE_CYCLES 16
+// FIFO size used if stream doesn't set one
+#define MOCK_DEFAULT_FIFO (1 << 20)
+
+bool mock_backend::parse(const std::string& serial, settings& config) {
+    if (serial.compare(0, 4, "mock") != 0 || (serial.size() > 4 && serial[4] != ':'))
+        return false;
+    std::istringstream options(serial.size() > 5 ? serial.substr(5) : "");
+    std::string option;
+    while (std::getline(options, option, ',')) {
+        size_t equal = option.find('=');
+        std::string key = option.substr(0, equal);
+        std::string value = (equal == std::string::npos) ? "1" : option.substr(equal + 1);
+        try {
+            if (key == "rate")
+                config.rate = std::stod(value);
+            else if (key == "unpaced")
+                config.unpaced = std::stoi(value) != 0;
+            else if (key == "drop_interval")
+                config.drop_interval = std::stod(value);
+            else if (key == "drop")
+                config.drop_samples = std::stoull(value);
+            else if (key == "latency")
+                config.latency = std::stod(value) / 1e3;
+            else if (key == "tone")
+                config.tone = std::stoi(value) != 0;
+            else
+                std::cout << "ERROR: mock_backend::parse(): unknown option \"" << key
+                          << "\" ignored." << std::endl;
+        } catch (const std::exception&) {
+            std::cout << "ERROR: mock_backend::parse(): invalid value of option \"" << key
+                      << "\" ignored." << std::endl;
+        }
+    }
+    return true;
+}
+
+void mock_backend::set_rate(double rate) { samp_rate = rate; }
+
+double mock_backend::rate() const {
+    if (config.rate > 0)
+        return config.rate;
+    return (samp_rate > 0) ? samp_rate : 1e6;
+}
+
+mock_backend::stream_state* mock_backend::find(lms_stream_t* stream) {
+    std::lock_guard<std::mutex> lock(streams_mutex);
+    auto it = streams.find(stream->handle);
+    return (it == streams.end()) ? nullptr : it->second.get();
+}
+
+uint64_t mock_backend::stream_time(const stream_state& state, clock::time_point when) const {
+    if (when <= state.start)
+        return 0;
+    return (uint64_t)(std::chrono::duration<double>(when - state.start).count() * rate());
+}
+
+mock_backend::clock::time_point mock_backend::host_time(const stream_state& state,
+                                                        uint64_t timestamp) const {
+    return state.start + std::chrono::duration_cast<clock::duration>(
+                             std::chrono::duration<double>(timestamp / rate()));
+}
+
+// Copy test tone starting at given stream time, so tone phase follows timestamps
+void mock_backend::fill(stream_state& state, char* dst, uint64_t from, size_t count) {
+    size_t index = from % MOCK_PATTERN_SAMPLES;
+    while (count > 0) {
+        size_t chunk = std::min(count, (size_t)MOCK_PATTERN_SAMPLES - index);
+        std::memcpy(dst, &state.pattern[index * state.sample_size], chunk * state.sample_size);
+        dst += chunk * state.sample_size;
+        count -= chunk;
+        index = 0;
+    }
+}
+
+int mock_backend::setup(lms_stream_t* stream) {
+    std::unique_ptr<stream_state> state(new stream_state);
+    state->tx = stream->isTx;
+    state->format = stream->dataFmt;
+    // Host buffers hold 12-bit samples in 16-bit integers
+    state->sample_size = (stream->dataFmt == lms_stream_t::LMS_FMT_F32) ? 8 : 4;
+    state->fifo_size = (stream->fifoSize > 0) ? stream->fifoSize : MOCK_DEFAULT_FIFO;
+
+    state->pattern.assign(MOCK_PATTERN_SAMPLES * state->sample_size, 0);
+    if (config.tone) {
+        for (int i = 0; i < MOCK_PATTERN_SAMPLES; i++) {
+            double phase = 2 * M_PI * MOCK_TONE_CYCLES * i / MOCK_PATTERN_SAMPLES;
+            double re = 0.5 * std::cos(phase);
+            double im = 0.5 * std::sin(phase);
+            char* sample = &state->pattern[i * state->sample_size];
+            if (state->format == lms_stream_t::LMS_FMT_F32) {
+                float iq[2] = {(float)re, (float)im};
+                std::memcpy(sample, iq, sizeof(iq));
+            } else {
+                double scale = (state->format == lms_stream_t::LMS_FMT_I12) ? 2047 : 32767;
+                int16_t iq[2] = {(int16_t)std::lround(re * scale),
+                                 (int16_t)std::lround(im * scale)};
+                std::memcpy(sample, iq, sizeof(iq));
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(streams_mutex);
+    stream->handle = next_handle++;
+    streams[stream->handle] = std::move(state);
+    return LMS_SUCCESS;
+}
+
+int mock_backend::destroy(lms_stream_t* stream) {
+    std::lock_guard<std::mutex> lock(streams_mutex);
+    if (streams.erase(stream->handle) == 0)
+        return -1;
+    stream->handle = 0;
+    return LMS_SUCCESS;
+}
+
+int mock_backend::start(lms_stream_t* stream) {
+    std::lock_guard<std::mutex> lock(streams_mutex);
+    auto it = streams.find(stream->handle);
+    if (it == streams.end())
+        return -1;
+    stream_state& state = *it->second;
+    // Device has one sample counter: streams started while others run share their time base
+    state.start = clock::now();
+    for (auto& other : streams) {
+        if (other.second->active) {
+            state.start = other.second->start;
+            break;
+        }
+    }
+    state.position = state.tx ? 0 : stream_time(state, clock::now());
+    state.next_drop = state.position + (uint64_t)(config.drop_interval * rate());
+    state.queued = false;
+    state.underrun = state.overrun = state.dropped = 0;
+    state.active = true;
+    return LMS_SUCCESS;
+}
+
+int mock_backend::stop(lms_stream_t* stream) {
+    stream_state* state = find(stream);
+    if (state == nullptr)
+        return -1;
+    state->active = false;
+    return LMS_SUCCESS;
+}
+
+int mock_backend::recv(lms_stream_t* stream,
+                       void* samples,
+                       size_t sample_count,
+                       lms_stream_meta_t* meta,
+                       unsigned timeout_ms) {
+    stream_state* state = find(stream);
+    if (state == nullptr || state->tx || !state->active)
+        return -1;
+
+    uint64_t position = state->position;
+    // Injected loss: samples of whole packets never reach the host
+    if (config.drop_interval > 0 && position >= state->next_drop) {
+        position += config.drop_samples;
+        state->next_drop += std::max<uint64_t>(1, (uint64_t)(config.drop_interval * rate()));
+        state->dropped++;
+    }
+
+    size_t count = sample_count;
+    if (!config.unpaced) {
+        auto latency = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(config.latency));
+        auto ready = host_time(*state, position + sample_count) + latency;
+        auto deadline = clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::this_thread::sleep_until(std::min(ready, deadline));
+
+        uint64_t produced = stream_time(*state, clock::now() - latency);
+        // Host fell behind by more than FIFO holds, oldest samples are overwritten
+        if (produced > position + state->fifo_size) {
+            position = produced - state->fifo_size;
+            state->overrun++;
+            state->dropped++;
+        }
+        count = (produced > position) ? std::min<uint64_t>(sample_count, produced - position) : 0;
+    }
+
+    fill(*state, static_cast<char*>(samples), position, count);
+    // As in LimeSuite, metadata is left untouched on timeout
+    if (meta != nullptr && count > 0)
+        meta->timestamp = position;
+    state->position = position + count;
+    return count;
+}
+
+int mock_backend::send(lms_stream_t* stream,
+                       const void* samples,
+                       size_t sample_count,
+                       const lms_stream_meta_t* meta,
+                       unsigned timeout_ms) {
+    stream_state* state = find(stream);
+    if (state == nullptr || !state->tx || !state->active)
+        return -1;
+    if (config.unpaced) {
+        state->position += sample_count;
+        return sample_count;
+    }
+
+    uint64_t consumed = stream_time(*state, clock::now());
+    uint64_t first = state->position;
+    if (meta != nullptr && meta->waitForTimestamp) {
+        // Late samples are dropped by FPGA
+        if (meta->timestamp < consumed) {
+            state->dropped++;
+            return sample_count;
+        }
+        first = std::max<uint64_t>(first, meta->timestamp);
+    } else if (first < consumed) {
+        // FIFO ran empty before more samples arrived
+        if (state->queued)
+            state->underrun++;
+        first = consumed;
+    }
+
+    // Wait until FIFO has space for all samples or timeout expires
+    size_t count = sample_count;
+    if (first + sample_count > consumed + state->fifo_size) {
+        auto ready = host_time(*state, first + sample_count - state->fifo_size);
+        auto deadline = clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::this_thread::sleep_until(std::min(ready, deadline));
+        consumed = stream_time(*state, clock::now());
+        uint64_t space = consumed + state->fifo_size;
+        count = (space > first) ? std::min<uint64_t>(sample_count, space - first) : 0;
+    }
+    state->position = first + count;
+    state->queued = true;
+    return count;
+}
+
+int mock_backend::status(lms_stream_t* stream, lms_stream_status_t* status) {
+    stream_state* state = find(stream);
+    if (state == nullptr)
+        return -1;
+    uint64_t now = state->active ? stream_time(*state, clock::now()) : 0;
+    uint64_t position = state->position;
+    uint64_t filled = 0;
+    if (config.unpaced)
+        filled = 0;
+    else if (state->tx)
+        filled = (position > now) ? position - now : 0;
+    else
+        filled = (now > position) ? now - position : 0;
+
+    status->active = state->active;
+    status->fifoFilledCount = std::min<uint64_t>(filled, state->fifo_size);
+    status->fifoSize = state->fifo_size;
+    status->underrun = state->underrun.exchange(0);
+    status->overrun = state->overrun.exchange(0);
+    status->droppedPackets = state->dropped.exchange(0);
+    status->sampleRate = rate();
+    status->linkRate = rate() * state->sample_size;
+    status->timestamp = config.unpaced ? position : now;
+    return LMS_SUCCESS;
+}
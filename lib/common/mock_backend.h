@@ -0,0 +1,134 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef MOCK_BACKEND_H
+#define MOCK_BACKEND_H
+
+#include "stream_backend.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Streams of a device that doesn't exist. RX streams produce a test tone and TX streams
+ * consume samples at the configured sample rate, so host side of streaming (tagging,
+ * conversion, buffering, bursts) can be profiled without hardware.
+ * Stream time is kept by host clock, timestamps count samples since stream start.
+ */
+class mock_backend : public stream_backend {
+    public:
+    typedef std::chrono::steady_clock clock;
+
+    struct settings {
+        // Sample rate, 0 takes rate set by set_samp_rate()
+        double rate = 0;
+        // Don't pace streams by host clock, samples are produced/consumed as fast as possible
+        bool unpaced = false;
+        // Drop samples every drop_interval seconds of stream time, 0 disables drops
+        double drop_interval = 0;
+        // Samples lost on every drop
+        uint64_t drop_samples = 4080;
+        // RX samples are delivered this long after their timestamp
+        double latency = 0;
+        // Output test tone, zeros otherwise
+        bool tone = true;
+    };
+
+    private:
+    struct stream_state {
+        bool tx = false;
+        int format = lms_stream_t::LMS_FMT_F32;
+        size_t sample_size = 8;
+        uint32_t fifo_size = 0;
+        std::atomic<bool> active{false};
+        clock::time_point start;
+        // Stream time of next sample read (RX) and of last queued sample (TX)
+        std::atomic<uint64_t> position{0};
+        // Stream time of next injected drop
+        uint64_t next_drop = 0;
+        // TX samples were queued since start, so empty FIFO is an underrun
+        bool queued = false;
+        // Counters reset on every status read, as in LimeSuite
+        std::atomic<uint32_t> underrun{0};
+        std::atomic<uint32_t> overrun{0};
+        std::atomic<uint32_t> dropped{0};
+        // One period of test tone in stream format
+        std::vector<char> pattern;
+    };
+
+    settings config;
+    double samp_rate = 0;
+    std::mutex streams_mutex;
+    std::map<size_t, std::unique_ptr<stream_state>> streams;
+    size_t next_handle = 1;
+
+    stream_state* find(lms_stream_t* stream);
+    double rate() const;
+    // Stream time (samples since start) at given host time
+    uint64_t stream_time(const stream_state& state, clock::time_point when) const;
+    clock::time_point host_time(const stream_state& state, uint64_t timestamp) const;
+    void fill(stream_state& state, char* dst, uint64_t from, size_t count);
+
+    public:
+    mock_backend(const settings& config) : config(config) {}
+
+    /**
+     * Parse "mock" device serial.
+     *
+     * @param   serial  "mock" optionally followed by ":key=value,..." with keys rate,
+     *                  unpaced, drop_interval, drop, latency (ms) and tone.
+     *
+     * @param   config  Returns parsed settings.
+     *
+     * @return  true if serial selects mock device
+     */
+    static bool parse(const std::string& serial, settings& config);
+
+    /**
+     * Sample rate of streams, used unless rate is fixed by settings.
+     */
+    void set_rate(double rate);
+    double get_rate() const { return rate(); }
+
+    int setup(lms_stream_t* stream) override;
+    int destroy(lms_stream_t* stream) override;
+    int start(lms_stream_t* stream) override;
+    int stop(lms_stream_t* stream) override;
+
+    int recv(lms_stream_t* stream,
+             void* samples,
+             size_t sample_count,
+             lms_stream_meta_t* meta,
+             unsigned timeout_ms) override;
+    int send(lms_stream_t* stream,
+             const void* samples,
+             size_t sample_count,
+             const lms_stream_meta_t* meta,
+             unsigned timeout_ms) override;
+
+    int status(lms_stream_t* stream, lms_stream_status_t* status) override;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "register_snapshot.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char snapshot_magic[8] = {'G', 'R', 'L', 'S', 'N', 'A', 'P', 0};
+static const uint32_t snapshot_version = 1;
+
+static void put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        out.push_back((value >> (8 * i)) & 0xFF);
+}
+
+static void put_double(std::vector<uint8_t>& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put(out, bits, 8);
+}
+
+// Reads little-endian values from loaded file, stops at the end of data
+class snapshot_reader {
+    const std::vector<uint8_t>& data;
+    size_t position = 0;
+
+    public:
+    bool ok = true;
+
+    snapshot_reader(const std::vector<uint8_t>& data) : data(data) {}
+
+    uint64_t get(int bytes) {
+        if (position + bytes > data.size()) {
+            ok = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+            value |= (uint64_t)data[position++] << (8 * i);
+        return value;
+    }
+
+    double get_double() {
+        uint64_t bits = get(8);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+bool register_snapshot::save(const std::string& filename) const {
+    std::vector<uint8_t> out(snapshot_magic, snapshot_magic + sizeof(snapshot_magic));
+    put(out, snapshot_version, 4);
+
+    put(out, lms.size(), 4);
+    for (const lms_register& reg : lms) {
+        put(out, reg.channel, 2);
+        put(out, reg.address, 2);
+        put(out, reg.value, 2);
+    }
+    put(out, fpga.size(), 4);
+    for (const fpga_register& reg : fpga) {
+        put(out, reg.address, 2);
+        put(out, reg.value, 2);
+    }
+
+    put_double(out, sample_rate);
+    put(out, oversample, 4);
+    for (auto& direction : config) {
+        for (const channel_config& channel : direction) {
+            put_double(out, channel.rf_freq);
+            put_double(out, channel.analog_bandw);
+            put_double(out, channel.digital_bandw);
+            put_double(out, channel.gain_dB);
+        }
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    return file.good();
+}
+
+bool register_snapshot::load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(snapshot_magic) ||
+        std::memcmp(data.data(), snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        std::cout << "ERROR: register_snapshot::load(): " << filename << " is not a snapshot."
+                  << std::endl;
+        return false;
+    }
+    snapshot_reader in(data);
+    in.get(sizeof(snapshot_magic));
+    uint32_t version = in.get(4);
+    if (version != snapshot_version) {
+        std::cout << "ERROR: register_snapshot::load(): unsupported snapshot version " << version
+                  << "." << std::endl;
+        return false;
+    }
+
+    // Counts can't exceed file size, guards against allocating for corrupted file
+    uint32_t count = in.get(4);
+    if (count > data.size()) {
+        std::cout << "ERROR: register_snapshot::load(): " << filename << " is corrupted."
+                  << std::endl;
+        return false;
+    }
+    lms.resize(count);
+    for (lms_register& reg : lms) {
+        reg.channel = in.get(2);
+        reg.address = in.get(2);
+        reg.value = in.get(2);
+    }
+    count = in.get(4);
+    if (count > data.size()) {
+        std::cout << "ERROR: register_snapshot::load(): " << filename << " is corrupted."
+                  << std::endl;
+        return false;
+    }
+    fpga.resize(count);
+    for (fpga_register& reg : fpga) {
+        reg.address = in.get(2);
+        reg.value = in.get(2);
+    }
+
+    sample_rate = in.get_double();
+    oversample = in.get(4);
+    for (auto& direction : config) {
+        for (channel_config& channel : direction) {
+            channel.rf_freq = in.get_double();
+            channel.analog_bandw = in.get_double();
+            channel.digital_bandw = in.get_double();
+            channel.gain_dB = in.get_double();
+        }
+    }
+    if (!in.ok)
+        std::cout << "ERROR: register_snapshot::load(): " << filename << " is truncated."
+                  << std::endl;
+    return in.ok;
+}
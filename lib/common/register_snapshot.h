@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef REGISTER_SNAPSHOT_H
+#define REGISTER_SNAPSHOT_H
+
+#include "device_handler.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Files with this extension are loaded as snapshots instead of LimeSuiteGUI .ini files
+#define LIMESDR_SNAPSHOT_EXT ".snap"
+
+/**
+ * Binary dump of LMS7002M and FPGA registers together with gr-limesdr settings
+ * of the device. All values are stored little-endian, so snapshot can be
+ * restored on any host.
+ */
+struct register_snapshot {
+    struct lms_register {
+        // Channel selected by MAC when register was read: 0 for shared registers, 1 (A), 2 (B)
+        uint16_t channel;
+        uint16_t address;
+        uint16_t value;
+    };
+    struct fpga_register {
+        uint16_t address;
+        uint16_t value;
+    };
+
+    std::vector<lms_register> lms;
+    std::vector<fpga_register> fpga;
+
+    double sample_rate = 0;
+    uint32_t oversample = 0;
+    // Applied configuration [direction][channel]
+    channel_config config[2][2];
+
+    /**
+     * @return  true if file was written
+     */
+    bool save(const std::string& filename) const;
+
+    /**
+     * @return  true if file was read and is a valid snapshot
+     */
+    bool load(const std::string& filename);
+};
+
+#endif
@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "ring_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+ring_buffer::ring_buffer(size_t capacity, size_t item_size)
+    : buffer(capacity * item_size), capacity_items(capacity), item_size(item_size), head(0),
+      tail(0), data_waiting(false), space_waiting(false) {}
+
+size_t ring_buffer::items_available() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+size_t ring_buffer::space_available() const { return capacity_items - items_available(); }
+
+void* ring_buffer::write_ptr(size_t& contiguous) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    size_t index = h % capacity_items;
+    contiguous = std::min(space_available(), capacity_items - index);
+    return &buffer[index * item_size];
+}
+
+// Position update and flag check are sequentially consistent, so a consumer raising the flag
+// either sees the new items or is seen waiting
+void ring_buffer::commit_write(size_t items) {
+    head.fetch_add(items);
+    if (data_waiting.load())
+        notify();
+}
+
+size_t ring_buffer::write(const void* src, size_t items) {
+    const char* in = static_cast<const char*>(src);
+    size_t written = 0;
+    // At most two passes are needed: up to the end of the buffer and from its start
+    while (written < items) {
+        size_t contiguous;
+        void* dst = write_ptr(contiguous);
+        size_t count = std::min(contiguous, items - written);
+        if (count == 0)
+            break;
+        std::memcpy(dst, in + written * item_size, count * item_size);
+        head.fetch_add(count);
+        written += count;
+    }
+    if (written > 0 && data_waiting.load())
+        notify();
+    return written;
+}
+
+const void* ring_buffer::read_ptr(size_t& contiguous) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    size_t index = t % capacity_items;
+    contiguous = std::min(items_available(), capacity_items - index);
+    return &buffer[index * item_size];
+}
+
+void ring_buffer::commit_read(size_t items) {
+    tail.fetch_add(items);
+    if (space_waiting.load()) {
+        { std::lock_guard<std::mutex> lock(wait_mutex); }
+        space_cond.notify_one();
+    }
+}
+
+size_t ring_buffer::read(void* dst, size_t items) {
+    char* out = static_cast<char*>(dst);
+    size_t done = 0;
+    while (done < items) {
+        size_t contiguous;
+        const void* src = read_ptr(contiguous);
+        size_t count = std::min(contiguous, items - done);
+        if (count == 0)
+            break;
+        std::memcpy(out + done * item_size, src, count * item_size);
+        commit_read(count);
+        done += count;
+    }
+    return done;
+}
+
+bool ring_buffer::wait_for_items(size_t items, std::chrono::milliseconds timeout) {
+    if (items_available() >= items)
+        return true;
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    // Flag is raised before checking items, so commit_write() can't miss the waiting consumer
+    data_waiting.store(true);
+    bool available =
+        data_cond.wait_for(lock, timeout, [&] { return items_available() >= items; });
+    data_waiting.store(false);
+    return available;
+}
+
+bool ring_buffer::wait_for_space(size_t items, std::chrono::milliseconds timeout) {
+    if (space_available() >= items)
+        return true;
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    // Flag is raised before checking space, so commit_read() can't miss the waiting producer
+    space_waiting.store(true);
+    bool available =
+        space_cond.wait_for(lock, timeout, [&] { return space_available() >= items; });
+    space_waiting.store(false);
+    return available;
+}
+
+void ring_buffer::notify() {
+    // Take the mutex so the wakeup can't slip in between consumer's check and wait
+    { std::lock_guard<std::mutex> lock(wait_mutex); }
+    data_cond.notify_one();
+}
+
+void ring_buffer::reset() {
+    head.store(0);
+    tail.store(0);
+}
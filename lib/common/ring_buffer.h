@@ -0,0 +1,162 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Single-producer/single-consumer ring buffer of fixed size items.
+ * Producer and consumer never block each other: positions are kept in
+ * atomic monotonic counters and data is written/read without locking.
+ * The mutex is only used to sleep the consumer while the ring is empty
+ * or the producer while the ring is full, and is taken by the other side
+ * only when one of them is actually sleeping.
+ */
+class ring_buffer {
+    private:
+    std::vector<char> buffer;
+    size_t capacity_items;
+    size_t item_size;
+
+    // Total items written (producer) and read (consumer) since reset
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+
+    std::mutex wait_mutex;
+    std::condition_variable data_cond;
+    std::condition_variable space_cond;
+    // Consumer sleeps in wait_for_items(), producer has to wake it up
+    std::atomic<bool> data_waiting;
+    // Producer sleeps in wait_for_space(), consumer has to wake it up
+    std::atomic<bool> space_waiting;
+
+    public:
+    /**
+     * @param   capacity  Ring capacity in items.
+     *
+     * @param   item_size Size of one item in bytes.
+     */
+    ring_buffer(size_t capacity, size_t item_size);
+
+    size_t capacity() const { return capacity_items; }
+
+    /**
+     * Number of items that can be read by consumer.
+     */
+    size_t items_available() const;
+
+    /**
+     * Number of items that can be written by producer.
+     */
+    size_t space_available() const;
+
+    /**
+     * Total number of items written to the ring (producer position).
+     */
+    uint64_t items_written() const { return head.load(std::memory_order_acquire); }
+
+    /**
+     * Total number of items read from the ring (consumer position).
+     */
+    uint64_t items_read() const { return tail.load(std::memory_order_acquire); }
+
+    /**
+     * Get pointer to contiguous free region, so producer could write directly to the ring.
+     *
+     * @param   contiguous  Returns number of items that can be written to returned pointer.
+     */
+    void* write_ptr(size_t& contiguous);
+
+    /**
+     * Publish items written to write_ptr() region and wake up the consumer.
+     *
+     * @param   items  Number of items written.
+     */
+    void commit_write(size_t items);
+
+    /**
+     * Copy items into the ring handling wrap around.
+     *
+     * @return number of items written (less than requested if ring is full)
+     */
+    size_t write(const void* src, size_t items);
+
+    /**
+     * Get pointer to contiguous readable region.
+     *
+     * @param   contiguous  Returns number of items that can be read from returned pointer.
+     */
+    const void* read_ptr(size_t& contiguous);
+
+    /**
+     * Release items read from read_ptr() region.
+     *
+     * @param   items  Number of items read.
+     */
+    void commit_read(size_t items);
+
+    /**
+     * Copy items out of the ring handling wrap around.
+     *
+     * @return number of items read (less than requested if ring holds less)
+     */
+    size_t read(void* dst, size_t items);
+
+    /**
+     * Wait until at least the required number of items is available.
+     *
+     * @param   items    Number of items to wait for.
+     *
+     * @param   timeout  Maximum wait time.
+     *
+     * @return  true if items are available
+     */
+    bool wait_for_items(size_t items, std::chrono::milliseconds timeout);
+
+    /**
+     * Wait until space for at least the required number of items is available.
+     *
+     * @param   items    Number of items to wait for.
+     *
+     * @param   timeout  Maximum wait time.
+     *
+     * @return  true if space is available
+     */
+    bool wait_for_space(size_t items, std::chrono::milliseconds timeout);
+
+    /**
+     * Wake up the consumer waiting in wait_for_items().
+     */
+    void notify();
+
+    /**
+     * Drop all ring contents. Must not be called while producer or consumer is running.
+     */
+    void reset();
+};
+
+#endif
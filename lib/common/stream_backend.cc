@@ -0,0 +1,51 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "stream_backend.h"
+
+int lms_stream_backend::setup(lms_stream_t* stream) { return LMS_SetupStream(device, stream); }
+
+int lms_stream_backend::destroy(lms_stream_t* stream) {
+    return LMS_DestroyStream(device, stream);
+}
+
+int lms_stream_backend::start(lms_stream_t* stream) { return LMS_StartStream(stream); }
+
+int lms_stream_backend::stop(lms_stream_t* stream) { return LMS_StopStream(stream); }
+
+int lms_stream_backend::recv(lms_stream_t* stream,
+                             void* samples,
+                             size_t sample_count,
+                             lms_stream_meta_t* meta,
+                             unsigned timeout_ms) {
+    return LMS_RecvStream(stream, samples, sample_count, meta, timeout_ms);
+}
+
+int lms_stream_backend::send(lms_stream_t* stream,
+                             const void* samples,
+                             size_t sample_count,
+                             const lms_stream_meta_t* meta,
+                             unsigned timeout_ms) {
+    return LMS_SendStream(stream, samples, sample_count, meta, timeout_ms);
+}
+
+int lms_stream_backend::status(lms_stream_t* stream, lms_stream_status_t* status) {
+    return LMS_GetStreamStatus(stream, status);
+}
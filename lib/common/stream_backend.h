@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef STREAM_BACKEND_H
+#define STREAM_BACKEND_H
+
+#include <LimeSuite.h>
+#include <cstddef>
+
+/**
+ * Sample stream interface of one device. Blocks setup, start and move samples through it
+ * instead of calling LMS_*Stream functions directly, so streaming can run without hardware.
+ * Functions take the same arguments and return the same values as their LimeSuite
+ * counterparts.
+ */
+class stream_backend {
+    public:
+    virtual ~stream_backend() {}
+
+    virtual int setup(lms_stream_t* stream) = 0;
+    virtual int destroy(lms_stream_t* stream) = 0;
+    virtual int start(lms_stream_t* stream) = 0;
+    virtual int stop(lms_stream_t* stream) = 0;
+
+    virtual int recv(lms_stream_t* stream,
+                     void* samples,
+                     size_t sample_count,
+                     lms_stream_meta_t* meta,
+                     unsigned timeout_ms) = 0;
+    virtual int send(lms_stream_t* stream,
+                     const void* samples,
+                     size_t sample_count,
+                     const lms_stream_meta_t* meta,
+                     unsigned timeout_ms) = 0;
+
+    virtual int status(lms_stream_t* stream, lms_stream_status_t* status) = 0;
+};
+
+/**
+ * Streams of real device, passed to LimeSuite.
+ */
+class lms_stream_backend : public stream_backend {
+    private:
+    lms_device_t* device;
+
+    public:
+    /**
+     * @param   device  Device connection handler the streams belong to.
+     */
+    lms_stream_backend(lms_device_t* device) : device(device) {}
+
+    int setup(lms_stream_t* stream) override;
+    int destroy(lms_stream_t* stream) override;
+    int start(lms_stream_t* stream) override;
+    int stop(lms_stream_t* stream) override;
+
+    int recv(lms_stream_t* stream,
+             void* samples,
+             size_t sample_count,
+             lms_stream_meta_t* meta,
+             unsigned timeout_ms) override;
+    int send(lms_stream_t* stream,
+             const void* samples,
+             size_t sample_count,
+             const lms_stream_meta_t* meta,
+             unsigned timeout_ms) override;
+
+    int status(lms_stream_t* stream, lms_stream_status_t* status) override;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "stream_telemetry.h"
+
+static const pmt::pmt_t KEY_FIFO_FILLED = pmt::string_to_symbol("fifoFilledCount");
+static const pmt::pmt_t KEY_FIFO_SIZE = pmt::string_to_symbol("fifoSize");
+static const pmt::pmt_t KEY_UNDERRUN = pmt::string_to_symbol("underrun");
+static const pmt::pmt_t KEY_OVERRUN = pmt::string_to_symbol("overrun");
+static const pmt::pmt_t KEY_DROPPED = pmt::string_to_symbol("droppedPackets");
+static const pmt::pmt_t KEY_LINK_RATE = pmt::string_to_symbol("linkRate");
+static const pmt::pmt_t KEY_TIMESTAMP = pmt::string_to_symbol("timestamp");
+static const pmt::pmt_t KEY_CHANNEL = pmt::string_to_symbol("channel");
+
+void stream_telemetry::reset(bool subscribed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    connected = subscribed;
+    accumulated[0] = counters();
+    accumulated[1] = counters();
+    last = std::chrono::high_resolution_clock::now();
+}
+
+void stream_telemetry::accumulate(int channel, const lms_stream_status_t& status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    accumulated[channel].underrun += status.underrun;
+    accumulated[channel].overrun += status.overrun;
+    accumulated[channel].dropped_packets += status.droppedPackets;
+    totals[channel].underrun += status.underrun;
+    totals[channel].overrun += status.overrun;
+    totals[channel].dropped_packets += status.droppedPackets;
+}
+
+stream_telemetry::counters stream_telemetry::total(int channel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals[channel];
+}
+
+bool stream_telemetry::due() {
+    auto now = std::chrono::high_resolution_clock::now();
+    if (std::chrono::duration<double>(now - last).count() * rate < 1.0)
+        return false;
+    last = now;
+    return true;
+}
+
+pmt::pmt_t stream_telemetry::make_report(int channel, const lms_stream_status_t& status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pmt::pmt_t report = pmt::make_dict();
+    report = pmt::dict_add(report, KEY_CHANNEL, pmt::from_long(channel));
+    report = pmt::dict_add(report, KEY_FIFO_FILLED, pmt::from_long(status.fifoFilledCount));
+    report = pmt::dict_add(report, KEY_FIFO_SIZE, pmt::from_long(status.fifoSize));
+    report = pmt::dict_add(
+        report, KEY_UNDERRUN, pmt::from_uint64(accumulated[channel].underrun));
+    report =
+        pmt::dict_add(report, KEY_OVERRUN, pmt::from_uint64(accumulated[channel].overrun));
+    report = pmt::dict_add(
+        report, KEY_DROPPED, pmt::from_uint64(accumulated[channel].dropped_packets));
+    report = pmt::dict_add(report, KEY_LINK_RATE, pmt::from_double(status.linkRate));
+    report = pmt::dict_add(report, KEY_TIMESTAMP, pmt::from_uint64(status.timestamp));
+    accumulated[channel] = counters();
+    return report;
+}
@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef STREAM_TELEMETRY_H
+#define STREAM_TELEMETRY_H
+
+#include <LimeSuite.h>
+#include <chrono>
+#include <mutex>
+#include <pmt/pmt.h>
+
+static const pmt::pmt_t TELEMETRY_PORT = pmt::string_to_symbol("telemetry");
+
+/**
+ * Periodic stream status report published as PMT dictionary.
+ * LimeSuite resets underrun, overrun and droppedPackets counters every time stream status is
+ * read, so every read of the block is added here: counters are accumulated between reports
+ * and into totals other readers take differences of. Nothing is published when no block
+ * is subscribed.
+ */
+class stream_telemetry {
+    public:
+    struct counters {
+        uint64_t underrun = 0;
+        uint64_t overrun = 0;
+        uint64_t dropped_packets = 0;
+    };
+
+    private:
+    counters accumulated[2];
+    // Never cleared, so readers keeping their last seen value get exact differences
+    counters totals[2];
+    // Status may also be read by control threads
+    std::mutex mutex;
+
+    bool connected = false;
+    double rate = 1.0;
+    std::chrono::high_resolution_clock::time_point last;
+
+    public:
+    /**
+     * Clear report counters and check whether reports are needed.
+     *
+     * @param   subscribed  Telemetry port has subscribers.
+     */
+    void reset(bool subscribed);
+
+    /**
+     * @param   rate_hz  Reports per second, 0 disables telemetry.
+     */
+    void set_rate(double rate_hz) { rate = (rate_hz < 0) ? 0 : rate_hz; }
+
+    double get_rate() const { return rate; }
+
+    bool enabled() const { return connected && rate > 0; }
+
+    /**
+     * Add counters of freshly read stream status.
+     *
+     * @param   channel  Stream channel.
+     *
+     * @param   status   Stream status returned by LMS_GetStreamStatus().
+     */
+    void accumulate(int channel, const lms_stream_status_t& status);
+
+    /**
+     * Counters of all status reads since block was created.
+     *
+     * @param   channel  Stream channel.
+     */
+    counters total(int channel);
+
+    /**
+     * Check if the next report should be published and restart report period.
+     */
+    bool due();
+
+    /**
+     * Build report and clear counters of the channel.
+     *
+     * @param   channel  Stream channel.
+     *
+     * @param   status   Latest stream status of the channel.
+     *
+     * @return  dictionary with fifoFilledCount, fifoSize, underrun, overrun, droppedPackets,
+     *          linkRate, timestamp and channel
+     */
+    pmt::pmt_t make_report(int channel, const lms_stream_status_t& status);
+};
+
+#endif
@@ -0,0 +1,122 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common/calibration_cache.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+// Tests run in build directory, files are created there
+static const char* cache_file = "qa_calibration_cache.cal";
+
+static calibration_cache::entry make_entry(double lo, double bandwidth, int64_t time) {
+    calibration_cache::entry e;
+    e.direction = 0;
+    e.channel = 1;
+    e.lo = lo;
+    e.bandwidth = bandwidth;
+    e.gain_band = 3;
+    e.temperature = 40;
+    e.time = time;
+    e.values = {0x0123, 0x0456, 0x0789};
+    return e;
+}
+
+BOOST_AUTO_TEST_SUITE(calibration_cache_test)
+
+BOOST_AUTO_TEST_CASE(store_and_reload) {
+    std::remove(cache_file);
+    int64_t now = std::time(NULL);
+    {
+        calibration_cache cache;
+        calibration_cache::entry match;
+        BOOST_CHECK(!cache.find(make_entry(1e9, 10e6, now), match));
+        cache.open(cache_file);
+        BOOST_CHECK(cache.enabled());
+        cache.store(make_entry(1e9, 10e6, now));
+    }
+    // Entry is read back from file by another cache
+    calibration_cache cache;
+    cache.open(cache_file);
+    calibration_cache::entry match;
+    BOOST_REQUIRE(cache.find(make_entry(1e9 + 0.5e6, 10.5e6, now), match));
+    BOOST_CHECK_EQUAL(match.lo, 1e9);
+    BOOST_CHECK_EQUAL(match.gain_band, 3);
+    std::vector<uint16_t> values = make_entry(0, 0, 0).values;
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+        match.values.begin(), match.values.end(), values.begin(), values.end());
+    std::remove(cache_file);
+}
+
+BOOST_AUTO_TEST_CASE(operating_point_tolerances) {
+    std::remove(cache_file);
+    int64_t now = std::time(NULL);
+    calibration_cache cache;
+    cache.open(cache_file);
+    cache.store(make_entry(1e9, 10e6, now));
+    calibration_cache::entry match;
+
+    // LO, bandwidth and gain band must be close to calibrated operating point
+    BOOST_CHECK(!cache.find(make_entry(1e9 + 2e6, 10e6, now), match));
+    BOOST_CHECK(!cache.find(make_entry(1e9, 12e6, now), match));
+    calibration_cache::entry other_band = make_entry(1e9, 10e6, now);
+    other_band.gain_band = 4;
+    BOOST_CHECK(!cache.find(other_band, match));
+    calibration_cache::entry other_channel = make_entry(1e9, 10e6, now);
+    other_channel.channel = 0;
+    BOOST_CHECK(!cache.find(other_channel, match));
+
+    // Both entries are within tolerance, closest LO wins
+    cache.store(make_entry(1e9 + 1.5e6, 10e6, now));
+    BOOST_REQUIRE(cache.find(make_entry(1e9 + 0.9e6, 10e6, now), match));
+    BOOST_CHECK_EQUAL(match.lo, 1e9 + 1.5e6);
+    BOOST_REQUIRE(cache.find(make_entry(1e9 + 0.6e6, 10e6, now), match));
+    BOOST_CHECK_EQUAL(match.lo, 1e9);
+    std::remove(cache_file);
+}
+
+BOOST_AUTO_TEST_CASE(stale_entries_removed) {
+    std::remove(cache_file);
+    int64_t now = std::time(NULL);
+    calibration_cache cache;
+    cache.open(cache_file);
+    cache.store(make_entry(1e9, 10e6, now));
+    calibration_cache::entry match;
+
+    // Temperature drift invalidates calibration
+    calibration_cache::entry warm = make_entry(1e9, 10e6, now);
+    warm.temperature += LIMESDR_CAL_TEMP_TOLERANCE + 1;
+    BOOST_CHECK(!cache.find(warm, match));
+    BOOST_CHECK(!cache.find(make_entry(1e9, 10e6, now), match));
+
+    // So does age
+    cache.store(make_entry(1e9, 10e6, now));
+    BOOST_CHECK(!cache.find(make_entry(1e9, 10e6, now + LIMESDR_CAL_MAX_AGE), match));
+    BOOST_CHECK(!cache.find(make_entry(1e9, 10e6, now), match));
+
+    // Closed cache neither finds nor stores
+    cache.close();
+    cache.store(make_entry(1e9, 10e6, now));
+    BOOST_CHECK(!cache.find(make_entry(1e9, 10e6, now), match));
+    std::remove(cache_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
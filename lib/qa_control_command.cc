@@ -0,0 +1,92 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common/control_command.h"
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <string>
+
+static pmt::pmt_t command(const char* key, const pmt::pmt_t& value) {
+    return pmt::dict_add(pmt::make_dict(), pmt::string_to_symbol(key), value);
+}
+
+static std::string reply_value(const pmt::pmt_t& reply, const char* key) {
+    return pmt::symbol_to_string(
+        pmt::dict_ref(reply, pmt::string_to_symbol(key), pmt::string_to_symbol("")));
+}
+
+BOOST_AUTO_TEST_SUITE(control_command_test)
+
+BOOST_AUTO_TEST_CASE(valid_commands) {
+    pmt::pmt_t msg = command("freq", pmt::from_double(2.4e9));
+    msg = pmt::dict_add(msg, pmt::string_to_symbol("gain"), pmt::from_long(30));
+    msg = pmt::dict_add(msg, pmt::string_to_symbol("chan"), pmt::from_long(1));
+    msg = pmt::dict_add(msg, pmt::string_to_symbol("time"), pmt::from_double(1.5));
+    control_command cmd;
+    std::string error;
+    BOOST_REQUIRE(cmd.parse(msg, error));
+    BOOST_CHECK(error.empty());
+    BOOST_CHECK_EQUAL(cmd.freq, 2.4e9);
+    BOOST_CHECK_EQUAL(cmd.gain, 30);
+    BOOST_CHECK_EQUAL(cmd.channel, 1);
+    BOOST_CHECK_EQUAL(cmd.time, 1.5);
+    // Keys not present stay unset
+    BOOST_CHECK(std::isnan(cmd.bw));
+    BOOST_CHECK(std::isnan(cmd.nco));
+
+    pmt::pmt_t reply = cmd.reply("");
+    BOOST_CHECK_EQUAL(reply_value(reply, "status"), "ok");
+    BOOST_CHECK(pmt::dict_has_key(reply, pmt::string_to_symbol("freq")));
+
+    control_command nco;
+    BOOST_CHECK(nco.parse(command("nco", pmt::from_double(-1e6)), error));
+    BOOST_CHECK_EQUAL(nco.nco, -1e6);
+    BOOST_CHECK_EQUAL(nco.channel, 0);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_commands) {
+    struct {
+        pmt::pmt_t msg;
+        const char* error;
+    } cases[] = {
+        {pmt::from_double(1e9), "command must be a dictionary"},
+        {command("freq", pmt::string_to_symbol("1e9")), "command values must be numbers"},
+        {pmt::dict_add(command("freq", pmt::from_double(1e9)),
+                       pmt::string_to_symbol("chan"),
+                       pmt::from_long(2)),
+         "chan must be 0 or 1"},
+        {command("freq", pmt::from_double(0)), "freq must be more than 0 Hz"},
+        {command("gain", pmt::from_double(74)), "gain must be in range [0, 73] dB"},
+        {command("bw", pmt::from_double(-1)), "bw must not be negative"},
+        {command("time", pmt::from_double(1)), "command has no freq, gain, bw or nco"},
+    };
+    for (auto& c : cases) {
+        control_command cmd;
+        std::string error;
+        BOOST_CHECK(!cmd.parse(c.msg, error));
+        BOOST_CHECK_EQUAL(error, c.error);
+
+        pmt::pmt_t reply = cmd.reply(error);
+        BOOST_CHECK_EQUAL(reply_value(reply, "status"), "error");
+        BOOST_CHECK_EQUAL(reply_value(reply, "error"), c.error);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,134 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/top_block.h>
+#include <limesdr/source.h>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Collects rx_time tags of the first samples received from the source
+class capture_sink : public gr::sync_block {
+    public:
+#ifdef LIMESDR_GR_STD_SPTR
+    typedef std::shared_ptr<capture_sink> sptr;
+#else
+    typedef boost::shared_ptr<capture_sink> sptr;
+#endif
+
+    struct time_tag {
+        uint64_t offset;
+        int64_t timestamp;
+    };
+
+    capture_sink(uint64_t wanted, double rate)
+        : gr::sync_block("capture_sink",
+                         gr::io_signature::make(1, 1, 2 * sizeof(float)),
+                         gr::io_signature::make(0, 0, 0)),
+          wanted(wanted),
+          rate(rate) {}
+
+    uint64_t samples = 0;
+    std::vector<time_tag> tags;
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items) {
+        std::vector<gr::tag_t> found;
+        get_tags_in_range(found,
+                          0,
+                          nitems_read(0),
+                          nitems_read(0) + noutput_items,
+                          pmt::string_to_symbol("rx_time"));
+        for (const gr::tag_t& tag : found) {
+            uint64_t secs = pmt::to_uint64(pmt::tuple_ref(tag.value, 0));
+            double fracs = pmt::to_double(pmt::tuple_ref(tag.value, 1));
+            tags.push_back({tag.offset, llround(secs * rate + fracs * rate)});
+        }
+        samples += noutput_items;
+        return (samples >= wanted) ? WORK_DONE : noutput_items;
+    }
+
+    private:
+    uint64_t wanted;
+    double rate;
+};
+
+// Streams mock device until wanted samples are received
+capture_sink::sptr stream_mock(const std::string& serial, uint64_t wanted) {
+    gr::top_block_sptr tb = gr::make_top_block("qa_mock_stream");
+    gr::limesdr::source::sptr source = gr::limesdr::source::make(serial, 0, "", false, 0);
+    double rate = source->set_sample_rate(1e6);
+    BOOST_REQUIRE_EQUAL(rate, 1e6);
+    capture_sink::sptr sink(new capture_sink(wanted, rate));
+    tb->connect(source, 0, sink, 0);
+    tb->run();
+    return sink;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(mock_stream_test)
+
+BOOST_AUTO_TEST_CASE(continuous_stream) {
+    const uint64_t wanted = 200000;
+    capture_sink::sptr sink = stream_mock("mock:unpaced=1", wanted);
+    BOOST_CHECK_GE(sink->samples, wanted);
+    // First sample is tagged with stream start, no samples are lost afterwards
+    BOOST_REQUIRE(!sink->tags.empty());
+    BOOST_CHECK_EQUAL(sink->tags[0].offset, 0u);
+    BOOST_CHECK_EQUAL(sink->tags[0].timestamp, 0);
+    for (const capture_sink::time_tag& tag : sink->tags)
+        BOOST_CHECK_EQUAL(tag.timestamp, (int64_t)tag.offset);
+}
+
+BOOST_AUTO_TEST_CASE(receive_timeout) {
+    // Samples are delivered 300 ms after their timestamp, so first reads time out
+    const uint64_t wanted = 200000;
+    capture_sink::sptr sink = stream_mock("mock:latency=300", wanted);
+    BOOST_CHECK_GE(sink->samples, wanted);
+    // Timed out reads must not add tags with stale timestamps
+    BOOST_REQUIRE(!sink->tags.empty());
+    BOOST_CHECK_EQUAL(sink->tags[0].offset, 0u);
+    for (const capture_sink::time_tag& tag : sink->tags)
+        BOOST_CHECK_EQUAL(tag.timestamp, (int64_t)tag.offset);
+}
+
+BOOST_AUTO_TEST_CASE(dropped_samples_tagged) {
+    // Mock drops 4080 samples every 10 ms of stream time
+    const uint64_t wanted = 200000;
+    capture_sink::sptr sink =
+        stream_mock("mock:unpaced=1,drop_interval=0.01,drop=4080", wanted);
+    BOOST_CHECK_GE(sink->samples, wanted);
+    BOOST_REQUIRE_GT(sink->tags.size(), 2u);
+    BOOST_CHECK_EQUAL(sink->tags[0].offset, 0u);
+    // Every tag after the first one marks one drop
+    for (size_t i = 1; i < sink->tags.size(); i++) {
+        int64_t jump = (sink->tags[i].timestamp - sink->tags[i - 1].timestamp) -
+                       (int64_t)(sink->tags[i].offset - sink->tags[i - 1].offset);
+        BOOST_CHECK_EQUAL(jump, 4080);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,94 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common/register_snapshot.h"
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Tests run in build directory, files are created there
+static const char* snapshot_file = "qa_register_snapshot.snap";
+
+BOOST_AUTO_TEST_SUITE(register_snapshot_test)
+
+BOOST_AUTO_TEST_CASE(save_and_load) {
+    register_snapshot saved;
+    saved.lms = {{0, 0x0020, 0xFFFD}, {1, 0x0100, 0x3409}, {2, 0x0100, 0x3408}};
+    saved.fpga = {{0x0003, 0x0001}, {0x000A, 0x4000}};
+    saved.sample_rate = 30.72e6;
+    saved.oversample = 4;
+    saved.config[LMS_CH_RX][0].rf_freq = 2.4e9;
+    saved.config[LMS_CH_RX][0].gain_dB = 42;
+    saved.config[LMS_CH_TX][1].analog_bandw = 5e6;
+    BOOST_REQUIRE(saved.save(snapshot_file));
+
+    register_snapshot loaded;
+    BOOST_REQUIRE(loaded.load(snapshot_file));
+    BOOST_REQUIRE_EQUAL(loaded.lms.size(), saved.lms.size());
+    for (size_t i = 0; i < saved.lms.size(); i++) {
+        BOOST_CHECK_EQUAL(loaded.lms[i].channel, saved.lms[i].channel);
+        BOOST_CHECK_EQUAL(loaded.lms[i].address, saved.lms[i].address);
+        BOOST_CHECK_EQUAL(loaded.lms[i].value, saved.lms[i].value);
+    }
+    BOOST_REQUIRE_EQUAL(loaded.fpga.size(), saved.fpga.size());
+    for (size_t i = 0; i < saved.fpga.size(); i++) {
+        BOOST_CHECK_EQUAL(loaded.fpga[i].address, saved.fpga[i].address);
+        BOOST_CHECK_EQUAL(loaded.fpga[i].value, saved.fpga[i].value);
+    }
+    BOOST_CHECK_EQUAL(loaded.sample_rate, 30.72e6);
+    BOOST_CHECK_EQUAL(loaded.oversample, 4u);
+    BOOST_CHECK_EQUAL(loaded.config[LMS_CH_RX][0].rf_freq, 2.4e9);
+    BOOST_CHECK_EQUAL(loaded.config[LMS_CH_RX][0].gain_dB, 42);
+    BOOST_CHECK_EQUAL(loaded.config[LMS_CH_TX][1].analog_bandw, 5e6);
+    // Values never applied stay unset
+    BOOST_CHECK(std::isnan(loaded.config[LMS_CH_TX][0].rf_freq));
+    std::remove(snapshot_file);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_files) {
+    register_snapshot snapshot;
+    BOOST_CHECK(!snapshot.load("qa_register_snapshot_missing.snap"));
+
+    {
+        std::ofstream file(snapshot_file, std::ios::trunc);
+        file << "[LMS7002M registers]" << std::endl;
+    }
+    BOOST_CHECK(!snapshot.load(snapshot_file));
+
+    // Valid snapshot cut in the middle of register list
+    register_snapshot saved;
+    saved.lms.resize(16);
+    BOOST_REQUIRE(saved.save(snapshot_file));
+    std::vector<char> data;
+    {
+        std::ifstream file(snapshot_file, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream file(snapshot_file, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size() / 2);
+    }
+    BOOST_CHECK(!snapshot.load(snapshot_file));
+    std::remove(snapshot_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
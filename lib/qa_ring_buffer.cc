@@ -0,0 +1,135 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "common/ring_buffer.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(ring_buffer_test)
+
+BOOST_AUTO_TEST_CASE(write_read_wrap) {
+    ring_buffer ring(8, sizeof(uint32_t));
+    BOOST_CHECK_EQUAL(ring.capacity(), 8u);
+    BOOST_CHECK_EQUAL(ring.space_available(), 8u);
+
+    uint32_t in[6] = {1, 2, 3, 4, 5, 6};
+    uint32_t out[6] = {0};
+    BOOST_CHECK_EQUAL(ring.write(in, 6), 6u);
+    BOOST_CHECK_EQUAL(ring.read(out, 4), 4u);
+    // Second write wraps around end of the buffer
+    BOOST_CHECK_EQUAL(ring.write(in, 6), 6u);
+    BOOST_CHECK_EQUAL(ring.items_available(), 8u);
+    BOOST_CHECK_EQUAL(ring.space_available(), 0u);
+    BOOST_CHECK_EQUAL(ring.write(in, 1), 0u);
+
+    std::vector<uint32_t> all(8);
+    BOOST_CHECK_EQUAL(ring.read(all.data(), 8), 8u);
+    std::vector<uint32_t> expected = {5, 6, 1, 2, 3, 4, 5, 6};
+    BOOST_CHECK_EQUAL_COLLECTIONS(all.begin(), all.end(), expected.begin(), expected.end());
+    BOOST_CHECK_EQUAL(ring.items_written(), 12u);
+    BOOST_CHECK_EQUAL(ring.items_read(), 12u);
+}
+
+BOOST_AUTO_TEST_CASE(contiguous_regions) {
+    ring_buffer ring(8, sizeof(uint32_t));
+    uint32_t in[6] = {0};
+    uint32_t out[6];
+    ring.write(in, 6);
+    ring.read(out, 6);
+
+    // Free region ends at the end of the buffer
+    size_t contiguous;
+    uint32_t* dst = static_cast<uint32_t*>(ring.write_ptr(contiguous));
+    BOOST_REQUIRE(dst != nullptr);
+    BOOST_CHECK_EQUAL(contiguous, 2u);
+    dst[0] = 10;
+    dst[1] = 11;
+    ring.commit_write(2);
+
+    const uint32_t* src = static_cast<const uint32_t*>(ring.read_ptr(contiguous));
+    BOOST_REQUIRE(src != nullptr);
+    BOOST_CHECK_EQUAL(contiguous, 2u);
+    BOOST_CHECK_EQUAL(src[0], 10u);
+    BOOST_CHECK_EQUAL(src[1], 11u);
+    ring.commit_read(2);
+    BOOST_CHECK_EQUAL(ring.items_available(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(wait_and_reset) {
+    ring_buffer ring(16, sizeof(uint32_t));
+    BOOST_CHECK(!ring.wait_for_items(1, std::chrono::milliseconds(10)));
+    BOOST_CHECK(ring.wait_for_space(16, std::chrono::milliseconds(10)));
+
+    std::thread producer([&ring]() {
+        uint32_t value = 7;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ring.write(&value, 1);
+    });
+    BOOST_CHECK(ring.wait_for_items(1, std::chrono::milliseconds(1000)));
+    producer.join();
+
+    ring.reset();
+    BOOST_CHECK_EQUAL(ring.items_available(), 0u);
+    BOOST_CHECK_EQUAL(ring.space_available(), 16u);
+}
+
+// Consumer sleeping in wait_for_items() is woken by commit_write(), not by its timeout
+BOOST_AUTO_TEST_CASE(commit_wakes_consumer) {
+    ring_buffer ring(16, sizeof(uint32_t));
+    std::thread producer([&ring]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        size_t contiguous;
+        ring.write_ptr(contiguous);
+        ring.commit_write(4);
+    });
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK(ring.wait_for_items(4, std::chrono::milliseconds(5000)));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2000));
+    producer.join();
+}
+
+// Items must arrive in order when producer and consumer run concurrently
+BOOST_AUTO_TEST_CASE(concurrent_order) {
+    const uint32_t count = 100000;
+    ring_buffer ring(64, sizeof(uint32_t));
+    std::thread producer([&ring, count]() {
+        for (uint32_t i = 0; i < count;) {
+            if (!ring.wait_for_space(1, std::chrono::milliseconds(100)))
+                continue;
+            i += ring.write(&i, 1);
+        }
+    });
+    uint32_t expected = 0;
+    bool in_order = true;
+    while (expected < count) {
+        if (!ring.wait_for_items(1, std::chrono::milliseconds(100)))
+            continue;
+        uint32_t value;
+        ring.read(&value, 1);
+        in_order &= (value == expected);
+        expected++;
+    }
+    producer.join();
+    BOOST_CHECK(in_order);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
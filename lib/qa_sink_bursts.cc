@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "sink_impl.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+using gr::limesdr::sink_impl;
+
+static gr::tag_t make_tag(uint64_t offset, const char* key, const pmt::pmt_t& value) {
+    gr::tag_t tag;
+    tag.offset = offset;
+    tag.key = pmt::string_to_symbol(key);
+    tag.value = value;
+    return tag;
+}
+
+BOOST_AUTO_TEST_SUITE(sink_bursts_test)
+
+BOOST_AUTO_TEST_CASE(events_sorted_by_sample) {
+    // Tags are not sorted by offset, tx_eob applies after its tagged sample
+    std::vector<gr::tag_t> tags = {
+        make_tag(1099, "tx_eob", pmt::PMT_T),
+        make_tag(100, "tx_sob", pmt::PMT_T),
+        make_tag(100, "tx_time", pmt::make_tuple(pmt::from_uint64(1), pmt::from_double(0.5))),
+        make_tag(500, "tx_hop", pmt::from_long(2)),
+        make_tag(300, "other", pmt::PMT_T),
+    };
+    std::vector<sink_impl::burst_event> events;
+    sink_impl::make_burst_events(tags, pmt::PMT_NIL, events);
+
+    BOOST_REQUIRE_EQUAL(events.size(), 4u);
+    BOOST_CHECK(events[0].type == sink_impl::burst_event::SOB);
+    BOOST_CHECK_EQUAL(events[0].offset, 100u);
+    // Events at the same sample keep order of tags
+    BOOST_CHECK(events[1].type == sink_impl::burst_event::TIME);
+    BOOST_CHECK_EQUAL(events[1].offset, 100u);
+    BOOST_CHECK(events[2].type == sink_impl::burst_event::HOP);
+    BOOST_CHECK_EQUAL(pmt::to_long(events[2].value), 2);
+    BOOST_CHECK(events[3].type == sink_impl::burst_event::EOB);
+    BOOST_CHECK_EQUAL(events[3].offset, 1100u);
+}
+
+BOOST_AUTO_TEST_CASE(length_tag) {
+    std::vector<gr::tag_t> tags = {
+        make_tag(0, "packet_len", pmt::from_long(256)),
+        make_tag(256, "packet_len", pmt::from_long(128)),
+    };
+    std::vector<sink_impl::burst_event> events;
+    // Length tags are skipped unless their key is configured
+    sink_impl::make_burst_events(tags, pmt::PMT_NIL, events);
+    BOOST_CHECK(events.empty());
+
+    sink_impl::make_burst_events(tags, pmt::string_to_symbol("packet_len"), events);
+    BOOST_REQUIRE_EQUAL(events.size(), 2u);
+    BOOST_CHECK(events[0].type == sink_impl::burst_event::LENGTH);
+    BOOST_CHECK_EQUAL(pmt::to_long(events[0].value), 256);
+    BOOST_CHECK_EQUAL(events[1].offset, 256u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -50,6 +50,7 @@ rfe::rfe(int comm_type,
     boardState.mode = Mode;
     boardState.notchOnOff = Notch;
     boardState.attValue = Atten;
+    this->comm_type = comm_type;
 
     if (comm_type) // SDR GPIO communication
     {
@@ -112,6 +113,8 @@ rfe::rfe(int comm_type,
     }
     std::cout << "LimeRFE: Board state: " << std::endl;
     get_board_state();
+    // Board state is read by device handler health monitor from now on
+    device_handler::getInstance().set_rfe_monitor(rfe_dev);
     std::cout << "---------------------------------------------------------------"
               << std::endl;
 }
@@ -119,7 +122,12 @@ rfe::rfe(int comm_type,
 rfe::~rfe()
 {
     std::cout << "LimeRFE: closing" << std::endl;
+    // Sink must not switch the board after it has been closed
+    if (tdd)
+        device_handler::getInstance().set_rfe_tdd(nullptr, false);
+    device_handler::getInstance().set_rfe_monitor(nullptr);
     if (rfe_dev) {
+        std::lock_guard<std::mutex> lock(device_handler::getInstance().get_rfe_mutex());
         RFE_Reset(rfe_dev);
         RFE_Close(rfe_dev);
     }
@@ -142,6 +150,7 @@ int rfe::change_mode(int mode)
             std::cout << "LimeRFE: invalid mode" << std::endl;
         std::string mode_str[4] = { "RX", "TX", "NONE", "RX+TX" };
         std::cout << "LimeRFE: changing mode to " << mode_str[mode] << std::endl;
+        std::lock_guard<std::mutex> lock(device_handler::getInstance().get_rfe_mutex());
         if ((error = RFE_Mode(rfe_dev, mode)) != 0) {
             std::cout << "LimeRFE: failed to change mode:";
             print_error(error);
@@ -159,6 +168,7 @@ int rfe::set_fan(int enable)
         std::string enable_str[2] = { "disabling", "enabling" };
         std::cout << "LimeRFE: " << enable_str[enable] << " fan" << std::endl;
         int error = 0;
+        std::lock_guard<std::mutex> lock(device_handler::getInstance().get_rfe_mutex());
         if ((error = RFE_Fan(rfe_dev, enable)) != 0) {
             std::cout << "LimeRFE: failed to change mode:";
             print_error(error);
@@ -183,6 +193,7 @@ int rfe::set_attenuation(int attenuation)
         ;
 
         boardState.attValue = attenuation;
+        std::lock_guard<std::mutex> lock(device_handler::getInstance().get_rfe_mutex());
         if ((error = RFE_ConfigureState(rfe_dev, boardState)) != 0) {
             std::cout << "LimeRFE: failed to change attenuation: ";
             print_error(error);
@@ -206,6 +217,7 @@ int rfe::set_notch(int enable)
         boardState.notchOnOff = enable;
         std::string en_dis[2] = { "disabling", "enabling" };
         std::cout << "LimeRFE: " << en_dis[enable] << " notch filter" << std::endl;
+        std::lock_guard<std::mutex> lock(device_handler::getInstance().get_rfe_mutex());
         if ((error = RFE_ConfigureState(rfe_dev, boardState)) != 0) {
             std::cout << "LimeRFE: failed to change change attenuation: ";
             print_error(error);
@@ -214,6 +226,50 @@ int rfe::set_notch(int enable)
     }
     return -1;
 }
+int rfe::set_tdd(int enable)
+{
+    if (rfe_dev) {
+        if (enable && !comm_type)
+            std::cout << "LimeRFE: TDD switching over USB, GPIO communication has lower "
+                         "switching latency"
+                      << std::endl;
+        tdd = enable;
+        device_handler::getInstance().set_rfe_tdd(rfe_dev, tdd);
+        if (tdd)
+            boardState.mode = RFE_MODE_RX;
+        // Start in RX, sink switches to TX when a burst starts
+        return tdd ? device_handler::getInstance().rfe_switch(false) : 0;
+    }
+    std::cout << "LimeRFE: no RFE device opened" << std::endl;
+    return -1;
+}
+
+double rfe::get_tdd_latency()
+{
+    double last_us, max_us;
+    uint64_t count;
+    device_handler::getInstance().get_rfe_switch_stats(last_us, max_us, count);
+    return last_us;
+}
+
+double rfe::get_tdd_max_latency()
+{
+    double last_us, max_us;
+    uint64_t count;
+    device_handler::getInstance().get_rfe_switch_stats(last_us, max_us, count);
+    return max_us;
+}
+
+std::vector<int> rfe::get_cached_state()
+{
+    rfe_boardState state;
+    if (!device_handler::getInstance().get_rfe_health(state))
+        return std::vector<int>();
+    return { state.channelIDRX, state.channelIDTX, state.selPortRX,
+             state.selPortTX,   state.mode,        state.notchOnOff,
+             state.attValue,    state.enableSWR,   state.sourceSWR };
+}
+
 void rfe::print_error(int error)
 {
     switch (error) {
@@ -24,25 +24,36 @@
 
 #include "sink_impl.h"
 #include <gnuradio/io_signature.h>
+#include <gnuradio/realtime.h>
+#include <gnuradio/thread/thread.h>
+#include <algorithm>
 
 namespace gr {
 namespace limesdr {
 sink::sptr sink::make(std::string serial,
                       int channel_mode,
                       const std::string& filename,
-                      const std::string& length_tag_name) {
+                      const std::string& length_tag_name,
+                      int data_format) {
+#ifdef LIMESDR_GR_STD_SPTR
+    return gnuradio::make_block_sptr<sink_impl>(
+        serial, channel_mode, filename, length_tag_name, data_format);
+#else
     return gnuradio::get_initial_sptr(
-        new sink_impl(serial, channel_mode, filename, length_tag_name));
+        new sink_impl(serial, channel_mode, filename, length_tag_name, data_format));
+#endif
 }
 
 sink_impl::sink_impl(std::string serial,
                      int channel_mode,
                      const std::string& filename,
-                     const std::string& length_tag_name)
+                     const std::string& length_tag_name,
+                     int data_format)
     : gr::block(
           "sink",
           args_to_io_signature(
-              channel_mode), // Based on channel_mode SISO/MIMO use appropriate input signature
+              channel_mode,
+              data_format), // Based on channel_mode SISO/MIMO use appropriate input signature
           gr::io_signature::make(0, 0, 0)) {
     std::cout << "---------------------------------------------------------------" << std::endl;
     std::cout << "LimeSuite Sink (TX) info" << std::endl;
@@ -52,6 +63,8 @@ sink_impl::sink_impl(std::string serial,
     // 1. Store private variables upon implementation to protect from changing them later
     stored.serial = serial;
     stored.channel_mode = channel_mode;
+    stored.data_format = data_format;
+    stored.item_size = input_signature()->sizeof_stream_item(0);
 
     if (stored.channel_mode < 0 && stored.channel_mode > 2) {
         std::cout << "ERROR: sink_impl::sink_impl(): Channel must be A(1), B(2) or (A+B) MIMO(3)"
@@ -61,6 +74,7 @@ sink_impl::sink_impl(std::string serial,
 
     // 2. Open device if not opened
     stored.device_number = device_handler::getInstance().open_device(stored.serial);
+    backend = &device_handler::getInstance().get_stream_backend(stored.device_number);
     // 3. Check where to load settings from (file or block)
     if (!filename.empty()) {
         device_handler::getInstance().settings_from_file(stored.device_number, filename, pa_path);
@@ -78,9 +92,31 @@ sink_impl::sink_impl(std::string serial,
         // 6. Disable PA path
         this->toggle_pa_path(stored.device_number, false);
     }
+    // 7. Let shutdown and signal handlers switch TX off before any stream is torn down
+    device_handler::getInstance().set_tx_quiesce(
+        stored.device_number, [this]() { this->toggle_pa_path(stored.device_number, false); });
+
+    message_port_register_out(TELEMETRY_PORT);
+    message_port_register_out(HEALTH_PORT);
+    message_port_register_in(HOP_PORT);
+    message_port_register_out(LATE_PORT);
+    set_msg_handler(HOP_PORT, [this](pmt::pmt_t msg) { this->hop_message(msg); });
+    message_port_register_in(COMMAND_PORT);
+    message_port_register_out(COMMAND_REPLY_PORT);
+    set_msg_handler(COMMAND_PORT, [this](pmt::pmt_t msg) { this->command_message(msg); });
 }
 
 sink_impl::~sink_impl() {
+    // Drop commands still queued in device control worker
+    {
+        std::lock_guard<std::mutex> lock(commands->mutex);
+        commands->alive = false;
+    }
+    this->stop_tx_thread();
+    rfe_commands.stop();
+    if (sync.enabled)
+        device_handler::getInstance().sync_leave();
+    device_handler::getInstance().set_tx_quiesce(stored.device_number, nullptr);
     // Stop and destroy stream for channel 0 (if channel_mode is SISO)
     if (stored.channel_mode < 2) {
         this->release_stream(stored.device_number, &streamId[stored.channel_mode]);
@@ -94,48 +130,78 @@ sink_impl::~sink_impl() {
 }
 
 bool sink_impl::start(void) {
-    std::unique_lock<std::recursive_mutex> lock(device_handler::getInstance().block_mutex);
-    // Init timestamp
-    tx_meta.timestamp = 0;
-
-    if (stream_analyzer) {
-        t1 = std::chrono::high_resolution_clock::now();
-        t2 = t1;
-    }
-    // Enable PA path
-    this->toggle_pa_path(stored.device_number, true);
-    // Initialize and start stream for channel 0 (if channel_mode is SISO)
-    if (stored.channel_mode < 2) // If SISO configure prefered channel
+    // Handlers are chained after the ones application installed before flowgraph start
+    device_handler::getInstance().install_signal_handlers();
     {
-        this->init_stream(stored.device_number, stored.channel_mode);
-        LMS_StartStream(&streamId[stored.channel_mode]);
-    }
-    // Initialize and start stream for channels 0 & 1 (if channel_mode is MIMO)
-    else if (stored.channel_mode == 2) {
-        this->init_stream(stored.device_number, LMS_CH_0);
-        this->init_stream(stored.device_number, LMS_CH_1);
+        std::lock_guard<std::recursive_mutex> lock(
+            device_handler::getInstance().get_device_mutex(stored.device_number));
+        // Init timestamp
+        tx_meta.timestamp = 0;
 
-        LMS_StartStream(&streamId[LMS_CH_0]);
-        LMS_StartStream(&streamId[LMS_CH_1]);
+        if (stream_analyzer) {
+            t1 = std::chrono::high_resolution_clock::now();
+            t2 = t1;
+        }
+        // Enable PA path
+        this->toggle_pa_path(stored.device_number, true);
+        // Initialize stream for channel 0 (if channel_mode is SISO)
+        if (stored.channel_mode < 2) // If SISO configure prefered channel
+        {
+            this->init_stream(stored.device_number, stored.channel_mode);
+        }
+        // Initialize stream for channels 0 & 1 (if channel_mode is MIMO)
+        else if (stored.channel_mode == 2) {
+            mimo_tx_ahead = 0;
+            this->init_stream(stored.device_number, LMS_CH_0);
+            this->init_stream(stored.device_number, LMS_CH_1);
+        }
     }
-    std::unique_lock<std::recursive_mutex> unlock(device_handler::getInstance().block_mutex);
+    // Synchronized start may start streams of other devices, so device lock is not held
+    this->start_streams();
+    telemetry.reset(!pmt::is_null(message_subscribers(TELEMETRY_PORT)));
+    health.connected = !pmt::is_null(message_subscribers(HEALTH_PORT));
+    underruns = 0;
+    late.connected = !pmt::is_null(message_subscribers(LATE_PORT));
+    late.count = 0;
+    late.shift = 0;
+    late.clock_valid = false;
+    this->end_burst();
+
+    tx_thread.active = tx_thread.enabled;
+    if (tx_thread.active)
+        this->start_tx_thread();
+    latency_t = std::chrono::high_resolution_clock::now();
     return true;
 }
 
 bool sink_impl::stop(void) {
-    std::unique_lock<std::recursive_mutex> lock(device_handler::getInstance().block_mutex);
-    // Stop stream for channel 0 (if channel_mode is SISO)
-    if (stored.channel_mode < 2) {
-        this->release_stream(stored.device_number, &streamId[stored.channel_mode]);
-    }
-    // Stop streams for channels 0 & 1 (if channel_mode is MIMO)
-    else if (stored.channel_mode == 2) {
-        this->release_stream(stored.device_number, &streamId[LMS_CH_0]);
-        this->release_stream(stored.device_number, &streamId[LMS_CH_1]);
+    // Feeder thread sends what is left in ring before streams are destroyed
+    this->stop_tx_thread();
+    // Leave LimeRFE in RX when bursts are no longer sent
+    rfe_commands.clear();
+    device_handler::getInstance().rfe_switch(false);
+    rfe_tdd.tx = false;
+    // Streams still waiting for the rest of synchronized start group
+    if (sync.enabled)
+        device_handler::getInstance().sync_cancel(
+            (stored.channel_mode < 2) ? &streamId[stored.channel_mode] : streamId,
+            (stored.channel_mode < 2) ? 1 : 2);
+    {
+        std::lock_guard<std::recursive_mutex> lock(
+            device_handler::getInstance().get_device_mutex(stored.device_number));
+        // Disable PA path first, so whatever DAC holds while streams stop isn't radiated
+        this->toggle_pa_path(stored.device_number, false);
+        // Stop stream for channel 0 (if channel_mode is SISO)
+        if (stored.channel_mode < 2) {
+            this->release_stream(stored.device_number, &streamId[stored.channel_mode]);
+        }
+        // Stop streams for channels 0 & 1 (if channel_mode is MIMO)
+        else if (stored.channel_mode == 2) {
+            this->release_stream(stored.device_number, &streamId[LMS_CH_0]);
+            this->release_stream(stored.device_number, &streamId[LMS_CH_1]);
+        }
     }
-    // Disable PA path
-    this->toggle_pa_path(stored.device_number, false);
-    std::unique_lock<std::recursive_mutex> unlock(device_handler::getInstance().block_mutex);
+    streaming = false;
     return true;
 }
 
@@ -143,111 +209,322 @@ int sink_impl::general_work(int noutput_items,
                             gr_vector_int& ninput_items,
                             gr_vector_const_void_star& input_items,
                             gr_vector_void_star& output_items) {
-    // Init number of items to be sent and timestamps
-    nitems_send = noutput_items;
-    int current_sample = nitems_read(0);
-    tx_meta.waitForTimestamp = false;
-    tx_meta.flushPartialPacket = false;
-    // Check if channel 0 has any tags
-    this->work_tags(noutput_items);
-    // If length tag has been found burst_length should be higher than 0
-    if (burst_length > 0) {
-        nitems_send = std::min<long>(burst_length, nitems_send);
-        // Make sure to wait for timestamp
-        tx_meta.waitForTimestamp = true;
-        // Check if it is the end of the burst
-        if (burst_length - (long)nitems_send == 0) {
-            tx_meta.flushPartialPacket = true;
-        }
+    // Samples are sent by TX feeder thread, only copy them to ring buffer
+    if (tx_thread.active) {
+        return this->work_to_ring(noutput_items, input_items);
+    }
+    // Print stream stats to debug
+    if (stream_analyzer == true) {
+        this->print_stream_stats((stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0);
     }
 
-    // Send stream for channel 0 (if channel_mode is SISO)
-    if (stored.channel_mode < 2) {
-        // Print stream stats to debug
-        if (stream_analyzer == true) {
-            this->print_stream_stats(stored.channel_mode);
-        }
-        ret[0] = LMS_SendStream(
-            &streamId[stored.channel_mode], input_items[0], nitems_send, &tx_meta, 100);
-        if (ret[0] < 0) {
-            return 0;
+    // All tags of the window are parsed once and every burst found in it is sent
+    // as a separate segment with its own metadata
+    this->parse_bursts(noutput_items);
+    uint64_t first_sample = nitems_read(0);
+    size_t next_event = 0;
+    int done = 0;
+    while (done < noutput_items) {
+        uint64_t sample = first_sample + done;
+        while (next_event < burst.events.size() && burst.events[next_event].offset <= sample)
+            this->apply_burst_event(burst.events[next_event++]);
+
+        // Segment ends at the next event or at the end of length tagged burst
+        int items = noutput_items - done;
+        bool end_of_burst = false;
+        if (next_event < burst.events.size() &&
+            burst.events[next_event].offset < sample + items) {
+            items = burst.events[next_event].offset - sample;
+            end_of_burst = burst.events[next_event].type == burst_event::EOB;
+        } else if (next_event < burst.events.size() &&
+                   burst.events[next_event].offset == sample + items) {
+            end_of_burst = burst.events[next_event].type == burst_event::EOB;
         }
-        burst_length -= ret[0];
-        tx_meta.timestamp += ret[0];
-        consume(0, ret[0]);
-    }
-    // Send stream for channels 0 & 1 (if channel_mode is MIMO)
-    else if (stored.channel_mode == 2) {
-        // Print stream stats to debug
-        if (stream_analyzer == true) {
-            this->print_stream_stats(LMS_CH_0);
+        if (burst_length > 0 && burst_length <= items) {
+            items = burst_length;
+            end_of_burst = true;
         }
-        ret[0] = LMS_SendStream(&streamId[LMS_CH_0], input_items[0], nitems_send, &tx_meta, 100);
-        ret[1] = LMS_SendStream(&streamId[LMS_CH_1], input_items[1], nitems_send, &tx_meta, 100);
-        // Send data
-        if (ret[0] < 0 || ret[1] < 0) {
-            return 0;
+
+        if (burst.timed_pending)
+            this->check_late();
+        tx_meta.waitForTimestamp =
+            !late.send_now &&
+            (burst.timed_pending || burst_length > 0 || (burst.in_burst && burst.timed));
+        tx_meta.flushPartialPacket = end_of_burst;
+        if (burst.timed_pending && burst.in_burst)
+            burst.timed = true;
+        burst.timed_pending = false;
+        if (burst.in_burst || burst_length > 0)
+            this->rfe_burst_start();
+
+        // Late burst is dropped by consuming it without sending
+        int sent = late.dropping ? items : this->send_segment(input_items, done, items, tx_meta);
+        if (sent <= 0)
+            break;
+        // Timestamp is advanced first, so the burst end is known when burst ends
+        tx_meta.timestamp += sent;
+        if (burst_length > 0) {
+            burst_length -= sent;
+            if (burst_length == 0)
+                this->end_burst();
         }
-        burst_length -= ret[0];
-        tx_meta.timestamp += ret[0];
-        consume(0, ret[0]);
-        consume(1, ret[1]);
+        done += sent;
+        // Stream is not accepting more samples, continue in the next call
+        if (sent < items)
+            break;
+    }
+    // tx_eob on the last sent sample ends the burst now, it is out of the next tag window
+    while (next_event < burst.events.size() &&
+           burst.events[next_event].offset <= first_sample + done) {
+        if (burst.events[next_event].type == burst_event::EOB)
+            this->apply_burst_event(burst.events[next_event]);
+        next_event++;
+    }
+
+    for (int i = 0; i < ((stored.channel_mode < 2) ? 1 : 2); i++)
+        consume(i, done);
+    if (done > 0) {
+        this->update_latency((stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0);
+        this->update_telemetry();
+        this->update_health();
     }
     return 0;
 }
-void sink_impl::work_tags(int noutput_items) {
-    std::vector<tag_t> tags;
-    int current_sample = nitems_read(0);
-    get_tags_in_range(tags, 0, current_sample, current_sample + noutput_items);
-
-    if (!tags.empty()) {
-        std::sort(tags.begin(), tags.end(), tag_t::offset_compare);
-        // Go through the tags
-        for (tag_t cTag : tags) {
-            // Found tx_time tag
-            if (pmt::eq(cTag.key, TIME_TAG)) {
-                // Convert time to sample timestamp
-                uint64_t secs = pmt::to_uint64(pmt::tuple_ref(cTag.value, 0));
-                double fracs = pmt::to_double(pmt::tuple_ref(cTag.value, 1));
-                uint64_t u_rate = (uint64_t)stored.samp_rate;
-                double f_rate = stored.samp_rate - u_rate;
-                uint64_t timestamp =
-                    u_rate * secs + llround(secs * f_rate + fracs * stored.samp_rate);
-
-                if (cTag.offset == current_sample) {
-                    tx_meta.waitForTimestamp = true;
-                    tx_meta.timestamp = timestamp;
-                } else {
-                    nitems_send = cTag.offset - current_sample;
-                    break;
-                }
-            }
-            // Found length tag
-            else if (!pmt::is_null(LENGTH_TAG) && pmt::eq(cTag.key, LENGTH_TAG)) {
-                if (cTag.offset == current_sample) {
-                    // Found length tag in the middle of the burst
-                    if (burst_length > 0 && ret[0] > 0)
-                        std::cout << "Warning: Length tag has been preemted" << std::endl;
-                    burst_length = pmt::to_long(cTag.value);
-                } else {
-                    nitems_send = cTag.offset - current_sample;
-                    break;
-                }
-            }
+
+// Send samples of one segment on all channels
+int sink_impl::send_segment(gr_vector_const_void_star& input_items,
+                            int offset,
+                            int items,
+                            const lms_stream_meta_t& meta) {
+    if (stored.channel_mode < 2) {
+        const char* src = static_cast<const char*>(input_items[0]) + offset * stored.item_size;
+        ret[0] = backend->send(&streamId[stored.channel_mode], src, items, &meta, 100);
+        return ret[0];
+    }
+    burst.buffers.resize(2);
+    for (int i = 0; i < 2; i++)
+        burst.buffers[i] = static_cast<const char*>(input_items[i]) + offset * stored.item_size;
+    return this->send_mimo(burst.buffers, items, meta);
+}
+
+// Send the same samples on both MIMO channels.
+// Samples already sent on channel 0 but not yet on channel 1 are tracked in mimo_tx_ahead,
+// so both inputs are always consumed by the same amount.
+int sink_impl::send_mimo(gr_vector_const_void_star& input_items,
+                         int items,
+                         const lms_stream_meta_t& meta) {
+    int sent[2] = {mimo_tx_ahead, 0};
+    for (int i = 0; i < 2; i++) {
+        int wanted = (i == LMS_CH_0) ? items : std::min(sent[LMS_CH_0], items);
+        while (sent[i] < wanted) {
+            lms_stream_meta_t chunk_meta = meta;
+            chunk_meta.timestamp += sent[i];
+            chunk_meta.flushPartialPacket = meta.flushPartialPacket && wanted == items;
+            const char* src =
+                static_cast<const char*>(input_items[i]) + sent[i] * stored.item_size;
+            ret[i] = backend->send(&streamId[i], src, wanted - sent[i], &chunk_meta, 100);
+            if (ret[i] <= 0)
+                break;
+            sent[i] += ret[i];
+            // Channel 0 is sent once, channel 1 is retried until it catches up
+            if (i == LMS_CH_0)
+                break;
+        }
+    }
+    mimo_tx_ahead = sent[LMS_CH_0] - sent[LMS_CH_1];
+    return sent[LMS_CH_1];
+}
+// Convert stream tags of channel 0 to burst events sorted by sample they apply from
+void sink_impl::parse_bursts(int noutput_items) {
+    uint64_t first_sample = nitems_read(0);
+    burst.tags.clear();
+    get_tags_in_range(burst.tags, 0, first_sample, first_sample + noutput_items);
+    make_burst_events(burst.tags, LENGTH_TAG, burst.events);
+}
+
+void sink_impl::make_burst_events(const std::vector<tag_t>& tags,
+                                  const pmt::pmt_t& length_tag,
+                                  std::vector<burst_event>& events) {
+    events.clear();
+    for (size_t i = 0; i < tags.size(); i++) {
+        const tag_t& tag = tags[i];
+        burst_event event;
+        if (pmt::eq(tag.key, TIME_TAG))
+            event.type = burst_event::TIME;
+        else if (pmt::eq(tag.key, SOB_TAG))
+            event.type = burst_event::SOB;
+        else if (pmt::eq(tag.key, EOB_TAG))
+            event.type = burst_event::EOB;
+        else if (pmt::eq(tag.key, HOP_TAG))
+            event.type = burst_event::HOP;
+        else if (!pmt::is_null(length_tag) && pmt::eq(tag.key, length_tag))
+            event.type = burst_event::LENGTH;
+        else
+            continue;
+        // tx_eob marks the last sample of the burst
+        event.offset = tag.offset + (event.type == burst_event::EOB ? 1 : 0);
+        event.order = i;
+        event.value = tag.value;
+        events.push_back(event);
+    }
+    std::sort(events.begin(), events.end());
+}
+
+void sink_impl::apply_burst_event(const burst_event& event) {
+    switch (event.type) {
+    case burst_event::TIME: {
+        // Convert time to sample timestamp
+        uint64_t secs = pmt::to_uint64(pmt::tuple_ref(event.value, 0));
+        double fracs = pmt::to_double(pmt::tuple_ref(event.value, 1));
+        uint64_t u_rate = (uint64_t)stored.samp_rate;
+        double f_rate = stored.samp_rate - u_rate;
+        tx_meta.timestamp =
+            u_rate * secs + llround(secs * f_rate + fracs * stored.samp_rate) + late.shift;
+        burst.timed_pending = true;
+        late.send_now = false;
+        break;
+    }
+    case burst_event::LENGTH:
+        // Found length tag in the middle of the burst
+        if (burst_length > 0)
+            std::cout << "Warning: Length tag has been preemted" << std::endl;
+        burst_length = pmt::to_long(event.value);
+        break;
+    case burst_event::SOB:
+        this->end_burst();
+        burst.in_burst = true;
+        break;
+    case burst_event::EOB:
+        this->end_burst();
+        burst_length = 0;
+        break;
+    case burst_event::HOP:
+        this->hop(pmt::to_long(event.value));
+        break;
+    }
+}
+
+void sink_impl::end_burst() {
+    this->rfe_burst_end();
+    burst.in_burst = false;
+    burst.timed = false;
+    late.dropping = false;
+    late.send_now = false;
+}
+
+// Switch LimeRFE to TX, timed bursts switch ahead of tx_time by the longest measured
+// switch duration
+void sink_impl::rfe_burst_start() {
+    if (rfe_tdd.tx || late.dropping || !device_handler::getInstance().rfe_tdd_enabled())
+        return;
+    rfe_tdd.tx = true;
+    control_worker::clock::time_point when = control_worker::clock::now();
+    if (tx_meta.waitForTimestamp) {
+        double last_us, max_us;
+        uint64_t count;
+        device_handler::getInstance().get_rfe_switch_stats(last_us, max_us, count);
+        when = std::max(when,
+                        this->device_to_host_time(tx_meta.timestamp) -
+                            std::chrono::duration_cast<control_worker::clock::duration>(
+                                std::chrono::duration<double, std::micro>(max_us)));
+    }
+    // Next burst starts before switch to RX: drop the switch and stay in TX
+    if (rfe_commands.pending() > 0 && when <= rfe_tdd.rx_at) {
+        rfe_commands.clear();
+        when = std::min(when, rfe_tdd.tx_at);
+    }
+    rfe_tdd.tx_at = when;
+    rfe_commands.post_at(when, [] { device_handler::getInstance().rfe_switch(true); });
+}
+
+// Switch LimeRFE back to RX after the last burst sample leaves the device
+void sink_impl::rfe_burst_end() {
+    if (!rfe_tdd.tx)
+        return;
+    rfe_tdd.tx = false;
+    if (tx_meta.waitForTimestamp) {
+        rfe_tdd.rx_at = this->device_to_host_time(tx_meta.timestamp);
+    } else {
+        // Untimed burst is transmitted once device FIFO drains
+        rfe_tdd.rx_at = control_worker::clock::now() +
+                        std::chrono::duration_cast<control_worker::clock::duration>(
+                            std::chrono::duration<double>(stream_latency));
+    }
+    rfe_commands.post_at(rfe_tdd.rx_at, [] { device_handler::getInstance().rfe_switch(false); });
+}
+
+// Host time at which device reaches given sample timestamp
+control_worker::clock::time_point sink_impl::device_to_host_time(uint64_t timestamp) {
+    double delay = (int64_t)(timestamp - this->hardware_time()) / stored.samp_rate;
+    return control_worker::clock::now() +
+           std::chrono::duration_cast<control_worker::clock::duration>(
+               std::chrono::duration<double>(std::max(delay, 0.0)));
+}
+
+// Device hardware time in samples. Status is read every 100 ms and host clock
+// is used in between, so checking many bursts doesn't take LimeSuite locks each time.
+uint64_t sink_impl::hardware_time() {
+    auto now = std::chrono::high_resolution_clock::now();
+    if (!late.clock_valid ||
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - late.host_time).count() >=
+            100) {
+        lms_stream_status_t status;
+        if (this->read_stream_status(
+                (stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0, &status) ==
+            LMS_SUCCESS) {
+            late.hw_time = status.timestamp;
+            late.host_time = now;
+            late.clock_valid = true;
         }
     }
+    return late.hw_time +
+           (uint64_t)(std::chrono::duration<double>(now - late.host_time).count() *
+                      stored.samp_rate);
+}
+
+// Compare burst tx_time against device time and apply late burst policy
+void sink_impl::check_late() {
+    int64_t lateness = (int64_t)(this->hardware_time() - tx_meta.timestamp);
+    if (lateness <= 0)
+        return;
+    late.count++;
+    late.last_lateness = lateness / stored.samp_rate * 1e6;
+
+    if (late.policy == LIMESDR_LATE_SHIFT) {
+        // Keep 1 ms margin, so shifted burst isn't late again
+        int64_t shift = lateness + (int64_t)(stored.samp_rate / 1000);
+        late.shift += shift;
+        tx_meta.timestamp += shift;
+    } else if (late.policy == LIMESDR_LATE_DROP && (burst.in_burst || burst_length > 0)) {
+        late.dropping = true;
+    } else {
+        late.send_now = true;
+    }
+
+    if (late.connected) {
+        pmt::pmt_t report = pmt::make_dict();
+        report = pmt::dict_add(report, pmt::mp("late_count"), pmt::from_uint64(late.count));
+        report =
+            pmt::dict_add(report, pmt::mp("lateness_us"), pmt::from_double(late.last_lateness));
+        report = pmt::dict_add(report, pmt::mp("timestamp"), pmt::from_uint64(tx_meta.timestamp));
+        report = pmt::dict_add(report, pmt::mp("policy"), pmt::from_long(late.policy));
+        message_port_pub(LATE_PORT, report);
+    }
 }
+
 // Print stream status
 void sink_impl::print_stream_stats(int channel) {
     t2 = std::chrono::high_resolution_clock::now();
     auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
     if (timePeriod >= 1000) {
         lms_stream_status_t status;
-        LMS_GetStreamStatus(&streamId[channel], &status);
+        this->read_stream_status(channel, &status);
         std::cout << std::endl;
         std::cout << "TX";
         std::cout << "|rate: " << status.linkRate / 1e6 << " MB/s ";
-        std::cout << "|dropped packets: " << status.droppedPackets << " ";
+        uint64_t dropped = telemetry.total(channel).dropped_packets;
+        std::cout << "|dropped packets: " << dropped - printed_dropped << " ";
+        printed_dropped = dropped;
         std::cout << "|FIFO: " << 100 * status.fifoFilledCount / status.fifoSize << "%"
                   << std::endl;
         t1 = t2;
@@ -255,35 +532,319 @@ void sink_impl::print_stream_stats(int channel) {
 }
 // Setup stream
 void sink_impl::init_stream(int device_number, int channel) {
+    this->update_stream_settings();
     streamId[channel].channel = channel;
-    streamId[channel].fifoSize =
-        (stored.FIFO_size == 0) ? (int)stored.samp_rate / 10 : stored.FIFO_size;
-    streamId[channel].throughputVsLatency = 0.5;
+    streamId[channel].fifoSize = stored.stream_FIFO_size;
+    streamId[channel].throughputVsLatency = stored.throughput_vs_latency;
     streamId[channel].isTx = LMS_CH_TX;
-    streamId[channel].dataFmt = lms_stream_t::LMS_FMT_F32;
+    switch (stored.data_format) {
+    case LIMESDR_FMT_I16:
+        streamId[channel].dataFmt = lms_stream_t::LMS_FMT_I16;
+        break;
+    case LIMESDR_FMT_I12:
+        streamId[channel].dataFmt = lms_stream_t::LMS_FMT_I12;
+        break;
+    default:
+        streamId[channel].dataFmt = lms_stream_t::LMS_FMT_F32;
+        break;
+    }
 
-    if (LMS_SetupStream(device_handler::getInstance().get_device(device_number),
-                        &streamId[channel]) != LMS_SUCCESS)
+    if (backend->setup(&streamId[channel]) != LMS_SUCCESS)
         device_handler::getInstance().error(device_number);
 
     std::cout << "INFO: sink_impl::init_stream(): sink channel " << channel << " (device nr. "
-              << device_number << ") stream setup done." << std::endl;
+              << device_number << ") stream setup done, FIFO: " << stored.stream_FIFO_size
+              << " samples, throughputVsLatency: " << stored.throughput_vs_latency << "."
+              << std::endl;
+}
+
+// Select FIFO size and throughputVsLatency from latency profile and explicit overrides
+void sink_impl::update_stream_settings() {
+    device_handler::getInstance().get_latency_profile(stored.latency_profile,
+                                                      stored.samp_rate,
+                                                      stored.throughput_vs_latency,
+                                                      stored.stream_FIFO_size);
+    if (stored.throughput_vs_latency_override >= 0)
+        stored.throughput_vs_latency = stored.throughput_vs_latency_override;
+    if (stored.FIFO_size != 0)
+        stored.stream_FIFO_size = stored.FIFO_size;
+}
+
+// Apply new stream settings if streaming is already running
+void sink_impl::rebuild_stream() {
+    if (!streaming)
+        return;
+    // Keep general_work out while streams are recreated
+    gr::thread::scoped_lock guard(d_setlock);
+    // Other devices keep streaming, so restarted streams can't wait for synchronized start
+    sync.restarting = true;
+    this->stop();
+    this->start();
+    sync.restarting = false;
+}
+
+void sink_impl::start_streams() {
+    lms_stream_t* streams = (stored.channel_mode < 2) ? &streamId[stored.channel_mode] : streamId;
+    int count = (stored.channel_mode < 2) ? 1 : 2;
+    if (!sync.restarting && sync.fref_MHz > 0)
+        device_handler::getInstance().set_ext_clk(stored.device_number, sync.fref_MHz);
+    if (sync.enabled && !sync.restarting) {
+        device_handler::getInstance().sync_start(stored.device_number, streams, count, &streaming);
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        backend->start(&streams[i]);
+    streaming = true;
+}
+
+// Latency of TX path is the time samples spend in FIFO before being sent out
+void sink_impl::update_latency(int channel) {
+    auto now = std::chrono::high_resolution_clock::now();
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - latency_t).count() < 1000)
+        return;
+    latency_t = now;
+    lms_stream_status_t status;
+    this->read_stream_status(channel, &status);
+    size_t staged = tx_thread.active ? tx_thread.ring[0]->items_available() : 0;
+    stream_latency = (status.fifoFilledCount + staged) / stored.samp_rate;
+}
+
+// Every status read goes through here, LimeSuite resets its counters on each read, so they
+// are kept in telemetry totals for all readers
+int sink_impl::read_stream_status(int channel, lms_stream_status_t* status) {
+    int ret = backend->status(&streamId[channel], status);
+    if (ret != LMS_SUCCESS)
+        return ret;
+    underruns += status->underrun;
+    telemetry.accumulate(channel, *status);
+    return ret;
+}
+
+void sink_impl::publish_telemetry(int channel, const lms_stream_status_t& status) {
+    pmt::pmt_t report = telemetry.make_report(channel, status);
+    if (device_handler::getInstance().rfe_tdd_enabled()) {
+        double last_us, max_us;
+        uint64_t count;
+        device_handler::getInstance().get_rfe_switch_stats(last_us, max_us, count);
+        report = pmt::dict_add(report, pmt::mp("rfe_switch_us"), pmt::from_double(last_us));
+        report = pmt::dict_add(report, pmt::mp("rfe_switch_max_us"), pmt::from_double(max_us));
+        report = pmt::dict_add(report, pmt::mp("rfe_switch_count"), pmt::from_uint64(count));
+    }
+    message_port_pub(TELEMETRY_PORT, report);
+}
+
+// Publish health snapshot once after every monitor poll
+void sink_impl::update_health() {
+    if (!health.connected)
+        return;
+    health_snapshot snapshot;
+    if (!device_handler::getInstance().get_health(stored.device_number, snapshot) ||
+        snapshot.sequence == health.sequence)
+        return;
+    health.sequence = snapshot.sequence;
+    message_port_pub(HEALTH_PORT, health_monitor::make_report(snapshot));
+}
+
+void sink_impl::set_health_monitor(double rate_hz) {
+    device_handler::getInstance().set_health_monitor(rate_hz);
+}
+
+double sink_impl::get_temperature() {
+    health_snapshot snapshot;
+    device_handler::getInstance().get_health(stored.device_number, snapshot);
+    return snapshot.temperature;
+}
+
+bool sink_impl::get_clock_locked() {
+    health_snapshot snapshot;
+    device_handler::getInstance().get_health(stored.device_number, snapshot);
+    return snapshot.cgen_locked;
+}
+
+void sink_impl::update_telemetry() {
+    if (!telemetry.enabled() || !telemetry.due())
+        return;
+    int first = (stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0;
+    int last = (stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_1;
+    for (int channel = first; channel <= last; channel++) {
+        lms_stream_status_t status;
+        this->read_stream_status(channel, &status);
+        this->publish_telemetry(channel, status);
+    }
+}
+
+// Samples in one LimeSuite packet per channel
+int sink_impl::packet_samples() {
+    return device_handler::getInstance().get_packet_samples(stored.data_format,
+                                                            (stored.channel_mode < 2) ? 1 : 2);
+}
+
+void sink_impl::start_tx_thread() {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    uint32_t ring_size = this->get_ring_size();
+    for (int i = 0; i < channels; i++) {
+        if (!tx_thread.ring[i] || tx_thread.ring[i]->capacity() != ring_size)
+            tx_thread.ring[i].reset(new ring_buffer(ring_size, stored.item_size));
+        tx_thread.ring[i]->reset();
+    }
+    tx_thread.running = true;
+    tx_thread.thread = std::thread(&sink_impl::tx_thread_loop, this);
+
+    std::cout << "INFO: sink_impl::start_tx_thread(): TX feeder thread started, ring size "
+              << ring_size << " samples, FIFO fill target " << 100 * tx_thread.fill_level << "%";
+    if (tx_thread.cpu >= 0)
+        std::cout << ", pinned to CPU " << tx_thread.cpu;
+    std::cout << "." << std::endl;
+}
+
+void sink_impl::stop_tx_thread() {
+    if (tx_thread.thread.joinable()) {
+        tx_thread.running = false;
+        tx_thread.thread.join();
+    }
+}
+
+// Keep device FIFO at target fill level with whole packets taken from ring buffers
+void sink_impl::tx_thread_loop() {
+    if (tx_thread.cpu >= 0)
+        gr::thread::thread_bind_to_processor(tx_thread.cpu);
+    if (gr::enable_realtime_scheduling() != gr::RT_OK)
+        std::cout << "WARNING: sink_impl::tx_thread_loop(): unable to enable realtime "
+                     "scheduling for TX feeder thread."
+                  << std::endl;
+
+    const size_t packet = this->packet_samples();
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    int status_channel = (stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0;
+    const uint32_t target =
+        std::max<uint32_t>(tx_thread.fill_level * stored.stream_FIFO_size, packet);
+    lms_stream_meta_t meta;
+    meta.timestamp = 0;
+    meta.waitForTimestamp = false;
+    meta.flushPartialPacket = false;
+    lms_stream_meta_t flush_meta = meta;
+    flush_meta.flushPartialPacket = true;
+
+    while (tx_thread.running) {
+        lms_stream_status_t status;
+        if (this->read_stream_status(status_channel, &status) != LMS_SUCCESS)
+            status.fifoFilledCount = 0;
+        // FIFO is filled enough, wait until it drains below target
+        if (status.fifoFilledCount >= target) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(
+                (status.fifoFilledCount - target + packet) / stored.samp_rate));
+            continue;
+        }
+
+        // Small work chunks are merged in ring, send only whole packets
+        size_t available = this->tx_ring_items();
+        if (available < packet) {
+            // Device FIFO is about to underrun, rest of burst is not held back for more input
+            bool flush = available > 0 && status.fifoFilledCount < packet;
+            if (!flush) {
+                bool ready = true;
+                for (int i = 0; i < channels && ready; i++)
+                    ready =
+                        tx_thread.ring[i]->wait_for_items(packet, std::chrono::milliseconds(10));
+                available = this->tx_ring_items();
+                // Upstream stopped in the middle of a packet, its rest would stay in ring
+                flush = !ready && available > 0;
+                if (!ready && !flush)
+                    continue;
+            }
+            if (flush) {
+                this->tx_thread_send(available, flush_meta);
+                continue;
+            }
+        }
+        size_t items = (target - status.fifoFilledCount + packet - 1) / packet * packet;
+        items = std::min(items, available);
+        this->tx_thread_send(items - items % packet, meta);
+    }
+
+    // Send samples left in ring when stream is stopped
+    this->tx_thread_send(this->tx_ring_items(), flush_meta);
+}
+
+// Items available in all ring buffers
+size_t sink_impl::tx_ring_items() {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    size_t items = tx_thread.ring[0]->items_available();
+    for (int i = 1; i < channels; i++)
+        items = std::min(items, tx_thread.ring[i]->items_available());
+    return items;
+}
+
+// Send items from ring buffers handling ring wrap around
+void sink_impl::tx_thread_send(size_t items, const lms_stream_meta_t& meta) {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    gr_vector_const_void_star buffers(channels);
+    while (items > 0) {
+        size_t count = items;
+        for (int i = 0; i < channels; i++) {
+            size_t contiguous;
+            buffers[i] = tx_thread.ring[i]->read_ptr(contiguous);
+            count = std::min(count, contiguous);
+        }
+        int sent;
+        if (channels == 1)
+            sent = backend->send(&streamId[stored.channel_mode], buffers[0], count, &meta, 100);
+        else
+            sent = this->send_mimo(buffers, count, meta);
+        if (sent <= 0)
+            return;
+        for (int i = 0; i < channels; i++)
+            tx_thread.ring[i]->commit_read(sent);
+        items -= sent;
+    }
+}
+
+int sink_impl::work_to_ring(int noutput_items, gr_vector_const_void_star& input_items) {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    size_t items = noutput_items;
+    for (int i = 0; i < channels; i++) {
+        if (!tx_thread.ring[i]->wait_for_space(1, std::chrono::milliseconds(100)))
+            return 0;
+        items = std::min(items, tx_thread.ring[i]->space_available());
+    }
+    for (int i = 0; i < channels; i++) {
+        tx_thread.ring[i]->write(input_items[i], items);
+        consume(i, items);
+    }
+    this->update_latency((stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0);
+    this->update_telemetry();
+    this->update_health();
+    return 0;
 }
 
 void sink_impl::release_stream(int device_number, lms_stream_t* stream) {
     if (stream->handle != 0) {
-        LMS_StopStream(stream);
-        LMS_DestroyStream(device_handler::getInstance().get_device(device_number), stream);
+        backend->stop(stream);
+        backend->destroy(stream);
     }
 }
 
 // Return io_signature to manage module input count
-// based on SISO (one input) and MIMO (two inputs) modes
-inline gr::io_signature::sptr sink_impl::args_to_io_signature(int channel_number) {
+// based on SISO (one input) and MIMO (two inputs) modes.
+// F32 streams input gr_complex, I16/I12 streams input interleaved int16 I/Q (sc16)
+inline gr::io_signature::sptr sink_impl::args_to_io_signature(int channel_number,
+                                                              int data_format) {
+    size_t item_size;
+    if (data_format == LIMESDR_FMT_F32) {
+        item_size = sizeof(gr_complex);
+    } else if (data_format == LIMESDR_FMT_I16 || data_format == LIMESDR_FMT_I12) {
+        item_size = 2 * sizeof(int16_t);
+    } else {
+        std::cout << "ERROR: sink_impl::args_to_io_signature(): data_format must be F32(0), "
+                     "I16(1) or I12(2)."
+                  << std::endl;
+        exit(0);
+    }
+
     if (channel_number < 2) {
-        return gr::io_signature::make(1, 1, sizeof(gr_complex));
+        return gr::io_signature::make(1, 1, item_size);
     } else if (channel_number == 2) {
-        return gr::io_signature::make(2, 2, sizeof(gr_complex));
+        return gr::io_signature::make(2, 2, item_size);
     } else {
         std::cout << "ERROR: sink_impl::args_to_io_signature(): channel_number must be 0,1 or 2."
                   << std::endl;
@@ -346,6 +907,14 @@ void sink_impl::calibrate(double bandw, int channel) {
     this->toggle_pa_path(stored.device_number, false);
 }
 
+void sink_impl::set_calibration_cache(bool enable) {
+    device_handler::getInstance().set_calibration_cache(stored.device_number, enable);
+}
+
+bool sink_impl::save_snapshot(const std::string& filename) {
+    return device_handler::getInstance().save_snapshot(stored.device_number, filename);
+}
+
 double sink_impl::set_sample_rate(double rate) {
     device_handler::getInstance().set_samp_rate(stored.device_number, rate);
     stored.samp_rate = rate;
@@ -358,9 +927,143 @@ void sink_impl::set_oversampling(int oversample) {
     device_handler::getInstance().set_oversampling(stored.device_number, oversample);
 }
 
+int sink_impl::set_hop_table(const std::vector<double>& freqs) {
+    return device_handler::getInstance().set_hop_table(stored.device_number, LMS_CH_TX, freqs);
+}
+
+double sink_impl::hop(int index) {
+    double duration;
+    double freq =
+        device_handler::getInstance().hop(stored.device_number, LMS_CH_TX, index, duration);
+    if (freq == 0)
+        return 0;
+    hop_stats.last_duration = duration;
+    hop_stats.count++;
+    return freq;
+}
+
+// Hop message is entry index or dictionary with "hop" key
+void sink_impl::hop_message(pmt::pmt_t msg) {
+    if (pmt::is_dict(msg))
+        msg = pmt::dict_ref(msg, HOP_PORT, pmt::PMT_NIL);
+    if (!pmt::is_integer(msg)) {
+        std::cout << "ERROR: sink_impl::hop_message(): hop message must be entry index."
+                  << std::endl;
+        return;
+    }
+    this->hop(pmt::to_long(msg));
+}
+
+void sink_impl::command_message(pmt::pmt_t msg) {
+    control_command cmd;
+    std::string error;
+    cmd.parse(msg, error);
+    // Sink tunes immediately, timed transmission is done with tx_time tags
+    if (error.empty() && !std::isnan(cmd.time))
+        error = "time is not supported by sink";
+    if (!error.empty()) {
+        std::cout << "ERROR: sink_impl::command_message(): " << error << "." << std::endl;
+        message_port_pub(COMMAND_REPLY_PORT, cmd.reply(error));
+        return;
+    }
+    std::shared_ptr<command_guard> guard = commands;
+    device_handler::getInstance().post_command(stored.device_number, [this, guard, cmd]() {
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        if (guard->alive)
+            this->apply_command(cmd);
+    });
+}
+
+// Runs on device control worker thread
+void sink_impl::apply_command(const control_command& cmd) {
+    // Setters close all devices on failure, so device limits are checked first
+    if (!std::isnan(cmd.freq) &&
+        !device_handler::getInstance().check_rf_freq(stored.device_number, LMS_CH_TX, cmd.freq)) {
+        message_port_pub(COMMAND_REPLY_PORT, cmd.reply("freq is out of LO range"));
+        return;
+    }
+    if (!std::isnan(cmd.freq))
+        this->set_center_freq(cmd.freq, cmd.channel);
+    if (!std::isnan(cmd.bw))
+        this->set_bandwidth(cmd.bw, cmd.channel);
+    if (!std::isnan(cmd.gain))
+        this->set_gain((unsigned)cmd.gain, cmd.channel);
+    if (!std::isnan(cmd.nco))
+        this->set_nco(cmd.nco, cmd.channel);
+    message_port_pub(COMMAND_REPLY_PORT, cmd.reply(""));
+}
+
 void sink_impl::set_tcxo_dac(uint16_t dacVal) {
     device_handler::getInstance().set_tcxo_dac(stored.device_number, dacVal);
 }
 
+void sink_impl::set_latency_profile(int profile) {
+    if (profile < LIMESDR_LATENCY_LOW || profile > LIMESDR_LATENCY_THROUGHPUT) {
+        std::cout << "ERROR: sink_impl::set_latency_profile(): profile must be Low latency(0), "
+                     "Balanced(1) or Max throughput(2)."
+                  << std::endl;
+        return;
+    }
+    stored.latency_profile = profile;
+    this->rebuild_stream();
+}
+
+void sink_impl::set_throughput_vs_latency(double value) {
+    stored.throughput_vs_latency_override = (value > 1.0) ? 1.0 : value;
+    this->rebuild_stream();
+}
+
+void sink_impl::set_late_policy(int policy) {
+    if (policy < LIMESDR_LATE_SEND || policy > LIMESDR_LATE_SHIFT) {
+        std::cout << "ERROR: sink_impl::set_late_policy(): policy must be Send(0), Drop(1) or "
+                     "Shift(2)."
+                  << std::endl;
+        return;
+    }
+    late.policy = policy;
+}
+
+void sink_impl::set_sync_start(bool enable, double fref_MHz) {
+    if (streaming) {
+        std::cout << "ERROR: sink_impl::set_sync_start(): synchronized start must be set "
+                     "before the flowgraph is started."
+                  << std::endl;
+        return;
+    }
+    sync.fref_MHz = fref_MHz;
+    if (enable == sync.enabled)
+        return;
+    sync.enabled = enable;
+    if (enable)
+        device_handler::getInstance().sync_join();
+    else
+        device_handler::getInstance().sync_leave();
+}
+
+std::vector<double> sink_impl::get_sync_offsets() {
+    return device_handler::getInstance().get_sync_offsets();
+}
+
+void sink_impl::set_tx_thread(bool enable, uint32_t ring_size, double fill_level, int cpu) {
+    if (fill_level <= 0 || fill_level > 1) {
+        std::cout << "ERROR: sink_impl::set_tx_thread(): fill_level must be in range (0, 1]."
+                  << std::endl;
+        return;
+    }
+    tx_thread.enabled = enable;
+    tx_thread.ring_size = ring_size;
+    tx_thread.fill_level = fill_level;
+    tx_thread.cpu = cpu;
+}
+
+uint32_t sink_impl::get_ring_size() {
+    uint32_t ring_size = (tx_thread.ring_size != 0)
+                             ? tx_thread.ring_size
+                             : std::max<uint32_t>((uint32_t)stored.samp_rate / 4, 65536);
+    // Whole packets fit into ring without wrapping
+    uint32_t packet = this->packet_samples();
+    return (ring_size + packet - 1) / packet * packet;
+}
+
 } // namespace limesdr
 } // namespace gr
@@ -22,47 +22,227 @@
 #define INCLUDED_LIMESDR_SINK_IMPL_H
 
 #include "common/device_handler.h"
+#include "common/ring_buffer.h"
+#include "common/control_command.h"
+#include "common/stream_telemetry.h"
+#include <atomic>
 #include <limesdr/sink.h>
+#include <memory>
+#include <thread>
 
 
 static const pmt::pmt_t TIME_TAG = pmt::string_to_symbol("tx_time");
+static const pmt::pmt_t HOP_TAG = pmt::string_to_symbol("tx_hop");
+static const pmt::pmt_t SOB_TAG = pmt::string_to_symbol("tx_sob");
+static const pmt::pmt_t EOB_TAG = pmt::string_to_symbol("tx_eob");
+static const pmt::pmt_t HOP_PORT = pmt::string_to_symbol("hop");
+static const pmt::pmt_t LATE_PORT = pmt::string_to_symbol("late");
 
 namespace gr {
 namespace limesdr {
 class sink_impl : public sink {
     private:
     lms_stream_t streamId[2];
+    // Stream interface of the device, LimeSuite or mock
+    stream_backend* backend = nullptr;
 
     bool stream_analyzer = false;
 
     int sink_block = 2;
 
+    // Synchronized multi-device start
+    struct sync_data {
+        bool enabled = false;
+        // Set while stream is rebuilt on running flowgraph
+        bool restarting = false;
+        // External reference applied when streams are armed
+        double fref_MHz = 0;
+    } sync;
+
     pmt::pmt_t LENGTH_TAG;
     lms_stream_meta_t tx_meta;
     long burst_length = 0;
-    int nitems_send = 0;
     int ret[2] = {0};
+
+    public:
+    // Stream tag converted to burst engine event
+    struct burst_event {
+        enum { TIME, LENGTH, SOB, EOB, HOP } type;
+        // Sample the event applies from, tx_eob applies after its tagged sample
+        uint64_t offset;
+        // Position in tag list to keep order of events at the same offset
+        size_t order;
+        pmt::pmt_t value;
+        bool operator<(const burst_event& other) const {
+            return offset < other.offset || (offset == other.offset && order < other.order);
+        }
+    };
+
+    /**
+     * Convert stream tags to burst events sorted by sample they apply from.
+     *
+     * @param   tags        Stream tags of channel 0.
+     *
+     * @param   length_tag  Burst length tag key, PMT_NIL if length tags are not used.
+     *
+     * @param   events      Returns burst events, other tags are skipped.
+     */
+    static void make_burst_events(const std::vector<tag_t>& tags,
+                                  const pmt::pmt_t& length_tag,
+                                  std::vector<burst_event>& events);
+
+    private:
+
+    struct burst_data {
+        // Buffers reused by every call
+        std::vector<tag_t> tags;
+        std::vector<burst_event> events;
+        gr_vector_const_void_star buffers;
+        // tx_sob has been received, but not tx_eob yet
+        bool in_burst = false;
+        // tx_time was received for current tx_sob burst
+        bool timed = false;
+        // tx_time was received and applies to the next sent segment
+        bool timed_pending = false;
+    } burst;
+
+    struct late_data {
+        int policy = LIMESDR_LATE_SEND;
+        bool connected = false;
+        uint64_t count = 0;
+        // Lateness of the last late burst in microseconds
+        double last_lateness = 0;
+        // Samples added to tx_time of bursts by shift policy
+        int64_t shift = 0;
+        // Current burst is late and is being dropped or sent without timestamp
+        bool dropping = false;
+        bool send_now = false;
+        // Hardware time reference, extrapolated with host clock between status reads
+        bool clock_valid = false;
+        uint64_t hw_time = 0;
+        std::chrono::high_resolution_clock::time_point host_time;
+    } late;
+    // LimeRFE TX/RX switching driven by bursts
+    struct rfe_tdd_data {
+        // Switch to TX has been scheduled for the current burst
+        bool tx = false;
+        control_worker::clock::time_point tx_at;
+        control_worker::clock::time_point rx_at;
+    } rfe_tdd;
+    control_worker rfe_commands;
+    // Samples already sent on MIMO channel 0, but not yet on channel 1
+    int mimo_tx_ahead = 0;
     int pa_path[2] = {0}; // TX PA path NONE
 
     struct constant_data {
         std::string serial;
         int device_number;
         int channel_mode;
+        int data_format;
+        size_t item_size;
         double samp_rate = 10e6;
         uint32_t FIFO_size = 0;
+        int latency_profile = LIMESDR_LATENCY_BALANCED;
+        double throughput_vs_latency_override = -1;
+        double throughput_vs_latency = 0.5;
+        uint32_t stream_FIFO_size = 0;
     } stored;
 
+    // Set once streams are started, which is later than start() for synchronized start
+    std::atomic<bool> streaming{false};
+    double stream_latency = 0;
+    std::chrono::high_resolution_clock::time_point latency_t;
+
+    stream_telemetry telemetry;
+
+    // Sequence of the last published health snapshot
+    struct health_data {
+        bool connected = false;
+        uint64_t sequence = 0;
+    } health;
+
+    struct tx_thread_data {
+        bool enabled = false;
+        bool active = false;
+        uint32_t ring_size = 0;
+        // Target device FIFO fill as a fraction of FIFO size
+        double fill_level = 0.5;
+        int cpu = -1;
+        std::atomic<bool> running{false};
+        std::thread thread;
+        std::unique_ptr<ring_buffer> ring[2];
+    } tx_thread;
+
+    // Device FIFO underruns since stream start
+    std::atomic<uint64_t> underruns{0};
+    // Dropped packets total at last stats print
+    uint64_t printed_dropped = 0;
+
+    // Hops come from stream tags, messages and control worker, getters read from Python
+    struct hop_data {
+        std::atomic<double> last_duration{0};
+        std::atomic<uint64_t> count{0};
+    } hop_stats;
+
+    void hop_message(pmt::pmt_t msg);
+
+    // Commands received on "command" port
+    std::shared_ptr<command_guard> commands = std::make_shared<command_guard>();
+    void command_message(pmt::pmt_t msg);
+    void apply_command(const control_command& cmd);
+
     std::chrono::high_resolution_clock::time_point t1, t2;
 
-    void work_tags(int noutput_items);
+    void parse_bursts(int noutput_items);
+
+    void apply_burst_event(const burst_event& event);
+
+    void end_burst();
+
+    void rfe_burst_start();
+
+    void rfe_burst_end();
+
+    control_worker::clock::time_point device_to_host_time(uint64_t timestamp);
+
+    uint64_t hardware_time();
+
+    void check_late();
+
+    int send_segment(gr_vector_const_void_star& input_items,
+                     int offset,
+                     int items,
+                     const lms_stream_meta_t& meta);
+
+    int send_mimo(gr_vector_const_void_star& input_items, int items, const lms_stream_meta_t& meta);
 
     void print_stream_stats(int channel);
 
+    int read_stream_status(int channel, lms_stream_status_t* status);
+
+    void publish_telemetry(int channel, const lms_stream_status_t& status);
+
+    void update_health();
+
+    void update_latency(int channel);
+
+    void update_telemetry();
+
+    int packet_samples();
+
+    void start_tx_thread();
+    void stop_tx_thread();
+    void tx_thread_loop();
+    void tx_thread_send(size_t items, const lms_stream_meta_t& meta);
+    size_t tx_ring_items();
+    int work_to_ring(int noutput_items, gr_vector_const_void_star& input_items);
+
     public:
     sink_impl(std::string serial,
               int channel_mode,
               const std::string& filename,
-              const std::string& length_tag_name);
+              const std::string& length_tag_name,
+              int data_format);
     ~sink_impl();
 
     int general_work(int noutput_items,
@@ -74,9 +254,12 @@ class sink_impl : public sink {
 
     bool stop(void);
 
-    inline gr::io_signature::sptr args_to_io_signature(int channel_number);
+    inline gr::io_signature::sptr args_to_io_signature(int channel_number, int data_format);
 
     void init_stream(int device_number, int channel);
+    void update_stream_settings();
+    void rebuild_stream();
+    void start_streams();
     void release_stream(int device_number, lms_stream_t* stream);
 
     double set_center_freq(double freq, size_t chan = 0);
@@ -99,8 +282,56 @@ class sink_impl : public sink {
     void set_buffer_size(uint32_t size);
 
     void calibrate(double bandw, int channel = 0);
+
+    void set_calibration_cache(bool enable);
+
+    bool save_snapshot(const std::string& filename);
     
     void set_tcxo_dac(uint16_t dacVal = 125);
+
+    void set_latency_profile(int profile);
+
+    void set_throughput_vs_latency(double value);
+
+    double get_throughput_vs_latency() { return stored.throughput_vs_latency; }
+
+    uint32_t get_fifo_size() { return stored.stream_FIFO_size; }
+
+    double get_stream_latency() { return stream_latency; }
+
+    void set_telemetry_rate(double rate_hz) { telemetry.set_rate(rate_hz); }
+
+    double get_telemetry_rate() { return telemetry.get_rate(); }
+
+    void set_health_monitor(double rate_hz);
+
+    double get_temperature();
+
+    bool get_clock_locked();
+
+    int set_hop_table(const std::vector<double>& freqs);
+
+    double hop(int index);
+
+    double get_last_hop_duration() { return hop_stats.last_duration; }
+
+    uint64_t get_hop_count() { return hop_stats.count; }
+
+    void set_tx_thread(bool enable, uint32_t ring_size = 0, double fill_level = 0.5, int cpu = -1);
+
+    uint32_t get_ring_size();
+
+    uint64_t get_underruns() { return underruns; }
+
+    void set_late_policy(int policy);
+
+    uint64_t get_late_count() { return late.count; }
+
+    double get_last_lateness() { return late.last_lateness; }
+
+    void set_sync_start(bool enable, double fref_MHz = 0);
+
+    std::vector<double> get_sync_offsets();
 };
 } // namespace limesdr
 } // namespace gr
@@ -24,25 +24,38 @@
 
 #include "source_impl.h"
 #include <gnuradio/io_signature.h>
+#include <gnuradio/realtime.h>
+#include <gnuradio/thread/thread.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 
 namespace gr {
 namespace limesdr {
 source::sptr source::make(std::string serial,
                           int channel_mode,
                           const std::string& filename,
-                          bool enable_PPS_mode) {
+                          bool enable_PPS_mode,
+                          int data_format) {
+#ifdef LIMESDR_GR_STD_SPTR
+    return gnuradio::make_block_sptr<source_impl>(
+        serial, channel_mode, filename, enable_PPS_mode, data_format);
+#else
     return gnuradio::get_initial_sptr(
-        new source_impl(serial, channel_mode, filename, enable_PPS_mode));
+        new source_impl(serial, channel_mode, filename, enable_PPS_mode, data_format));
+#endif
 }
 
 source_impl::source_impl(std::string serial,
                          int channel_mode,
                          const std::string& filename,
-                         bool enable_PPS_mode)
+                         bool enable_PPS_mode,
+                         int data_format)
     : gr::block("source",
                 gr::io_signature::make(
                     0, 0, 0), // Based on channel_mode SISO/MIMO use appropriate output signature
-                args_to_io_signature(channel_mode)) {
+                args_to_io_signature(channel_mode, data_format)) {
     std::cout << "---------------------------------------------------------------" << std::endl;
     std::cout << "LimeSuite Source (RX) info" << std::endl;
     std::cout << std::endl;
@@ -50,6 +63,8 @@ source_impl::source_impl(std::string serial,
     // 1. Store private variables upon implementation to protect from changing them later
     stored.serial = serial;
     stored.channel_mode = channel_mode;
+    stored.data_format = data_format;
+    stored.item_size = output_signature()->sizeof_stream_item(0);
 
     if (stored.channel_mode < 0 && stored.channel_mode > 2) {
         std::cout
@@ -60,6 +75,7 @@ source_impl::source_impl(std::string serial,
 
     // 2. Open device if not opened
     stored.device_number = device_handler::getInstance().open_device(stored.serial);
+    backend = &device_handler::getInstance().get_stream_backend(stored.device_number);
     // 3. Check where to load settings from (file or block)
     if (!filename.empty()) {
         device_handler::getInstance().settings_from_file(stored.device_number, filename, nullptr);
@@ -75,14 +91,41 @@ source_impl::source_impl(std::string serial,
             stored.device_number, stored.channel_mode, LMS_CH_RX);
     }
 
+    // 6. Let each receive map onto whole LimeSuite packets
+    this->update_stream_settings();
+
+    message_port_register_out(TELEMETRY_PORT);
+    message_port_register_out(HEALTH_PORT);
+    message_port_register_in(HOP_PORT);
+    set_msg_handler(HOP_PORT, [this](pmt::pmt_t msg) { this->hop_message(msg); });
+    message_port_register_in(COMMAND_PORT);
+    message_port_register_out(COMMAND_REPLY_PORT);
+    set_msg_handler(COMMAND_PORT, [this](pmt::pmt_t msg) { this->command_message(msg); });
+
+    // 7. Intern tag source id once, receive path only reuses it
+    tag_values.serial = pmt::string_to_symbol(stored.serial);
+    tag_values.zero_frac = pmt::from_double(0.0);
+    this->update_tag_values();
+
     // ESA PPS counter mod.
     device_handler::getInstance().set_PPS_mode(stored.device_number, enable_PPS_mode);
     PPS_mode = enable_PPS_mode;
+    sync.PPS_requested = enable_PPS_mode;
     last_pps_sample_counter_ch0 = 0;
     last_pps_sample_counter_ch1 = 0;
 }
 
 source_impl::~source_impl() {
+    // Drop commands still queued in device control worker
+    {
+        std::lock_guard<std::mutex> lock(commands->mutex);
+        commands->alive = false;
+    }
+    timed_commands.stop();
+    if (sync.enabled)
+        device_handler::getInstance().sync_leave();
+    this->stop_rx_thread();
+    this->close_recording();
     // Stop and destroy stream for channel 0 (if channel_mode is SISO)
     if (stored.channel_mode < 2) {
         this->release_stream(stored.device_number, &streamId[stored.channel_mode]);
@@ -96,50 +139,88 @@ source_impl::~source_impl() {
 }
 
 bool source_impl::start(void) {
-    std::unique_lock<std::recursive_mutex> lock(device_handler::getInstance().block_mutex);
-    // Initialize and start stream for channel 0 (if channel_mode is SISO)
-    if (stored.channel_mode < 2) // If SISO configure prefered channel
+    start_t = std::chrono::high_resolution_clock::now();
+    // Capture files are created before streams, which are set up in int16 for recording
+    recording.active = !recording.filename.empty() &&
+                       (recording.file[0].is_open() || this->open_recording());
     {
-        this->init_stream(stored.device_number, stored.channel_mode);
-        if (LMS_StartStream(&streamId[stored.channel_mode]) != LMS_SUCCESS)
-            device_handler::getInstance().error(stored.device_number);
-    }
+        std::lock_guard<std::recursive_mutex> lock(
+            device_handler::getInstance().get_device_mutex(stored.device_number));
+        // Initialize stream for channel 0 (if channel_mode is SISO)
+        if (stored.channel_mode < 2) // If SISO configure prefered channel
+        {
+            this->init_stream(stored.device_number, stored.channel_mode);
+        }
 
-    // Initialize and start stream for channels 0 & 1 (if channel_mode is MIMO)
-    else if (stored.channel_mode == 2) {
+        // Initialize stream for channels 0 & 1 (if channel_mode is MIMO)
+        else if (stored.channel_mode == 2) {
+            mimo_carry.buffer[LMS_CH_0].clear();
+            mimo_carry.buffer[LMS_CH_1].clear();
 
-        this->init_stream(stored.device_number, LMS_CH_0);
-        this->init_stream(stored.device_number, LMS_CH_1);
+            this->init_stream(stored.device_number, LMS_CH_0);
+            this->init_stream(stored.device_number, LMS_CH_1);
+        }
+    }
+    // Synchronized start may start streams of other devices, so device lock is not held
+    this->start_streams();
 
-        if (LMS_StartStream(&streamId[LMS_CH_0]) != LMS_SUCCESS)
-            device_handler::getInstance().error(stored.device_number);
-        if (LMS_StartStream(&streamId[LMS_CH_1]) != LMS_SUCCESS)
-            device_handler::getInstance().error(stored.device_number);
+    rx_thread.active = rx_thread.enabled && !recording.active;
+    if (rx_thread.active)
+        this->start_rx_thread();
+    if (recording.active) {
+        recording.running = true;
+        recording.thread = std::thread(&source_impl::recording_loop, this);
     }
-    std::unique_lock<std::recursive_mutex> unlock(device_handler::getInstance().block_mutex);
 
     if (stream_analyzer) {
         t1 = std::chrono::high_resolution_clock::now();
         t2 = t1;
     }
 
+    telemetry.reset(!pmt::is_null(message_subscribers(TELEMETRY_PORT)));
+    health.connected = !pmt::is_null(message_subscribers(HEALTH_PORT));
+
     add_tag = true;
+    status_t = std::chrono::high_resolution_clock::now();
+    next_rx_timestamp[0] = next_rx_timestamp[1] = 0;
+    first_samples_pending = true;
+    // Edge offsets refer to output offsets of the previous run
+    pps.channel[0] = pps.channel[1] = pps_data::channel_model();
+    pps.edges = 0;
 
     return true;
 }
 
 bool source_impl::stop(void) {
-    std::unique_lock<std::recursive_mutex> lock(device_handler::getInstance().block_mutex);
-    // Stop stream for channel 0 (if channel_mode is SISO)
-    if (stored.channel_mode < 2) {
-        this->release_stream(stored.device_number, &streamId[stored.channel_mode]);
+    // Timed commands refer to timestamps of the stream being stopped
+    timed_commands.clear();
+    // Reader and recording threads must finish before streams are destroyed
+    this->stop_rx_thread();
+    this->close_recording();
+    streaming = false;
+    {
+        std::lock_guard<std::mutex> tag_lock(tag_values.mutex);
+        tag_values.retunes.clear();
+        tag_values.pending_retunes = 0;
     }
-    // Stop streams for channels 0 & 1 (if channel_mode is MIMO)
-    else if (stored.channel_mode == 2) {
-        this->release_stream(stored.device_number, &streamId[LMS_CH_0]);
-        this->release_stream(stored.device_number, &streamId[LMS_CH_1]);
+    // Streams still waiting for the rest of synchronized start group
+    if (sync.enabled)
+        device_handler::getInstance().sync_cancel(
+            (stored.channel_mode < 2) ? &streamId[stored.channel_mode] : streamId,
+            (stored.channel_mode < 2) ? 1 : 2);
+    {
+        std::lock_guard<std::recursive_mutex> lock(
+            device_handler::getInstance().get_device_mutex(stored.device_number));
+        // Stop stream for channel 0 (if channel_mode is SISO)
+        if (stored.channel_mode < 2) {
+            this->release_stream(stored.device_number, &streamId[stored.channel_mode]);
+        }
+        // Stop streams for channels 0 & 1 (if channel_mode is MIMO)
+        else if (stored.channel_mode == 2) {
+            this->release_stream(stored.device_number, &streamId[LMS_CH_0]);
+            this->release_stream(stored.device_number, &streamId[LMS_CH_1]);
+        }
     }
-    std::unique_lock<std::recursive_mutex> unlock(device_handler::getInstance().block_mutex);
     return true;
 }
 
@@ -147,73 +228,100 @@ int source_impl::general_work(int noutput_items,
                               gr_vector_int& ninput_items,
                               gr_vector_const_void_star& input_items,
                               gr_vector_void_star& output_items) {
+    // Samples are written to disk by recording thread, nothing is produced
+    if (recording.active) {
+        this->update_health();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return 0;
+    }
+    // Samples are received by RX reader thread, only copy them from ring buffer
+    if (rx_thread.active) {
+        return this->work_from_ring(noutput_items, output_items);
+    }
     // Receive stream for channel 0 (if channel_mode is SISO)
     if (stored.channel_mode < 2) {
-        lms_stream_status_t status;
         lms_stream_meta_t rx_metadata;
 
-        int ret0 = LMS_RecvStream(
-            &streamId[stored.channel_mode], output_items[0], noutput_items, &rx_metadata, 100);
-        if (ret0 < 0) {
+        int ret0;
+        if (pps.disciplined) {
+            void* buffers[2] = {output_items[0], nullptr};
+            ret0 = this->recv_pps(buffers, noutput_items, &rx_metadata);
+        } else {
+            ret0 = backend->recv(
+                &streamId[stored.channel_mode], output_items[0], noutput_items, &rx_metadata, 100);
+        }
+        // Metadata is not filled on timeout
+        if (ret0 <= 0) {
             return 0;
         }
 
-        LMS_GetStreamStatus(&streamId[stored.channel_mode], &status);
+        // Gap in device timestamps means samples were dropped
+        bool discontinuity = rx_metadata.timestamp != next_rx_timestamp[0];
+        // Counter of PPS disciplined stream is tracked by recv_pps()
+        if (!pps.disciplined)
+            next_rx_timestamp[0] = rx_metadata.timestamp + ret0;
 
         if (PPS_mode == false) // default LimeSDR sample counter
         {
-            if (add_tag || status.droppedPackets > 0) {
-                pktLoss += status.droppedPackets;
+            if (add_tag || discontinuity) {
                 add_tag = false;
-                this->add_time_tag(LMS_CH_0, rx_metadata);
+                this->add_time_tag(LMS_CH_0, rx_metadata.timestamp, nitems_written(LMS_CH_0));
             }
+        } else if (pps.disciplined) {
+            // Edges are tagged by recv_pps()
         } else {
             // ESA PPS mode is active: Report sample counter only in PPS transitions (sample counter
             // reset)
             if (rx_metadata.timestamp < last_pps_sample_counter_ch0) // PPS transition detected
             {
-                add_PPS_time_tag(LMS_CH_0, rx_metadata.timestamp);
+                add_PPS_time_tag(LMS_CH_0, rx_metadata.timestamp, nitems_written(LMS_CH_0));
             }
             last_pps_sample_counter_ch0 = rx_metadata.timestamp;
         }
-        // Print stream stats to debug
-        if (stream_analyzer == true) {
-            this->print_stream_stats(status);
-        }
+        uint64_t first_timestamp[2] = {rx_metadata.timestamp, 0};
+        this->tag_retunes(1, first_timestamp, ret0);
+        this->poll_stream_status(next_rx_timestamp[0]);
+        this->correct_iq(0, output_items[0], ret0);
 
         produce(0, ret0);
         return WORK_CALLED_PRODUCE;
     }
     // Receive stream for channels 0 & 1 (if channel_mode is MIMO)
     else if (stored.channel_mode == 2) {
-        lms_stream_status_t status[2];
-
         lms_stream_meta_t rx_metadata[2];
-        int ret0 = LMS_RecvStream(
-            &streamId[LMS_CH_0], output_items[0], noutput_items, &rx_metadata[0], 100);
-        int ret1 = LMS_RecvStream(
-            &streamId[LMS_CH_1], output_items[1], noutput_items, &rx_metadata[1], 100);
-        if (ret0 <= 0 || ret1 <= 0) {
+        void* buffers[2] = {output_items[0], output_items[1]};
+        int ret = pps.disciplined ? this->recv_pps(buffers, noutput_items, rx_metadata)
+                                  : this->recv_mimo(buffers, noutput_items, rx_metadata);
+        if (ret <= 0) {
             return 0;
         }
 
-        LMS_GetStreamStatus(&streamId[LMS_CH_0], &status[0]);
-        LMS_GetStreamStatus(&streamId[LMS_CH_1], &status[1]);
+        // Gap in device timestamps means samples were dropped
+        bool discontinuity = false;
+        for (int i = 0; i < 2; i++) {
+            discontinuity |= rx_metadata[i].timestamp != next_rx_timestamp[i];
+            // Counter of PPS disciplined stream is tracked by recv_pps()
+            if (!pps.disciplined)
+                next_rx_timestamp[i] = rx_metadata[i].timestamp + ret;
+        }
+
         if (PPS_mode == false) // default LimeSDR sample counter
         {
-            if (add_tag || status[0].droppedPackets > 0 || status[1].droppedPackets > 0) {
-                pktLoss += status[0].droppedPackets; // because every time GetStreamStatus is
-                                                     // called, packet loss is reset
+            if (add_tag || discontinuity) {
                 add_tag = false;
-                this->add_time_tag(LMS_CH_0, rx_metadata[0]);
-                this->add_time_tag(LMS_CH_1, rx_metadata[1]);
+                this->add_time_tag(
+                    LMS_CH_0, rx_metadata[0].timestamp, nitems_written(LMS_CH_0));
+                this->add_time_tag(
+                    LMS_CH_1, rx_metadata[1].timestamp, nitems_written(LMS_CH_1));
             }
+        } else if (pps.disciplined) {
+            // Edges are tagged by recv_pps()
         } else {
             // ESA PPS mode is active: Report sample counter only in PPS transitions (sample counter
             // reset)
             if (rx_metadata[0].timestamp < last_pps_sample_counter_ch0) // PPS transition detected
             {
-                add_PPS_time_tag(LMS_CH_0, rx_metadata[0].timestamp);
+                add_PPS_time_tag(LMS_CH_0, rx_metadata[0].timestamp, nitems_written(LMS_CH_0));
             }
             last_pps_sample_counter_ch0 = rx_metadata[0].timestamp;
 
@@ -221,44 +329,378 @@ int source_impl::general_work(int noutput_items,
             // reset)
             if (rx_metadata[1].timestamp < last_pps_sample_counter_ch1) // PPS transition detected
             {
-                add_PPS_time_tag(LMS_CH_1, rx_metadata[1].timestamp);
+                add_PPS_time_tag(LMS_CH_1, rx_metadata[1].timestamp, nitems_written(LMS_CH_1));
             }
             last_pps_sample_counter_ch1 = rx_metadata[1].timestamp;
         }
+        uint64_t first_timestamp[2] = {rx_metadata[0].timestamp, rx_metadata[1].timestamp};
+        this->tag_retunes(2, first_timestamp, ret);
+        this->poll_stream_status(next_rx_timestamp[0]);
+        this->correct_iq(0, output_items[0], ret);
+        this->correct_iq(1, output_items[1], ret);
 
-        // Print stream stats to debug
-        if (stream_analyzer == true) {
-            this->print_stream_stats(status[0]);
-        }
-
-        this->produce(0, ret0);
-        this->produce(1, ret1);
+        this->produce(0, ret);
+        this->produce(1, ret);
         return WORK_CALLED_PRODUCE;
     }
     return 0;
 }
 
+// Receive the same number of samples on both MIMO channels.
+// Channel 0 sets the amount and channel 1 is asked for exactly as many samples,
+// samples received on one channel only are carried over to the next call.
+int source_impl::recv_mimo(void* buffers[2], int items, lms_stream_meta_t rx_metadata[2]) {
+    const size_t item_size = this->stream_item_size();
+    int received[2];
+    for (int i = 0; i < 2; i++) {
+        std::vector<char>& carry = mimo_carry.buffer[i];
+        size_t carried = std::min(carry.size() / item_size, (size_t)items);
+        if (carried > 0) {
+            std::memcpy(buffers[i], carry.data(), carried * item_size);
+            carry.erase(carry.begin(), carry.begin() + carried * item_size);
+        }
+        rx_metadata[i].timestamp = mimo_carry.timestamp[i];
+        mimo_carry.timestamp[i] += carried;
+        received[i] = carried;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        int wanted = (i == LMS_CH_0) ? items : received[LMS_CH_0];
+        if (received[i] >= wanted)
+            continue;
+        lms_stream_meta_t meta;
+        char* dst = static_cast<char*>(buffers[i]) + received[i] * item_size;
+        int ret = backend->recv(&streamId[i], dst, wanted - received[i], &meta, 100);
+        if (ret <= 0)
+            continue;
+        if (received[i] == 0)
+            rx_metadata[i].timestamp = meta.timestamp;
+        received[i] += ret;
+    }
+
+    int aligned = std::min(received[LMS_CH_0], received[LMS_CH_1]);
+    for (int i = 0; i < 2; i++) {
+        if (received[i] > aligned) {
+            char* excess = static_cast<char*>(buffers[i]) + aligned * item_size;
+            mimo_carry.buffer[i].insert(mimo_carry.buffer[i].begin(),
+                                        excess,
+                                        excess + (received[i] - aligned) * item_size);
+            mimo_carry.timestamp[i] = rx_metadata[i].timestamp + aligned;
+        }
+    }
+    return aligned;
+}
+
+void source_impl::start_rx_thread() {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    uint32_t ring_size = this->get_ring_size();
+    for (int i = 0; i < channels; i++) {
+        if (!rx_thread.ring[i] || rx_thread.ring[i]->capacity() != ring_size)
+            rx_thread.ring[i].reset(new ring_buffer(ring_size, stored.item_size));
+        if (!rx_thread.markers[i])
+            rx_thread.markers[i].reset(new ring_buffer(1024, sizeof(timestamp_marker)));
+        rx_thread.ring[i]->reset();
+        rx_thread.markers[i]->reset();
+        rx_thread.ring_timestamp[i] = 0;
+    }
+    rx_thread.overflows = 0;
+    rx_thread.dropped_samples = 0;
+    rx_thread.running = true;
+    rx_thread.thread = std::thread(&source_impl::rx_thread_loop, this);
+
+    std::cout << "INFO: source_impl::start_rx_thread(): RX reader thread started, ring size "
+              << ring_size << " samples";
+    if (rx_thread.cpu >= 0)
+        std::cout << ", pinned to CPU " << rx_thread.cpu;
+    std::cout << "." << std::endl;
+}
+
+void source_impl::stop_rx_thread() {
+    if (rx_thread.thread.joinable()) {
+        rx_thread.running = false;
+        rx_thread.thread.join();
+    }
+}
+
+// Drain device streams into ring buffers
+void source_impl::rx_thread_loop() {
+    if (rx_thread.cpu >= 0)
+        gr::thread::thread_bind_to_processor(rx_thread.cpu);
+    if (gr::enable_realtime_scheduling() != gr::RT_OK)
+        std::cout << "WARNING: source_impl::rx_thread_loop(): unable to enable realtime "
+                     "scheduling for RX reader thread."
+                  << std::endl;
+
+    const size_t chunk = packet_samples() * packets_to_batch();
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    std::vector<char> scratch[2];
+    for (int i = 0; i < channels; i++)
+        scratch[i].resize(chunk * stored.item_size);
+    uint64_t next_timestamp[2] = {0};
+    bool first[2] = {true, true};
+    bool overflow[2] = {false, false};
+
+    while (rx_thread.running) {
+        if (channels == 2) {
+            this->rx_thread_recv_mimo(scratch, next_timestamp, first, overflow);
+            continue;
+        }
+        for (int i = 0; i < channels; i++) {
+            lms_stream_t* stream = (channels == 1) ? &streamId[stored.channel_mode] : &streamId[i];
+            ring_buffer& ring = *rx_thread.ring[i];
+
+            // Receive directly into ring, or into scratch buffer if ring is full
+            size_t count;
+            void* dst = ring.write_ptr(count);
+            count = std::min(count, chunk);
+            bool full = (count == 0);
+            if (full) {
+                dst = scratch[i].data();
+                count = chunk;
+            }
+
+            lms_stream_meta_t rx_metadata;
+            int ret = backend->recv(stream, dst, count, &rx_metadata, 100);
+            if (ret <= 0)
+                continue;
+
+            if (full) {
+                if (!overflow[i])
+                    rx_thread.overflows++;
+                overflow[i] = true;
+                rx_thread.dropped_samples += ret;
+                continue;
+            }
+            overflow[i] = false;
+
+            // Report timestamp discontinuity (stream start, dropped packets, ring overflow or
+            // PPS counter reset) so that consumer could tag it
+            if (first[i] || rx_metadata.timestamp != next_timestamp[i]) {
+                timestamp_marker marker = {ring.items_written(), rx_metadata.timestamp};
+                rx_thread.markers[i]->write(&marker, 1);
+                first[i] = false;
+            }
+            next_timestamp[i] = rx_metadata.timestamp + ret;
+            ring.commit_write(ret);
+        }
+    }
+}
+
+// Receive both MIMO channels into their ring buffers in lockstep
+void source_impl::rx_thread_recv_mimo(std::vector<char> scratch[2],
+                                      uint64_t next_timestamp[2],
+                                      bool first[2],
+                                      bool overflow[2]) {
+    const size_t chunk = scratch[0].size() / stored.item_size;
+    size_t count[2];
+    void* buffers[2];
+    for (int i = 0; i < 2; i++)
+        buffers[i] = rx_thread.ring[i]->write_ptr(count[i]);
+    size_t items = std::min(std::min(count[0], count[1]), chunk);
+    bool full = (items == 0);
+    if (full) {
+        buffers[0] = scratch[0].data();
+        buffers[1] = scratch[1].data();
+        items = chunk;
+    }
+
+    lms_stream_meta_t rx_metadata[2];
+    int ret = this->recv_mimo(buffers, items, rx_metadata);
+    if (ret <= 0)
+        return;
+
+    for (int i = 0; i < 2; i++) {
+        if (full) {
+            if (!overflow[i])
+                rx_thread.overflows++;
+            overflow[i] = true;
+            if (i == 0)
+                rx_thread.dropped_samples += ret;
+            continue;
+        }
+        overflow[i] = false;
+        if (first[i] || rx_metadata[i].timestamp != next_timestamp[i]) {
+            timestamp_marker marker = {rx_thread.ring[i]->items_written(),
+                                       rx_metadata[i].timestamp};
+            rx_thread.markers[i]->write(&marker, 1);
+            first[i] = false;
+        }
+        next_timestamp[i] = rx_metadata[i].timestamp + ret;
+        rx_thread.ring[i]->commit_write(ret);
+    }
+}
+
+int source_impl::work_from_ring(int noutput_items, gr_vector_void_star& output_items) {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    size_t items = noutput_items;
+    for (int i = 0; i < channels; i++) {
+        if (!rx_thread.ring[i]->wait_for_items(1, std::chrono::milliseconds(100)))
+            return 0;
+        items = std::min(items, rx_thread.ring[i]->items_available());
+    }
+
+    uint64_t first_timestamp[2] = {0};
+    for (int i = 0; i < channels; i++) {
+        ring_buffer& markers = *rx_thread.markers[i];
+        uint64_t first_index = rx_thread.ring[i]->items_read();
+        bool tagged = false;
+        if (pps.disciplined)
+            this->pps_lookahead(i, first_index, items);
+
+        // Tag timestamp discontinuities falling into this output buffer
+        while (markers.items_available() > 0) {
+            size_t contiguous;
+            const timestamp_marker* marker =
+                static_cast<const timestamp_marker*>(markers.read_ptr(contiguous));
+            if (marker->index >= first_index + items)
+                break;
+
+            uint64_t position = marker->index - first_index;
+            if (PPS_mode == false) {
+                this->add_time_tag(i, marker->timestamp, nitems_written(i) + position);
+                tagged = tagged || position == 0;
+            } else if (pps.disciplined) {
+                this->pps_track(i,
+                                marker->timestamp,
+                                rx_thread.ring_timestamp[i] + position,
+                                nitems_written(i) + position);
+            } else if (marker->timestamp < rx_thread.ring_timestamp[i] + position) {
+                // ESA PPS mode: sample counter went back, PPS transition detected
+                this->add_PPS_time_tag(i, marker->timestamp, nitems_written(i) + position);
+            }
+            rx_thread.ring_timestamp[i] = marker->timestamp - position;
+            markers.commit_read(1);
+        }
+
+        if (add_tag && !tagged && PPS_mode == false)
+            this->add_time_tag(i, rx_thread.ring_timestamp[i], nitems_written(i));
+
+        first_timestamp[i] = rx_thread.ring_timestamp[i];
+        rx_thread.ring[i]->read(output_items[i], items);
+        rx_thread.ring_timestamp[i] += items;
+    }
+    add_tag = false;
+    this->tag_retunes(channels, first_timestamp, items);
+    for (int i = 0; i < channels; i++) {
+        this->correct_iq(i, output_items[i], items);
+        this->produce(i, items);
+    }
+
+    // Latency includes ring buffer fill
+    this->poll_stream_status(rx_thread.ring_timestamp[0]);
+    return WORK_CALLED_PRODUCE;
+}
+
 // Setup stream
 void source_impl::init_stream(int device_number, int channel) {
+    this->update_stream_settings();
     streamId[channel].channel = channel;
-    streamId[channel].fifoSize =
-        (stored.FIFO_size == 0) ? (int)stored.samp_rate / 10 : stored.FIFO_size;
-    streamId[channel].throughputVsLatency = 0.5;
+    streamId[channel].fifoSize = stored.stream_FIFO_size;
+    streamId[channel].throughputVsLatency = stored.throughput_vs_latency;
     streamId[channel].isTx = LMS_CH_RX;
-    streamId[channel].dataFmt = lms_stream_t::LMS_FMT_F32;
+    // Recording always writes native int16 samples
+    int format = stored.data_format;
+    if (recording.active && format == LIMESDR_FMT_F32)
+        format = LIMESDR_FMT_I16;
+    switch (format) {
+    case LIMESDR_FMT_I16:
+        streamId[channel].dataFmt = lms_stream_t::LMS_FMT_I16;
+        break;
+    case LIMESDR_FMT_I12:
+        streamId[channel].dataFmt = lms_stream_t::LMS_FMT_I12;
+        break;
+    default:
+        streamId[channel].dataFmt = lms_stream_t::LMS_FMT_F32;
+        break;
+    }
 
-    if (LMS_SetupStream(device_handler::getInstance().get_device(stored.device_number),
-                        &streamId[channel]) != LMS_SUCCESS)
+    if (backend->setup(&streamId[channel]) != LMS_SUCCESS)
         device_handler::getInstance().error(stored.device_number);
 
     std::cout << "INFO: source_impl::init_stream(): source channel " << channel << " (device nr. "
-              << device_number << ") stream setup done." << std::endl;
+              << device_number << ") stream setup done, FIFO: " << stored.stream_FIFO_size
+              << " samples, throughputVsLatency: " << stored.throughput_vs_latency << "."
+              << std::endl;
+}
+
+// Select FIFO size and throughputVsLatency from latency profile and explicit overrides
+void source_impl::update_stream_settings() {
+    device_handler::getInstance().get_latency_profile(stored.latency_profile,
+                                                      stored.samp_rate,
+                                                      stored.throughput_vs_latency,
+                                                      stored.stream_FIFO_size);
+    if (stored.throughput_vs_latency_override >= 0)
+        stored.throughput_vs_latency = stored.throughput_vs_latency_override;
+    if (stored.FIFO_size != 0)
+        stored.stream_FIFO_size = stored.FIFO_size;
+    // Packet and batch sizes follow data format and throughputVsLatency
+    this->align_to_packets();
+}
+
+// Apply new stream settings if streaming is already running
+void source_impl::rebuild_stream() {
+    if (!streaming)
+        return;
+    // Keep general_work out while streams are recreated
+    gr::thread::scoped_lock guard(d_setlock);
+    // Other devices keep streaming, so restarted streams can't wait for synchronized start
+    sync.restarting = true;
+    this->stop();
+    this->start();
+    sync.restarting = false;
+}
+
+void source_impl::start_streams() {
+    lms_stream_t* streams = (stored.channel_mode < 2) ? &streamId[stored.channel_mode] : streamId;
+    int count = (stored.channel_mode < 2) ? 1 : 2;
+    if (!sync.restarting && sync.fref_MHz > 0)
+        device_handler::getInstance().set_ext_clk(stored.device_number, sync.fref_MHz);
+    if (sync.enabled && !sync.restarting) {
+        device_handler::getInstance().sync_start(stored.device_number, streams, count, &streaming);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (backend->start(&streams[i]) != LMS_SUCCESS)
+            device_handler::getInstance().error(stored.device_number);
+    }
+    streaming = true;
+}
+
+// Number of samples per channel carried by one LimeSuite USB packet
+int source_impl::packet_samples() {
+    // Recording streams int16 samples over 16-bit link
+    int format = stored.data_format;
+    if (recording.active && format == LIMESDR_FMT_F32)
+        format = LIMESDR_FMT_I16;
+    return device_handler::getInstance().get_packet_samples(format,
+                                                            (stored.channel_mode < 2) ? 1 : 2);
+}
+
+// Approximate number of packets LimeSuite batches in one transfer,
+// which grows with throughputVsLatency setting
+int source_impl::packets_to_batch() {
+    return 1 << (int)std::lround(stored.throughput_vs_latency * 4);
+}
+
+// Request output buffers sized in whole packets, so that LMS_RecvStream
+// doesn't have to split packets and copies straight into output buffer
+void source_impl::align_to_packets() {
+    int samples = this->packet_samples();
+    int buffer = 2 * samples * this->packets_to_batch();
+    if (samples == output_multiple() && buffer == aligned_buffer)
+        return;
+    this->set_output_multiple(samples);
+    // Buffers are allocated on flowgraph start, so new size is used from the next one
+    this->set_min_output_buffer(buffer);
+    aligned_buffer = buffer;
+    std::cout << "INFO: source_impl::align_to_packets(): output multiple set to " << samples
+              << " samples, minimum output buffer " << buffer << " samples." << std::endl;
 }
 
 void source_impl::release_stream(int device_number, lms_stream_t* stream) {
     if (stream->handle != 0) {
-        LMS_StopStream(stream);
-        LMS_DestroyStream(device_handler::getInstance().get_device(device_number), stream);
+        backend->stop(stream);
+        backend->destroy(stream);
     }
 }
 
@@ -270,33 +712,227 @@ void source_impl::print_stream_stats(lms_stream_status_t status) {
         std::cout << std::endl;
         std::cout << "RX";
         std::cout << "|rate: " << status.linkRate / 1e6 << " MB/s ";
-        std::cout << "|dropped packets: " << pktLoss << " ";
+        uint64_t dropped = this->dropped_packets();
+        std::cout << "|dropped packets: " << dropped - pktLoss << " ";
         std::cout << "|FIFO: " << 100 * status.fifoFilledCount / status.fifoSize << "%"
                   << std::endl;
-        pktLoss = 0;
+        pktLoss = dropped;
         t1 = t2;
     }
 }
 
-// Add rx_time tag to stream
-void source_impl::add_time_tag(int channel, lms_stream_meta_t meta) {
+// Every status read goes through here, LimeSuite resets its counters on each read, so they
+// are kept in telemetry totals for all readers
+int source_impl::read_stream_status(int channel, lms_stream_status_t* status) {
+    int ret = backend->status(&streamId[channel], status);
+    if (ret == LMS_SUCCESS)
+        telemetry.accumulate(channel, *status);
+    return ret;
+}
+
+uint64_t source_impl::dropped_packets() {
+    if (stored.channel_mode < 2)
+        return telemetry.total(stored.channel_mode).dropped_packets;
+    return telemetry.total(LMS_CH_0).dropped_packets + telemetry.total(LMS_CH_1).dropped_packets;
+}
+
+// Stream status takes LimeSuite locks, so it is read only once per status period or when
+// telemetry report is due, instead of on every receive
+void source_impl::poll_stream_status(uint64_t next_timestamp) {
+    this->update_health();
+    if (first_samples_pending && next_timestamp != 0) {
+        first_samples_pending = false;
+        std::cout << "INFO: source_impl::poll_stream_status(): first samples received "
+                  << std::chrono::duration<double, std::milli>(
+                         std::chrono::high_resolution_clock::now() - start_t)
+                         .count()
+                  << " ms after start." << std::endl;
+    }
+    bool report = telemetry.enabled() && telemetry.due();
+    auto now = std::chrono::high_resolution_clock::now();
+    if (!report &&
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - status_t).count() < 1000)
+        return;
+    status_t = now;
+
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    lms_stream_status_t status[2];
+    for (int i = 0; i < channels; i++) {
+        int channel = (stored.channel_mode < 2) ? stored.channel_mode : i;
+        this->read_stream_status(channel, &status[i]);
+        if (report)
+            this->publish_telemetry(channel, status[i]);
+    }
+    this->update_latency(next_timestamp, status[0]);
+    // Print stream stats to debug
+    if (stream_analyzer == true)
+        this->print_stream_stats(status[0]);
+}
+
+void source_impl::publish_telemetry(int channel, const lms_stream_status_t& status) {
+    message_port_pub(TELEMETRY_PORT, telemetry.make_report(channel, status));
+}
+
+// Publish health snapshot once after every monitor poll
+void source_impl::update_health() {
+    if (!health.connected)
+        return;
+    health_snapshot snapshot;
+    if (!device_handler::getInstance().get_health(stored.device_number, snapshot) ||
+        snapshot.sequence == health.sequence)
+        return;
+    health.sequence = snapshot.sequence;
+    message_port_pub(HEALTH_PORT, health_monitor::make_report(snapshot));
+}
 
+void source_impl::set_health_monitor(double rate_hz) {
+    device_handler::getInstance().set_health_monitor(rate_hz);
+}
+
+double source_impl::get_temperature() {
+    health_snapshot snapshot;
+    device_handler::getInstance().get_health(stored.device_number, snapshot);
+    return snapshot.temperature;
+}
+
+bool source_impl::get_clock_locked() {
+    health_snapshot snapshot;
+    device_handler::getInstance().get_health(stored.device_number, snapshot);
+    return snapshot.cgen_locked;
+}
+
+// Latency between the newest sample output by the block and device hardware time
+void source_impl::update_latency(uint64_t next_timestamp, const lms_stream_status_t& status) {
+    stream_latency = (int64_t)(status.timestamp - next_timestamp) / stored.samp_rate;
+}
+
+// Build rx_time value of device timestamp
+pmt::pmt_t source_impl::make_time_value(int channel, uint64_t timestamp) {
     uint64_t u_rate = (uint64_t)stored.samp_rate;
     double f_rate = stored.samp_rate - u_rate;
-    uint64_t intpart = meta.timestamp / u_rate;
-    double fracpart = (meta.timestamp - intpart * u_rate - intpart * f_rate) / stored.samp_rate;
+    uint64_t intpart = timestamp / u_rate;
+    double fracpart = (timestamp - intpart * u_rate - intpart * f_rate) / stored.samp_rate;
+
+    // Whole seconds only change once per second, reuse its value
+    if (tag_values.secs[channel] != intpart) {
+        tag_values.secs[channel] = intpart;
+        tag_values.secs_value[channel] = pmt::from_uint64(intpart);
+    }
+    return pmt::make_tuple(tag_values.secs_value[channel],
+                           (fracpart == 0.0) ? tag_values.zero_frac : pmt::from_double(fracpart));
+}
+
+// Add rx_time tag to stream
+void source_impl::add_time_tag(int channel, uint64_t timestamp, uint64_t offset) {
+    this->add_item_tag(
+        channel, offset, TIME_TAG, this->make_time_value(channel, timestamp), tag_values.serial);
+
+    std::lock_guard<std::mutex> lock(tag_values.mutex);
+    if (tag_values.bundle) {
+        int device_channel = (stored.channel_mode < 2) ? stored.channel_mode : channel;
+        this->add_item_tag(
+            channel, offset, FREQ_TAG, tag_values.freq[device_channel], tag_values.serial);
+        this->add_item_tag(channel, offset, RATE_TAG, tag_values.rate, tag_values.serial);
+    }
+}
 
-    const pmt::pmt_t ID = pmt::string_to_symbol(stored.serial);
-    const pmt::pmt_t t_val = pmt::make_tuple(pmt::from_uint64(intpart), pmt::from_double(fracpart));
-    this->add_item_tag(channel, nitems_written(channel), TIME_TAG, t_val, ID);
+// Build rx_freq and rx_rate values after settings change
+void source_impl::update_tag_values() {
+    std::lock_guard<std::mutex> lock(tag_values.mutex);
+    // NCO moves spectrum at (LO - NCO) to baseband center
+    for (int i = 0; i < 2; i++)
+        tag_values.freq[i] = pmt::from_double(rf_freq - nco_freq[i]);
+    tag_values.rate = pmt::from_double(stored.samp_rate);
+}
+
+// Queue rx_time, rx_freq and rx_rate tags for the first sample received after settings change.
+// Device time read right after the change returned is the timestamp of that sample.
+void source_impl::mark_retune() {
+    lms_stream_status_t status;
+    if (!streaming || PPS_mode ||
+        this->read_stream_status((stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0,
+                                 &status) != LMS_SUCCESS) {
+        add_tag = true;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(tag_values.mutex);
+    retune_event event;
+    event.timestamp = status.timestamp;
+    event.freq[0] = tag_values.freq[0];
+    event.freq[1] = tag_values.freq[1];
+    event.rate = tag_values.rate;
+    tag_values.retunes.push_back(event);
+    tag_values.pending_retunes.store(tag_values.retunes.size(), std::memory_order_release);
+}
+
+// Tag retunes falling into output buffer starting at given device timestamps
+void source_impl::tag_retunes(int channels, const uint64_t timestamp[2], int items) {
+    if (tag_values.pending_retunes.load(std::memory_order_acquire) == 0)
+        return;
+    std::lock_guard<std::mutex> lock(tag_values.mutex);
+    while (!tag_values.retunes.empty()) {
+        const retune_event& event = tag_values.retunes.front();
+        if (event.timestamp >= timestamp[0] + items)
+            break;
+        for (int i = 0; i < channels; i++) {
+            // Change that took effect before this buffer is tagged on its first sample
+            uint64_t position =
+                (event.timestamp > timestamp[i]) ? event.timestamp - timestamp[i] : 0;
+            uint64_t offset = nitems_written(i) + position;
+            int device_channel = (stored.channel_mode < 2) ? stored.channel_mode : i;
+            this->add_item_tag(i,
+                               offset,
+                               TIME_TAG,
+                               this->make_time_value(i, timestamp[i] + position),
+                               tag_values.serial);
+            this->add_item_tag(
+                i, offset, FREQ_TAG, event.freq[device_channel], tag_values.serial);
+            this->add_item_tag(i, offset, RATE_TAG, event.rate, tag_values.serial);
+        }
+        tag_values.retunes.pop_front();
+    }
+    tag_values.pending_retunes.store(tag_values.retunes.size(), std::memory_order_release);
+}
+
+// Convert device time to host time and queue command
+bool source_impl::schedule_at(double rx_time, control_worker::command cmd) {
+    lms_stream_status_t status;
+    if (!streaming ||
+        this->read_stream_status((stored.channel_mode < 2) ? stored.channel_mode : LMS_CH_0,
+                                 &status) != LMS_SUCCESS) {
+        std::cout << "ERROR: source_impl::schedule_at(): timed commands require running stream."
+                  << std::endl;
+        return false;
+    }
+    double delay = rx_time - status.timestamp / stored.samp_rate;
+    timed_commands.post_at(
+        control_worker::clock::now() +
+            std::chrono::duration_cast<control_worker::clock::duration>(
+                std::chrono::duration<double>(std::max(delay, 0.0))),
+        std::move(cmd));
+    return true;
 }
 // Return io_signature to manage module output count
-// based on SISO (one output) and MIMO (two outputs) modes
-inline gr::io_signature::sptr source_impl::args_to_io_signature(int channel_number) {
+// based on SISO (one output) and MIMO (two outputs) modes.
+// F32 streams output gr_complex, I16/I12 streams output interleaved int16 I/Q (sc16)
+inline gr::io_signature::sptr source_impl::args_to_io_signature(int channel_number,
+                                                                int data_format) {
+    size_t item_size;
+    if (data_format == LIMESDR_FMT_F32) {
+        item_size = sizeof(gr_complex);
+    } else if (data_format == LIMESDR_FMT_I16 || data_format == LIMESDR_FMT_I12) {
+        item_size = 2 * sizeof(int16_t);
+    } else {
+        std::cout << "ERROR: source_impl::args_to_io_signature(): data_format must be F32(0), "
+                     "I16(1) or I12(2)."
+                  << std::endl;
+        exit(0);
+    }
+
     if (channel_number < 2) {
-        return gr::io_signature::make(1, 1, sizeof(gr_complex));
+        return gr::io_signature::make(1, 1, item_size);
     } else if (channel_number == 2) {
-        return gr::io_signature::make(2, 2, sizeof(gr_complex));
+        return gr::io_signature::make(2, 2, item_size);
     } else {
         std::cout << "ERROR: source_impl::args_to_io_signature(): channel_number must be 0,1 or 2."
                   << std::endl;
@@ -305,11 +941,204 @@ inline gr::io_signature::sptr source_impl::args_to_io_signature(int channel_numb
 }
 
 // Add RAW PPS sample counter tag to stream
-void source_impl::add_PPS_time_tag(int channel, uint64_t PPS_samplestamp) {
-    const pmt::pmt_t ID = pmt::string_to_symbol(stored.serial);
+void source_impl::add_PPS_time_tag(int channel, uint64_t PPS_samplestamp, uint64_t offset) {
     const pmt::pmt_t t_val =
-        pmt::make_tuple(pmt::from_uint64(PPS_samplestamp), pmt::from_double(0.0));
-    this->add_item_tag(channel, nitems_written(channel), TIME_TAG, t_val, ID);
+        pmt::make_tuple(pmt::from_uint64(PPS_samplestamp), tag_values.zero_frac);
+    this->add_item_tag(channel, offset, TIME_TAG, t_val, tag_values.serial);
+}
+
+// Counter of PPS mode counts samples since the last PPS edge, so edge offset is known exactly
+// from any received sample. Counter going back is a new edge, gap keeps the edge but moves its
+// output offset by dropped samples.
+void source_impl::pps_track(int channel, uint64_t counter, uint64_t expected, uint64_t offset) {
+    pps_data::channel_model& model = pps.channel[channel];
+    bool first = model.first;
+    model.first = false;
+    if (!first && counter == expected)
+        return;
+    if (counter > 1.5 * stored.samp_rate) {
+        if (!pps.no_pps_reported)
+            std::cout << "WARNING: source_impl::pps_track(): sample counter is not reset, "
+                         "check PPS signal."
+                      << std::endl;
+        pps.no_pps_reported = true;
+        model.locked = false;
+        return;
+    }
+    pps.no_pps_reported = false;
+    bool reset = !first && counter < expected;
+    this->pps_edge(channel, (int64_t)offset - (int64_t)counter, offset, reset);
+}
+
+// Update edge model and tag absolute time of the sample at tag_offset
+void source_impl::pps_edge(int channel, int64_t edge_offset, uint64_t tag_offset, bool reset) {
+    pps_data::channel_model& model = pps.channel[channel];
+    // Edge was already tagged ahead by pps_lookahead()
+    if (model.locked && edge_offset == model.edge_offset)
+        return;
+
+    double rate = (pps.measured_rate > 0) ? pps.measured_rate : stored.samp_rate;
+    bool measured = false;
+    if (model.locked && reset) {
+        int64_t samples = edge_offset - model.edge_offset;
+        uint64_t elapsed = std::max<int64_t>(1, llround(samples / stored.samp_rate));
+        model.seconds += elapsed;
+        double edge_rate = (double)samples / elapsed;
+        // Edges with dropped samples in between are not used for rate measurement
+        if (channel == 0 && std::abs(edge_rate - stored.samp_rate) < 1e-3 * stored.samp_rate) {
+            int64_t error = edge_offset - (model.edge_offset + llround(rate * elapsed));
+            pps.window = std::min<int64_t>(4096, std::max<int64_t>(16, 4 * std::abs(error)));
+            pps.measured_rate = edge_rate;
+            pps.rate_error_ppm = (edge_rate - stored.samp_rate) / stored.samp_rate * 1e6;
+            rate = edge_rate;
+            measured = true;
+        }
+    } else if (!model.locked) {
+        if (channel > 0 && pps.channel[0].locked && pps.channel[0].edge_offset == edge_offset) {
+            model.seconds = pps.channel[0].seconds;
+        } else {
+            // Sample at tag_offset has just been received
+            double now = std::chrono::duration<double>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+            model.seconds = llround(now - stream_latency - (tag_offset - edge_offset) / rate);
+        }
+    }
+    if (channel == 0 && pps.time_set.load(std::memory_order_acquire) && (reset || !model.locked)) {
+        model.seconds = pps.next_seconds.load(std::memory_order_relaxed);
+        pps.time_set.store(false, std::memory_order_relaxed);
+    } else if (channel > 0 && pps.channel[0].edge_offset == edge_offset) {
+        model.seconds = pps.channel[0].seconds;
+    }
+    model.edge_offset = edge_offset;
+    model.locked = true;
+    if (channel == 0 && reset)
+        pps.edges++;
+
+    uint64_t since_edge = tag_offset - edge_offset;
+    uint64_t secs = model.seconds + (uint64_t)(since_edge / rate);
+    double frac = (since_edge - (secs - model.seconds) * rate) / rate;
+    this->add_item_tag(channel,
+                       tag_offset,
+                       TIME_TAG,
+                       pmt::make_tuple(pmt::from_uint64(secs), pmt::from_double(frac)),
+                       tag_values.serial);
+    this->add_item_tag(
+        channel,
+        tag_offset,
+        PPS_TAG,
+        pmt::make_tuple(pmt::from_uint64(model.seconds), pmt::from_uint64(since_edge)),
+        tag_values.serial);
+    if (measured)
+        this->add_item_tag(channel,
+                           tag_offset,
+                           RATE_ERROR_TAG,
+                           pmt::from_double(pps.rate_error_ppm),
+                           tag_values.serial);
+}
+
+// Receive ends where window around the predicted edge starts, window is read in packets
+int source_impl::pps_read_size(int noutput_items, bool& in_window) {
+    in_window = false;
+    const pps_data::channel_model& model = pps.channel[0];
+    if (!model.locked)
+        return noutput_items;
+    double rate = (pps.measured_rate > 0) ? pps.measured_rate : stored.samp_rate;
+    int64_t predicted = model.edge_offset + llround(rate);
+    int64_t remaining = predicted - pps.window - (int64_t)nitems_written(0);
+    if (remaining > 0)
+        return std::min<int64_t>(noutput_items, remaining);
+    // Edge is missing after the window, wait for the next counter reset
+    in_window = remaining >= -2 * pps.window;
+    return noutput_items;
+}
+
+// Counter of each receive gives position of edge in samples received before it in the same
+// call, so window is received in packet sized reads and the edge is tagged on the exact
+// sample. The last read of one sample gives an edge at the end of the buffer away.
+int source_impl::recv_pps(void* buffers[2], int items, lms_stream_meta_t rx_metadata[2]) {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    bool in_window;
+    int size = this->pps_read_size(items, in_window);
+    int packet = this->packet_samples();
+    for (int i = 0; i < channels; i++)
+        rx_metadata[i].timestamp = next_rx_timestamp[i];
+
+    int total = 0;
+    while (total < size) {
+        int wanted = size - total;
+        bool last = !in_window;
+        if (in_window) {
+            last = wanted <= packet;
+            wanted = last ? 1 : packet;
+        }
+        void* dst[2];
+        for (int i = 0; i < channels; i++)
+            dst[i] = static_cast<char*>(buffers[i]) + total * stored.item_size;
+        lms_stream_meta_t meta[2];
+        int ret = (channels == 1)
+                      ? backend->recv(&streamId[stored.channel_mode], dst[0], wanted, &meta[0], 100)
+                      : this->recv_mimo(dst, wanted, meta);
+        if (ret <= 0)
+            break;
+        for (int i = 0; i < channels; i++) {
+            if (total == 0)
+                rx_metadata[i].timestamp = meta[i].timestamp;
+            uint64_t expected = next_rx_timestamp[i];
+            next_rx_timestamp[i] = meta[i].timestamp + ret;
+            this->pps_track(i, meta[i].timestamp, expected, nitems_written(i) + total);
+        }
+        total += ret;
+        if (last || ret < wanted)
+            break;
+    }
+    return total;
+}
+
+// Reader thread is ahead of the consumer, so counter reset markers in ring give edges that
+// are still ahead and can be tagged on the exact sample
+void source_impl::pps_lookahead(int channel, uint64_t first_index, size_t items) {
+    size_t count;
+    const timestamp_marker* marker =
+        static_cast<const timestamp_marker*>(rx_thread.markers[channel]->read_ptr(count));
+    uint64_t index = first_index;
+    uint64_t counter = rx_thread.ring_timestamp[channel];
+    // Markers later than one second after the window can't hold edge of this window
+    uint64_t last_index = first_index + items + (uint64_t)stored.samp_rate;
+    for (size_t k = 0; k < count && marker[k].index < last_index; k++) {
+        bool reset = marker[k].timestamp < counter + (marker[k].index - index);
+        uint64_t edge_index = marker[k].index - marker[k].timestamp;
+        if (reset && marker[k].timestamp <= marker[k].index && edge_index >= first_index &&
+            edge_index < first_index + items && pps.channel[channel].locked)
+            this->pps_edge(channel,
+                           nitems_written(channel) + (edge_index - first_index),
+                           nitems_written(channel) + (edge_index - first_index),
+                           true);
+        index = marker[k].index;
+        counter = marker[k].timestamp;
+    }
+}
+
+void source_impl::set_pps_disciplined(bool enable) {
+    if (streaming) {
+        std::cout << "ERROR: source_impl::set_pps_disciplined(): PPS disciplined timing must be "
+                     "set before the flowgraph is started."
+                  << std::endl;
+        return;
+    }
+    pps.disciplined = enable;
+    if (enable && !PPS_mode) {
+        PPS_mode = true;
+        sync.PPS_requested = true;
+        device_handler::getInstance().set_PPS_mode(stored.device_number, true);
+    }
+    std::cout << "INFO: source_impl::set_pps_disciplined(): PPS disciplined timing "
+              << (enable ? "enabled" : "disabled") << std::endl;
+}
+
+void source_impl::set_pps_time(uint64_t seconds) {
+    pps.next_seconds.store(seconds, std::memory_order_relaxed);
+    pps.time_set.store(true, std::memory_order_release);
 }
 
 bool source_impl::set_ext_clk(double fref_Mhz) {
@@ -321,30 +1150,61 @@ bool source_impl::disable_ext_clk() {
 }
 
 double source_impl::set_center_freq(double freq, size_t chan) {
-    add_tag = true;
-    return device_handler::getInstance().set_rf_freq(
+    double previous = rf_freq;
+    rf_freq = device_handler::getInstance().set_rf_freq(
         stored.device_number, LMS_CH_RX, LMS_CH_0, freq);
+    // DC and imbalance depend on LO
+    if (rf_freq != previous)
+        for (auto& corrector : iq_correction.corrector)
+            corrector.reset();
+    // Channel NCOs follow LO, so channels stay at the same RF frequency
+    for (int i = 0; i < 2; i++)
+        if (channelizer.active[i])
+            this->apply_channelizer(i);
+    this->update_tag_values();
+    this->mark_retune();
+    return rf_freq;
+}
+
+bool source_impl::set_center_freq_at(double freq, double rx_time) {
+    // Checked now, failing retune on control thread would close all devices
+    if (!device_handler::getInstance().check_rf_freq(stored.device_number, LMS_CH_RX, freq)) {
+        std::cout << "ERROR: source_impl::set_center_freq_at(): " << freq / 1e6
+                  << " MHz is out of LO range." << std::endl;
+        return false;
+    }
+    return this->schedule_at(rx_time, [this, freq]() { this->set_center_freq(freq, 0); });
 }
 
 void source_impl::set_nco(float nco_freq, int channel) {
     device_handler::getInstance().set_nco(stored.device_number, LMS_CH_RX, channel, nco_freq);
-    add_tag = true;
+    this->nco_freq[channel] = nco_freq;
+    this->update_tag_values();
+    this->mark_retune();
 }
 
+bool source_impl::set_nco_at(float nco_freq, int channel, double rx_time) {
+    return this->schedule_at(rx_time,
+                             [this, nco_freq, channel]() { this->set_nco(nco_freq, channel); });
+}
+
+void source_impl::clear_timed_commands() { timed_commands.clear(); }
+
 void source_impl::set_antenna(int antenna, int channel) {
     device_handler::getInstance().set_antenna(stored.device_number, channel, LMS_CH_RX, antenna);
 }
 
 double source_impl::set_bandwidth(double analog_bandw, int channel) {
-    add_tag = true;
-    return device_handler::getInstance().set_analog_filter(
+    double bandwidth = device_handler::getInstance().set_analog_filter(
         stored.device_number, LMS_CH_RX, channel, analog_bandw);
+    this->mark_retune();
+    return bandwidth;
 }
 
 void source_impl::set_digital_filter(double digital_bandw, int channel) {
     device_handler::getInstance().set_digital_filter(
         stored.device_number, LMS_CH_RX, channel, digital_bandw);
-    add_tag = true;
+    this->mark_retune();
 }
 
 unsigned source_impl::set_gain(unsigned gain_dB, int channel) {
@@ -354,23 +1214,608 @@ unsigned source_impl::set_gain(unsigned gain_dB, int channel) {
 
 void source_impl::calibrate(double bandw, int channel) {
     device_handler::getInstance().calibrate(stored.device_number, LMS_CH_RX, channel, bandw);
+    // Host correction starts again from what calibration left
+    if (channel == 0 || channel == 1)
+        iq_correction.corrector[channel].reset();
+}
+
+void source_impl::set_calibration_cache(bool enable) {
+    device_handler::getInstance().set_calibration_cache(stored.device_number, enable);
+}
+
+void source_impl::set_iq_correction(bool enable, float tracking_step) {
+    if (enable && stored.data_format != LIMESDR_FMT_F32) {
+        std::cout << "ERROR: source_impl::set_iq_correction(): host side IQ correction requires "
+                     "complex float output."
+                  << std::endl;
+        return;
+    }
+    iq_correction.tracking_step = tracking_step;
+    this->update_iq_tracking();
+    if (enable && !iq_correction.enabled)
+        for (auto& corrector : iq_correction.corrector)
+            corrector.reset();
+    iq_correction.enabled = enable;
+    std::cout << "INFO: source_impl::set_iq_correction(): host side DC/IQ correction "
+              << (enable ? "enabled" : "disabled") << std::endl;
+}
+
+// Estimates are tracked 100 times per second of samples
+void source_impl::update_iq_tracking() {
+    for (auto& corrector : iq_correction.corrector)
+        corrector.set_tracking(iq_correction.tracking_step, (size_t)(stored.samp_rate / 100));
+}
+
+std::vector<gr_complex> source_impl::get_iq_correction(int channel) {
+    if (channel < 0 || channel > 1)
+        return std::vector<gr_complex>();
+    return {iq_correction.corrector[channel].get_dc(), iq_correction.corrector[channel].get_iq()};
+}
+
+// Correct output buffer in place, so no extra full rate pass of a separate block is needed
+void source_impl::correct_iq(int output, void* samples, int items) {
+    if (!iq_correction.enabled.load(std::memory_order_relaxed) || items <= 0)
+        return;
+    int device_channel = (stored.channel_mode < 2) ? stored.channel_mode : output;
+    iq_correction.corrector[device_channel].process(static_cast<gr_complex*>(samples), items);
+}
+
+bool source_impl::save_snapshot(const std::string& filename) {
+    return device_handler::getInstance().save_snapshot(stored.device_number, filename);
 }
 
 double source_impl::set_sample_rate(double rate) {
+    if (channelizer.enabled) {
+        // New monitored band, hardware decimation is kept
+        channelizer.wide_rate = rate;
+        this->apply_channelizer_rate();
+        for (int i = 0; i < 2; i++)
+            if (channelizer.active[i])
+                this->apply_channelizer(i);
+        this->update_tag_values();
+        this->mark_retune();
+        return stored.samp_rate;
+    }
     device_handler::getInstance().set_samp_rate(stored.device_number, rate);
     stored.samp_rate = rate;
+    this->update_iq_tracking();
+    this->update_tag_values();
+    this->mark_retune();
     return rate;
 }
 
 void source_impl::set_buffer_size(uint32_t size) { stored.FIFO_size = size; }
 
 void source_impl::set_oversampling(int oversample) {
+    // Channelizer output rate is set by its decimation
+    if (channelizer.enabled) {
+        std::cout << "ERROR: source_impl::set_oversampling(): channelizer decimates by "
+                  << channelizer.decimation << ", oversampling is set by set_channelizer()."
+                  << std::endl;
+        return;
+    }
     device_handler::getInstance().set_oversampling(stored.device_number, oversample);
 }
 
+// NCO frequency moving channel to baseband (LO - NCO convention of rx_freq tag),
+// NAN if channel doesn't fit into monitored band
+double source_impl::channelizer_offset(double channel_freq, double bandwidth, double wide_rate) {
+    double offset = rf_freq - channel_freq;
+    if (std::abs(offset) + bandwidth / 2 > wide_rate / 2)
+        return NAN;
+    return offset;
+}
+
+// Output rate is reached by decimating monitored band in LMS7002M
+void source_impl::apply_channelizer_rate() {
+    double rate = channelizer.wide_rate / channelizer.decimation;
+    device_handler::getInstance().set_samp_rate(stored.device_number, rate);
+    device_handler::getInstance().set_oversampling(stored.device_number, channelizer.decimation);
+    stored.samp_rate = rate;
+    this->update_iq_tracking();
+}
+
+void source_impl::apply_channelizer(int channel) {
+    double offset = this->channelizer_offset(
+        channelizer.freq[channel], channelizer.bandwidth[channel], channelizer.wide_rate);
+    if (std::isnan(offset)) {
+        std::cout << "ERROR: source_impl::apply_channelizer(): channel " << channel << " at "
+                  << channelizer.freq[channel] / 1e6 << " MHz is outside of monitored band, "
+                  << "channelizer settings are kept." << std::endl;
+        return;
+    }
+    // NCO and GFIR coefficients depend on sample rate, they are written after rate change
+    device_handler::getInstance().set_nco(stored.device_number, LMS_CH_RX, channel, offset);
+    nco_freq[channel] = offset;
+    device_handler::getInstance().set_digital_filter(
+        stored.device_number, LMS_CH_RX, channel, channelizer.bandwidth[channel]);
+}
+
+double source_impl::set_channelizer(double channel_freq,
+                                    double bandwidth,
+                                    int decimation,
+                                    int channel) {
+    if (channel < 0 || channel > 1) {
+        std::cout << "ERROR: source_impl::set_channelizer(): channel must be 0 or 1." << std::endl;
+        return stored.samp_rate;
+    }
+    if (decimation <= 0) {
+        if (!channelizer.active[channel])
+            return stored.samp_rate;
+        channelizer.active[channel] = false;
+        device_handler::getInstance().set_nco(stored.device_number, LMS_CH_RX, channel, 0);
+        nco_freq[channel] = 0;
+        device_handler::getInstance().set_digital_filter(
+            stored.device_number, LMS_CH_RX, channel, 0);
+        if (!channelizer.active[0] && !channelizer.active[1]) {
+            channelizer.enabled = false;
+            double rate = channelizer.wide_rate;
+            device_handler::getInstance().set_samp_rate(stored.device_number, rate);
+            device_handler::getInstance().set_oversampling(stored.device_number, 0);
+            stored.samp_rate = rate;
+            this->update_iq_tracking();
+        }
+        std::cout << "INFO: source_impl::set_channelizer(): channelizer of channel " << channel
+                  << " turned off." << std::endl;
+        this->update_tag_values();
+        this->mark_retune();
+        return stored.samp_rate;
+    }
+    if (decimation != 1 && decimation != 2 && decimation != 4 && decimation != 8 &&
+        decimation != 16 && decimation != 32) {
+        std::cout << "ERROR: source_impl::set_channelizer(): valid decimation values are: "
+                     "1,2,4,8,16,32."
+                  << std::endl;
+        return stored.samp_rate;
+    }
+
+    // Sample rate before first channel was configured is the monitored band
+    double wide_rate = channelizer.enabled ? channelizer.wide_rate : stored.samp_rate;
+    if (std::isnan(this->channelizer_offset(channel_freq, bandwidth, wide_rate))) {
+        std::cout << "ERROR: source_impl::set_channelizer(): channel at " << channel_freq / 1e6
+                  << " MHz with " << bandwidth / 1e6 << " MHz bandwidth doesn't fit into "
+                  << wide_rate / 1e6 << " MHz monitored around LO " << rf_freq / 1e6 << " MHz."
+                  << std::endl;
+        return stored.samp_rate;
+    }
+    if (bandwidth > wide_rate / decimation) {
+        bandwidth = wide_rate / decimation;
+        std::cout << "INFO: source_impl::set_channelizer(): bandwidth limited to output sample "
+                     "rate "
+                  << bandwidth / 1e6 << " MHz." << std::endl;
+    }
+
+    bool rate_change = !channelizer.enabled || channelizer.decimation != decimation;
+    channelizer.enabled = true;
+    channelizer.wide_rate = wide_rate;
+    channelizer.decimation = decimation;
+    channelizer.active[channel] = true;
+    channelizer.freq[channel] = channel_freq;
+    channelizer.bandwidth[channel] = bandwidth;
+    if (rate_change)
+        this->apply_channelizer_rate();
+    // Rate change affects both channels
+    for (int i = 0; i < 2; i++)
+        if (channelizer.active[i] && (rate_change || i == channel))
+            this->apply_channelizer(i);
+
+    std::cout << "INFO: source_impl::set_channelizer(): channel " << channel << " at "
+              << channel_freq / 1e6 << " MHz, " << stored.samp_rate / 1e6
+              << " MS/s output (decimation " << decimation << ")." << std::endl;
+    this->update_tag_values();
+    this->mark_retune();
+    return stored.samp_rate;
+}
+
+int source_impl::set_hop_table(const std::vector<double>& freqs) {
+    return device_handler::getInstance().set_hop_table(stored.device_number, LMS_CH_RX, freqs);
+}
+
+double source_impl::hop(int index) {
+    double duration;
+    double freq =
+        device_handler::getInstance().hop(stored.device_number, LMS_CH_RX, index, duration);
+    if (freq == 0)
+        return 0;
+    rf_freq = freq;
+    this->update_tag_values();
+    this->mark_retune();
+    hop_stats.last_duration = duration;
+    hop_stats.count++;
+    return freq;
+}
+
+void source_impl::hop_at(int index, double rx_time) {
+    this->schedule_at(rx_time, [this, index]() { this->hop(index); });
+}
+
+// Hop message is entry index or dictionary with "hop" key
+void source_impl::hop_message(pmt::pmt_t msg) {
+    if (pmt::is_dict(msg))
+        msg = pmt::dict_ref(msg, HOP_PORT, pmt::PMT_NIL);
+    if (!pmt::is_integer(msg)) {
+        std::cout << "ERROR: source_impl::hop_message(): hop message must be entry index."
+                  << std::endl;
+        return;
+    }
+    this->hop(pmt::to_long(msg));
+}
+
+void source_impl::command_message(pmt::pmt_t msg) {
+    control_command cmd;
+    std::string error;
+    cmd.parse(msg, error);
+    // Only tuning can be timed, gain and filter changes are applied immediately
+    if (error.empty() && !std::isnan(cmd.time) && (!std::isnan(cmd.gain) || !std::isnan(cmd.bw)))
+        error = "only freq and nco can be timed";
+    if (!error.empty()) {
+        std::cout << "ERROR: source_impl::command_message(): " << error << "." << std::endl;
+        message_port_pub(COMMAND_REPLY_PORT, cmd.reply(error));
+        return;
+    }
+    std::shared_ptr<command_guard> guard = commands;
+    device_handler::getInstance().post_command(stored.device_number, [this, guard, cmd]() {
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        if (guard->alive)
+            this->apply_command(cmd);
+    });
+}
+
+// Runs on device control worker thread
+void source_impl::apply_command(const control_command& cmd) {
+    // Setters close all devices on failure, so device limits are checked first
+    if (!std::isnan(cmd.freq) &&
+        !device_handler::getInstance().check_rf_freq(stored.device_number, LMS_CH_RX, cmd.freq)) {
+        message_port_pub(COMMAND_REPLY_PORT, cmd.reply("freq is out of LO range"));
+        return;
+    }
+    if (!std::isnan(cmd.time)) {
+        bool scheduled = true;
+        if (!std::isnan(cmd.freq))
+            scheduled = this->set_center_freq_at(cmd.freq, cmd.time);
+        if (scheduled && !std::isnan(cmd.nco))
+            scheduled = this->set_nco_at(cmd.nco, cmd.channel, cmd.time);
+        message_port_pub(COMMAND_REPLY_PORT,
+                         cmd.reply(scheduled ? "" : "timed commands require running stream"));
+        return;
+    }
+    if (!std::isnan(cmd.freq))
+        this->set_center_freq(cmd.freq, cmd.channel);
+    if (!std::isnan(cmd.bw))
+        this->set_bandwidth(cmd.bw, cmd.channel);
+    if (!std::isnan(cmd.gain))
+        this->set_gain((unsigned)cmd.gain, cmd.channel);
+    if (!std::isnan(cmd.nco))
+        this->set_nco(cmd.nco, cmd.channel);
+    message_port_pub(COMMAND_REPLY_PORT, cmd.reply(""));
+}
+
+int preopen_devices(const std::vector<std::string>& serials) {
+    return device_handler::getInstance().preopen(serials);
+}
+
+void quiesce_devices() { device_handler::getInstance().quiesce(); }
+
 void source_impl::set_tcxo_dac(uint16_t dacVal) {
     device_handler::getInstance().set_tcxo_dac(stored.device_number, dacVal);
 }
 
+void source_impl::set_sync_start(bool enable, double fref_MHz) {
+    if (streaming) {
+        std::cout << "ERROR: source_impl::set_sync_start(): synchronized start must be set "
+                     "before the flowgraph is started."
+                  << std::endl;
+        return;
+    }
+    sync.fref_MHz = fref_MHz;
+    if (enable == sync.enabled)
+        return;
+    sync.enabled = enable;
+    if (enable) {
+        device_handler::getInstance().sync_join();
+        // Devices are aligned to PPS edges, tag PPS sample counter
+        PPS_mode = true;
+    } else {
+        device_handler::getInstance().sync_leave();
+        PPS_mode = sync.PPS_requested;
+        device_handler::getInstance().set_PPS_mode(stored.device_number, PPS_mode);
+    }
+}
+
+std::vector<double> source_impl::get_sync_offsets() {
+    return device_handler::getInstance().get_sync_offsets();
+}
+
+void source_impl::set_tag_bundle(bool enable) {
+    std::lock_guard<std::mutex> lock(tag_values.mutex);
+    tag_values.bundle = enable;
+}
+
+void source_impl::set_latency_profile(int profile) {
+    if (profile < LIMESDR_LATENCY_LOW || profile > LIMESDR_LATENCY_THROUGHPUT) {
+        std::cout << "ERROR: source_impl::set_latency_profile(): profile must be Low latency(0), "
+                     "Balanced(1) or Max throughput(2)."
+                  << std::endl;
+        return;
+    }
+    stored.latency_profile = profile;
+    // Output buffers are allocated before start(), realign them for the next start
+    this->update_stream_settings();
+    this->rebuild_stream();
+}
+
+void source_impl::set_throughput_vs_latency(double value) {
+    stored.throughput_vs_latency_override = (value > 1.0) ? 1.0 : value;
+    this->update_stream_settings();
+    this->rebuild_stream();
+}
+
+void source_impl::set_rx_thread(bool enable, uint32_t ring_size, int cpu) {
+    rx_thread.enabled = enable;
+    rx_thread.ring_size = ring_size;
+    rx_thread.cpu = cpu;
+}
+
+uint32_t source_impl::get_ring_size() {
+    if (rx_thread.ring_size != 0)
+        return rx_thread.ring_size;
+    return std::max<uint32_t>((uint32_t)stored.samp_rate / 4, 65536);
+}
+
+// Size of one sample moved by LimeSuite, recording uses int16 also for float output blocks
+size_t source_impl::stream_item_size() {
+    return recording.active ? 2 * sizeof(int16_t) : stored.item_size;
+}
+
+// Escape string for the capture sidecar
+static std::string json_string(const std::string& value) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if ((unsigned char)c < 0x20)
+            out << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xf] << "0123456789abcdef"[c & 0xf];
+        else
+            out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+bool source_impl::open_recording() {
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    for (int i = 0; i < channels; i++) {
+        std::string name = recording.filename;
+        if (channels == 2) {
+            // capture.sc16 -> capture_ch0.sc16
+            size_t dot = name.find_last_of('.');
+            size_t slash = name.find_last_of("/\\");
+            if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+                dot = name.size();
+            name.insert(dot, "_ch" + std::to_string(i));
+        }
+        recording.file_names[i] = name;
+        if (!recording.file[i].open(name, 2 * sizeof(int16_t))) {
+            for (int j = 0; j < i; j++)
+                recording.file[j].close();
+            std::cout << "ERROR: source_impl::open_recording(): recording disabled, samples are "
+                         "sent to output ports."
+                      << std::endl;
+            return false;
+        }
+        recording.start_timestamp[i] = 0;
+        recording.next_timestamp[i] = 0;
+    }
+    recording.events.clear();
+    recording.events_truncated = false;
+    recording.start_time = std::time(nullptr);
+    recording.sample_rate = device_handler::getInstance().get_samp_rate(stored.device_number);
+    if (recording.sample_rate <= 0)
+        recording.sample_rate = stored.samp_rate;
+
+    std::cout << "INFO: source_impl::open_recording(): recording to " << recording.file_names[0];
+    if (channels == 2)
+        std::cout << " and " << recording.file_names[1];
+    std::cout << (recording.file[0].direct() ? " with O_DIRECT" : " without O_DIRECT") << "."
+              << std::endl;
+    return true;
+}
+
+void source_impl::close_recording() {
+    if (recording.thread.joinable()) {
+        recording.running = false;
+        recording.thread.join();
+    }
+    // Stream rebuilt on running flowgraph continues in the same files
+    if (!recording.file[0].is_open() || sync.restarting)
+        return;
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    for (int i = 0; i < channels; i++)
+        recording.file[i].close();
+    this->write_recording_sidecar();
+    recording.active = false;
+
+    std::cout << "INFO: source_impl::close_recording(): recorded " << recording.file[0].samples()
+              << " samples per channel, " << recording.file[0].dropped_samples()
+              << " discarded by disk, " << recording.events.size() << " stream events."
+              << std::endl;
+}
+
+void source_impl::add_recording_event(const recording_event& event) {
+    // Bound sidecar size if device keeps dropping for hours
+    if (recording.events.size() >= 100000) {
+        recording.events_truncated = true;
+        return;
+    }
+    recording.events.push_back(event);
+}
+
+// Receive samples straight into disk buffers of capture files
+void source_impl::recording_loop() {
+    if (gr::enable_realtime_scheduling() != gr::RT_OK)
+        std::cout << "WARNING: source_impl::recording_loop(): unable to enable realtime "
+                     "scheduling for recording thread."
+                  << std::endl;
+
+    const size_t chunk = packet_samples() * packets_to_batch();
+    const size_t item_size = this->stream_item_size();
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    std::vector<char> scratch[2];
+    for (int i = 0; i < channels; i++)
+        scratch[i].resize(chunk * item_size);
+    bool overflow[2] = {false, false};
+    // Index of the disk overflow event extended while disk stays behind
+    size_t overflow_event[2] = {0};
+    auto poll_t = std::chrono::high_resolution_clock::now();
+    stream_telemetry::counters seen[2];
+    for (int i = 0; i < channels; i++)
+        seen[i] = telemetry.total((stored.channel_mode < 2) ? stored.channel_mode : i);
+
+    while (recording.running) {
+        // Disk buffers of all channels must have space, otherwise samples are discarded
+        void* buffers[2];
+        size_t items = chunk;
+        bool full = false;
+        for (int i = 0; i < channels; i++) {
+            size_t space;
+            buffers[i] = recording.file[i].write_ptr(space);
+            if (buffers[i] == nullptr)
+                full = true;
+            items = std::min(items, space);
+        }
+        if (full) {
+            for (int i = 0; i < channels; i++)
+                buffers[i] = scratch[i].data();
+            items = chunk;
+        }
+
+        lms_stream_meta_t rx_metadata[2];
+        int ret = (channels == 2) ? this->recv_mimo(buffers, items, rx_metadata)
+                                  : backend->recv(&streamId[stored.channel_mode],
+                                                  buffers[0],
+                                                  items,
+                                                  &rx_metadata[0],
+                                                  100);
+        if (ret <= 0)
+            continue;
+
+        for (int i = 0; i < channels; i++) {
+            disk_recorder& file = recording.file[i];
+            uint64_t& next_timestamp = recording.next_timestamp[i];
+            if (file.samples() == 0 && file.dropped_samples() == 0) {
+                recording.start_timestamp[i] = rx_metadata[i].timestamp;
+            } else if (rx_metadata[i].timestamp > next_timestamp) {
+                this->add_recording_event({"gap",
+                                           i,
+                                           file.samples(),
+                                           rx_metadata[i].timestamp,
+                                           rx_metadata[i].timestamp - next_timestamp,
+                                           0,
+                                           0});
+            } else if (rx_metadata[i].timestamp < next_timestamp) {
+                this->add_recording_event({"discontinuity",
+                                           i,
+                                           file.samples(),
+                                           rx_metadata[i].timestamp,
+                                           next_timestamp - rx_metadata[i].timestamp,
+                                           0,
+                                           0});
+            }
+            next_timestamp = rx_metadata[i].timestamp + ret;
+
+            if (full) {
+                if (!overflow[i]) {
+                    overflow_event[i] = recording.events.size();
+                    this->add_recording_event(
+                        {"disk_overflow", i, file.samples(), rx_metadata[i].timestamp, 0, 0, 0});
+                }
+                if (overflow_event[i] < recording.events.size())
+                    recording.events[overflow_event[i]].missing += ret;
+                file.drop(ret);
+            } else {
+                file.commit(ret);
+            }
+            overflow[i] = full;
+        }
+
+        // LimeSuite reports packets dropped on USB/PCIe link only in stream status
+        auto now = std::chrono::high_resolution_clock::now();
+        if (now - poll_t < std::chrono::seconds(1))
+            continue;
+        poll_t = now;
+        for (int i = 0; i < channels; i++) {
+            int channel = (stored.channel_mode < 2) ? stored.channel_mode : i;
+            lms_stream_status_t status;
+            if (this->read_stream_status(channel, &status) != LMS_SUCCESS)
+                continue;
+            // Other readers reset LimeSuite counters too, so differences of totals are used
+            stream_telemetry::counters total = telemetry.total(channel);
+            uint64_t dropped = total.dropped_packets - seen[i].dropped_packets;
+            uint64_t overrun = total.overrun - seen[i].overrun;
+            seen[i] = total;
+            if (dropped > 0 || overrun > 0)
+                this->add_recording_event({"stream_status",
+                                           i,
+                                           recording.file[i].samples(),
+                                           status.timestamp,
+                                           0,
+                                           dropped,
+                                           overrun});
+        }
+    }
+}
+
+void source_impl::write_recording_sidecar() {
+    std::string name = recording.filename + ".json";
+    std::ofstream out(name, std::ios::trunc);
+    if (!out) {
+        std::cout << "ERROR: source_impl::write_recording_sidecar(): unable to create " << name
+                  << "." << std::endl;
+        return;
+    }
+    int channels = (stored.channel_mode < 2) ? 1 : 2;
+    out.precision(15);
+    out << "{\n  \"serial\": " << json_string(stored.serial) << ",\n";
+    // Interleaved I/Q int16 in host byte order, 12-bit link samples are not rescaled
+    out << "  \"format\": \"sc16\",\n  \"link_format\": \""
+        << ((stored.data_format == LIMESDR_FMT_I12) ? "I12" : "I16") << "\",\n";
+    out << "  \"sample_rate\": " << recording.sample_rate << ",\n";
+    if (channelizer.enabled)
+        out << "  \"monitored_rate\": " << channelizer.wide_rate
+            << ",\n  \"decimation\": " << channelizer.decimation << ",\n";
+    out << "  \"center_freq\": " << rf_freq << ",\n";
+    out << "  \"start_time\": " << recording.start_time << ",\n";
+    out << "  \"direct_io\": " << (recording.file[0].direct() ? "true" : "false") << ",\n";
+    out << "  \"channels\": [";
+    for (int i = 0; i < channels; i++) {
+        int channel = (stored.channel_mode < 2) ? stored.channel_mode : i;
+        const disk_recorder& file = recording.file[i];
+        out << (i ? "," : "") << "\n    {\"channel\": " << channel
+            << ", \"file\": " << json_string(recording.file_names[i])
+            << ", \"nco_freq\": " << nco_freq[channel] << ", \"samples\": " << file.samples()
+            << ", \"start_timestamp\": " << recording.start_timestamp[i]
+            << ", \"dropped_samples\": " << file.dropped_samples()
+            << ", \"write_failed\": " << (file.write_failed() ? "true" : "false") << "}";
+    }
+    out << "\n  ],\n  \"events\": [";
+    for (size_t i = 0; i < recording.events.size(); i++) {
+        const recording_event& event = recording.events[i];
+        int channel = (stored.channel_mode < 2) ? stored.channel_mode : event.channel;
+        out << (i ? "," : "") << "\n    {\"type\": \"" << event.type
+            << "\", \"channel\": " << channel << ", \"sample\": " << event.sample
+            << ", \"timestamp\": " << event.timestamp;
+        if (event.missing > 0)
+            out << (std::strcmp(event.type, "discontinuity") ? ", \"missing\": " : ", \"back\": ")
+                << event.missing;
+        if (event.dropped_packets > 0 || event.overrun > 0)
+            out << ", \"dropped_packets\": " << event.dropped_packets
+                << ", \"overrun\": " << event.overrun;
+        out << "}";
+    }
+    out << "\n  ],\n  \"events_truncated\": " << (recording.events_truncated ? "true" : "false")
+        << "\n}\n";
+}
+
 } // namespace limesdr
 } // namespace gr
@@ -21,50 +21,310 @@
 #ifndef INCLUDED_LIMESDR_SOURCE_IMPL_H
 #define INCLUDED_LIMESDR_SOURCE_IMPL_H
 
+#include "common/control_worker.h"
 #include "common/device_handler.h"
+#include "common/control_command.h"
+#include "common/stream_telemetry.h"
+#include "common/ring_buffer.h"
+#include "common/iq_corrector.h"
+#include "common/disk_recorder.h"
+#include <atomic>
+#include <ctime>
+#include <deque>
 #include <limesdr/source.h>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 
 static const pmt::pmt_t TIME_TAG = pmt::string_to_symbol("rx_time");
+static const pmt::pmt_t FREQ_TAG = pmt::string_to_symbol("rx_freq");
+static const pmt::pmt_t RATE_TAG = pmt::string_to_symbol("rx_rate");
+static const pmt::pmt_t PPS_TAG = pmt::string_to_symbol("rx_pps");
+static const pmt::pmt_t RATE_ERROR_TAG = pmt::string_to_symbol("rx_rate_error");
+static const pmt::pmt_t HOP_PORT = pmt::string_to_symbol("hop");
 
 namespace gr {
 namespace limesdr {
 class source_impl : public source {
     private:
     lms_stream_t streamId[2];
+    // Stream interface of the device, LimeSuite or mock
+    stream_backend* backend = nullptr;
 
     bool stream_analyzer = false;
     bool PPS_mode;
+    // Synchronized multi-device start
+    struct sync_data {
+        bool enabled = false;
+        // Set while stream is rebuilt on running flowgraph
+        bool restarting = false;
+        // External reference applied when streams are armed
+        double fref_MHz = 0;
+        // PPS mode requested in make(), restored when synchronized start is disabled
+        bool PPS_requested = false;
+    } sync;
     int fpga_delay_samples;
     uint64_t last_pps_sample_counter_ch0;
     uint64_t last_pps_sample_counter_ch1;
 
+    // PPS disciplined timing, model of the last PPS edge of each channel
+    struct pps_data {
+        bool disciplined = false;
+        // Seconds of the next edge set by set_pps_time(), used once
+        std::atomic<bool> time_set{false};
+        std::atomic<uint64_t> next_seconds{0};
+        // Samples between the last two edges of channel 0
+        double measured_rate = 0;
+        double rate_error_ppm = 0;
+        uint64_t edges = 0;
+        // Samples around predicted edge received in packets, follows prediction error
+        int64_t window = 64;
+        bool no_pps_reported = false;
+        struct channel_model {
+            bool first = true;
+            bool locked = false;
+            uint64_t seconds = 0;
+            // Output offset of the last edge, negative if it was before stream start
+            int64_t edge_offset = 0;
+        } channel[2];
+    } pps;
+
     int source_block = 1;
 
     bool add_tag = false;
-    uint32_t pktLoss = 0;
+    // Dropped packets total at last stats print
+    uint64_t pktLoss = 0;
 
     struct constant_data {
         std::string serial;
         int device_number;
         int channel_mode;
+        int data_format;
+        size_t item_size;
         double samp_rate = 10e6;
         uint32_t FIFO_size = 0;
+        int latency_profile = LIMESDR_LATENCY_BALANCED;
+        double throughput_vs_latency_override = -1;
+        double throughput_vs_latency = 0.5;
+        uint32_t stream_FIFO_size = 0;
     } stored;
 
+    // Settings change and device timestamp of the first sample received after it
+    struct retune_event {
+        uint64_t timestamp;
+        pmt::pmt_t freq[2];
+        pmt::pmt_t rate;
+    };
+
+    // Tag values are built when settings change, so the receive path only reuses them
+    struct tag_cache {
+        pmt::pmt_t serial;
+        pmt::pmt_t zero_frac;
+        pmt::pmt_t freq[2];
+        pmt::pmt_t rate;
+        // Emit rx_freq and rx_rate together with every rx_time tag
+        bool bundle = false;
+        // Whole seconds part of the last rx_time tag per channel
+        uint64_t secs[2] = {UINT64_MAX, UINT64_MAX};
+        pmt::pmt_t secs_value[2];
+        std::deque<retune_event> retunes;
+        std::atomic<size_t> pending_retunes{0};
+        // Settings are changed from other threads than general_work
+        std::mutex mutex;
+    } tag_values;
+
+    // Executes retunes scheduled at device time
+    control_worker timed_commands;
+
+    double rf_freq = 0;
+    float nco_freq[2] = {0};
+
+    // Set once streams are started, which is later than start() for synchronized start
+    std::atomic<bool> streaming{false};
+    double stream_latency = 0;
+    // Last stream status poll
+    std::chrono::high_resolution_clock::time_point status_t;
+    // Time of start() to report when the first samples arrive
+    std::chrono::high_resolution_clock::time_point start_t;
+    bool first_samples_pending = false;
+    // Device timestamp expected for the next received sample
+    uint64_t next_rx_timestamp[2] = {0};
+
+    // Marks ring position where device timestamp is not continuous
+    struct timestamp_marker {
+        uint64_t index;
+        uint64_t timestamp;
+    };
+
+    struct rx_thread_data {
+        bool enabled = false;
+        bool active = false;
+        uint32_t ring_size = 0;
+        int cpu = -1;
+        std::atomic<bool> running{false};
+        std::thread thread;
+        std::unique_ptr<ring_buffer> ring[2];
+        std::unique_ptr<ring_buffer> markers[2];
+        // Device timestamp of the next sample read from ring
+        uint64_t ring_timestamp[2] = {0};
+        std::atomic<uint64_t> overflows{0};
+        std::atomic<uint64_t> dropped_samples{0};
+    } rx_thread;
+
+    // Stream gap or drop reported while recording, stored in capture sidecar
+    struct recording_event {
+        // "gap" (samples missing), "discontinuity" (timestamp went back, e.g. after stream
+        // rebuild or PPS counter reset), "stream_status" (LimeSuite drops) or "disk_overflow"
+        const char* type;
+        int channel;
+        // Sample index in capture file where event was noticed
+        uint64_t sample;
+        uint64_t timestamp;
+        // Samples missing from capture for gaps, samples timestamp went back for
+        // discontinuities, 0 for stream status events
+        uint64_t missing;
+        uint64_t dropped_packets;
+        uint64_t overrun;
+    };
+
+    // Raw capture written by recording thread instead of output ports
+    struct recording_data {
+        std::string filename;
+        bool active = false;
+        std::atomic<bool> running{false};
+        std::thread thread;
+        disk_recorder file[2];
+        std::string file_names[2];
+        uint64_t start_timestamp[2] = {0};
+        // Device timestamp expected for the next recorded sample, kept over stream rebuild
+        uint64_t next_timestamp[2] = {0};
+        std::time_t start_time = 0;
+        // Host rate read back from device, after channelizer decimation
+        double sample_rate = 0;
+        std::vector<recording_event> events;
+        bool events_truncated = false;
+    } recording;
+
+    // Samples received on one MIMO channel in excess of the other one
+    struct mimo_carry_data {
+        std::vector<char> buffer[2];
+        uint64_t timestamp[2] = {0};
+    } mimo_carry;
+
+    stream_telemetry telemetry;
+
+    // Sequence of the last published health snapshot
+    struct health_data {
+        bool connected = false;
+        uint64_t sequence = 0;
+    } health;
+
+    // Hops come from stream tags, messages and control worker, getters read from Python
+    struct hop_data {
+        std::atomic<double> last_duration{0};
+        std::atomic<uint64_t> count{0};
+    } hop_stats;
+
+    // Host side DC/IQ correction of each device channel
+    struct iq_data {
+        std::atomic<bool> enabled{false};
+        float tracking_step = 0.01f;
+        iq_corrector corrector[2];
+    } iq_correction;
+
+    void correct_iq(int output, void* samples, int items);
+    void update_iq_tracking();
+
+    // Narrowband channels cut out of monitored band by LMS7002M
+    struct channelizer_data {
+        bool enabled = false;
+        // Sample rate before hardware decimation (monitored band)
+        double wide_rate = 0;
+        int decimation = 1;
+        bool active[2] = {false, false};
+        double freq[2] = {0, 0};
+        double bandwidth[2] = {0, 0};
+    } channelizer;
+
+    double channelizer_offset(double channel_freq, double bandwidth, double wide_rate);
+    void apply_channelizer_rate();
+    void apply_channelizer(int channel);
+
+    void hop_message(pmt::pmt_t msg);
+
+    // Commands received on "command" port
+    std::shared_ptr<command_guard> commands = std::make_shared<command_guard>();
+    void command_message(pmt::pmt_t msg);
+    void apply_command(const control_command& cmd);
+
     std::chrono::high_resolution_clock::time_point t1, t2;
 
     void print_stream_stats(lms_stream_status_t status);
 
-    void add_time_tag(int channel, lms_stream_meta_t meta);
+    int read_stream_status(int channel, lms_stream_status_t* status);
+    uint64_t dropped_packets();
+
+    void poll_stream_status(uint64_t next_timestamp);
+
+    void publish_telemetry(int channel, const lms_stream_status_t& status);
+
+    void update_health();
+
+    void update_latency(uint64_t next_timestamp, const lms_stream_status_t& status);
+
+    void update_tag_values();
+
+    void mark_retune();
+
+    void tag_retunes(int channels, const uint64_t timestamp[2], int items);
+
+    bool schedule_at(double rx_time, control_worker::command cmd);
+
+    pmt::pmt_t make_time_value(int channel, uint64_t timestamp);
+
+    void add_time_tag(int channel, uint64_t timestamp, uint64_t offset);
+
+    void add_PPS_time_tag(int channel, uint64_t PPS_samplestamp, uint64_t offset);
+
+    void pps_track(int channel, uint64_t counter, uint64_t expected, uint64_t offset);
 
-    void add_PPS_time_tag(int channel, uint64_t PPS_samplestamp);
+    void pps_edge(int channel, int64_t edge_offset, uint64_t tag_offset, bool reset);
+
+    int pps_read_size(int noutput_items, bool& in_window);
+    int recv_pps(void* buffers[2], int items, lms_stream_meta_t rx_metadata[2]);
+
+    void pps_lookahead(int channel, uint64_t first_index, size_t items);
+
+    int packet_samples();
+    int packets_to_batch();
+    // Minimum output buffer last requested by align_to_packets()
+    int aligned_buffer = 0;
+    void align_to_packets();
+
+    void start_rx_thread();
+    void stop_rx_thread();
+    void rx_thread_loop();
+    void rx_thread_recv_mimo(std::vector<char> scratch[2],
+                             uint64_t next_timestamp[2],
+                             bool first[2],
+                             bool overflow[2]);
+    int recv_mimo(void* buffers[2], int items, lms_stream_meta_t rx_metadata[2]);
+    int work_from_ring(int noutput_items, gr_vector_void_star& output_items);
+
+    size_t stream_item_size();
+    bool open_recording();
+    void close_recording();
+    void recording_loop();
+    void add_recording_event(const recording_event& event);
+    void write_recording_sidecar();
 
     public:
     source_impl(std::string serial,
                 int channel_mode,
                 const std::string& filename,
-                bool enable_PPS_mode);
+                bool enable_PPS_mode,
+                int data_format);
     ~source_impl();
 
     int general_work(int noutput_items,
@@ -76,9 +336,12 @@ class source_impl : public source {
 
     bool stop(void);
 
-    inline gr::io_signature::sptr args_to_io_signature(int channel_mode);
+    inline gr::io_signature::sptr args_to_io_signature(int channel_mode, int data_format);
 
     void init_stream(int device_number, int channel);
+    void update_stream_settings();
+    void rebuild_stream();
+    void start_streams();
     void release_stream(int device_number, lms_stream_t* stream);
 
     double set_center_freq(double freq, size_t chan = 0);
@@ -97,12 +360,86 @@ class source_impl : public source {
 
     void set_oversampling(int oversample);
 
+    double set_channelizer(double channel_freq, double bandwidth, int decimation, int channel = 0);
+
     void set_buffer_size(uint32_t size);
 
     void calibrate(double bandw, int channel = 0);
 
+    void set_calibration_cache(bool enable);
+
+    void set_iq_correction(bool enable, float tracking_step = 0.01);
+
+    std::vector<gr_complex> get_iq_correction(int channel = 0);
+
+    bool save_snapshot(const std::string& filename);
+
     void set_tcxo_dac(uint16_t dacVal = 125);
 
+    void set_latency_profile(int profile);
+
+    void set_throughput_vs_latency(double value);
+
+    double get_throughput_vs_latency() { return stored.throughput_vs_latency; }
+
+    uint32_t get_fifo_size() { return stored.stream_FIFO_size; }
+
+    double get_stream_latency() { return stream_latency; }
+
+    void set_telemetry_rate(double rate_hz) { telemetry.set_rate(rate_hz); }
+
+    double get_telemetry_rate() { return telemetry.get_rate(); }
+
+    void set_health_monitor(double rate_hz);
+
+    double get_temperature();
+
+    bool get_clock_locked();
+
+    int set_hop_table(const std::vector<double>& freqs);
+
+    double hop(int index);
+
+    void hop_at(int index, double rx_time);
+
+    double get_last_hop_duration() { return hop_stats.last_duration; }
+
+    uint64_t get_hop_count() { return hop_stats.count; }
+
+    void set_tag_bundle(bool enable);
+
+    void set_sync_start(bool enable, double fref_MHz = 0);
+
+    std::vector<double> get_sync_offsets();
+
+    void set_pps_disciplined(bool enable);
+
+    void set_pps_time(uint64_t seconds);
+
+    double get_pps_rate_error() { return pps.rate_error_ppm; }
+
+    uint64_t get_pps_edges() { return pps.edges; }
+
+    bool set_center_freq_at(double freq, double rx_time);
+
+    bool set_nco_at(float nco_freq, int channel, double rx_time);
+
+    void clear_timed_commands();
+
+    void set_rx_thread(bool enable, uint32_t ring_size = 0, int cpu = -1);
+
+    uint32_t get_ring_size();
+
+    uint64_t get_ring_overflows() { return rx_thread.overflows; }
+
+    uint64_t get_ring_dropped_samples() { return rx_thread.dropped_samples; }
+
+    void set_recording(const std::string& filename) { recording.filename = filename; }
+
+    uint64_t get_recorded_samples() { return recording.file[0].samples(); }
+
+    uint64_t get_recording_dropped_samples() { return recording.file[0].dropped_samples(); }
+
     void setFpgaDelaySamples(int fpgaDelaySamples) { fpga_delay_samples = fpgaDelaySamples; }
 
     bool set_ext_clk(double fref_Mhz);
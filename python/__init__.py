@@ -23,12 +23,15 @@ This is the GNU Radio LIMESDR module. Place your Python package
 description here (python/__init__.py).
 '''
 
-# import swig generated symbols into the limesdr namespace
+# import pybind11 (GNU Radio 3.9+) or swig generated symbols into the limesdr namespace
 try:
-	# this might fail if the module is python-only
-	from limesdr_swig import *
+	from .limesdr_python import *
 except ImportError:
-	pass
+	try:
+		# this might fail if the module is python-only
+		from .limesdr_swig import *
+	except ImportError:
+		pass
 
 # import any pure python here
 #
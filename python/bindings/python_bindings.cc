@@ -0,0 +1,41 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pybind11/pybind11.h>
+
+namespace py = pybind11;
+
+// Block bindings are split per public header, same as the SWIG interface
+void bind_source(py::module& m);
+void bind_sink(py::module& m);
+#ifdef ENABLE_RFE
+void bind_rfe(py::module& m);
+#endif
+
+PYBIND11_MODULE(limesdr_python, m) {
+    // Blocks derive from gr.basic_block, its bindings must be loaded first
+    py::module::import("gnuradio.gr");
+
+    bind_source(m);
+    bind_sink(m);
+#ifdef ENABLE_RFE
+    bind_rfe(m);
+#endif
+}
@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <limesdr/rfe.h>
+
+void bind_rfe(py::module& m) {
+    using rfe = gr::limesdr::rfe;
+
+    // Board IDs, ports and modes are passed as integers from GRC, constructor takes chars
+    py::class_<rfe>(m, "rfe")
+        .def(py::init([](int comm_type,
+                         std::string device,
+                         std::string config_file,
+                         int IDRX,
+                         int IDTX,
+                         int PortRX,
+                         int PortTX,
+                         int Mode,
+                         int Notch,
+                         int Atten) {
+                 return new rfe(comm_type,
+                                device,
+                                config_file,
+                                (char)IDRX,
+                                (char)IDTX,
+                                (char)PortRX,
+                                (char)PortTX,
+                                (char)Mode,
+                                (char)Notch,
+                                (char)Atten);
+             }),
+             py::arg("comm_type"),
+             py::arg("device"),
+             py::arg("config_file"),
+             py::arg("IDRX"),
+             py::arg("IDTX"),
+             py::arg("PortRX"),
+             py::arg("PortTX"),
+             py::arg("Mode"),
+             py::arg("Notch"),
+             py::arg("Atten"))
+        .def("change_mode", &rfe::change_mode, py::arg("mode"))
+        .def("set_fan", &rfe::set_fan, py::arg("enable"))
+        .def("set_attenuation", &rfe::set_attenuation, py::arg("attenuation"))
+        .def("set_notch", &rfe::set_notch, py::arg("enable"))
+        .def("set_tdd", &rfe::set_tdd, py::arg("enable"))
+        .def("get_tdd_latency", &rfe::get_tdd_latency)
+        .def("get_tdd_max_latency", &rfe::get_tdd_max_latency)
+        .def("get_cached_state", &rfe::get_cached_state);
+}
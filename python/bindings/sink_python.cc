@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <limesdr/sink.h>
+
+void bind_sink(py::module& m) {
+    using sink = gr::limesdr::sink;
+
+    py::class_<sink, gr::block, gr::basic_block, std::shared_ptr<sink>>(m, "sink")
+        .def(py::init(&sink::make),
+             py::arg("serial"),
+             py::arg("channel_mode"),
+             py::arg("filename"),
+             py::arg("length_tag_name"),
+             py::arg("data_format") = 0)
+        .def("set_center_freq", &sink::set_center_freq, py::arg("freq"), py::arg("chan") = 0)
+        .def("set_antenna", &sink::set_antenna, py::arg("antenna"), py::arg("channel") = 0)
+        .def("set_nco", &sink::set_nco, py::arg("nco_freq"), py::arg("channel"))
+        .def("set_bandwidth",
+             &sink::set_bandwidth,
+             py::arg("analog_bandw"),
+             py::arg("channel") = 0)
+        .def("set_digital_filter",
+             &sink::set_digital_filter,
+             py::arg("digital_bandw"),
+             py::arg("channel"))
+        .def("set_gain", &sink::set_gain, py::arg("gain_dB"), py::arg("channel") = 0)
+        .def("set_sample_rate", &sink::set_sample_rate, py::arg("rate"))
+        .def("set_oversampling", &sink::set_oversampling, py::arg("oversample"))
+        .def("calibrate", &sink::calibrate, py::arg("bandw"), py::arg("channel") = 0)
+        .def("set_calibration_cache", &sink::set_calibration_cache, py::arg("enable"))
+        .def("save_snapshot", &sink::save_snapshot, py::arg("filename"))
+        .def("set_buffer_size", &sink::set_buffer_size, py::arg("size"))
+        .def("set_latency_profile", &sink::set_latency_profile, py::arg("profile"))
+        .def("set_throughput_vs_latency", &sink::set_throughput_vs_latency, py::arg("value"))
+        .def("get_throughput_vs_latency", &sink::get_throughput_vs_latency)
+        .def("get_fifo_size", &sink::get_fifo_size)
+        .def("get_stream_latency", &sink::get_stream_latency)
+        .def("set_telemetry_rate", &sink::set_telemetry_rate, py::arg("rate_hz"))
+        .def("get_telemetry_rate", &sink::get_telemetry_rate)
+        .def("set_health_monitor", &sink::set_health_monitor, py::arg("rate_hz"))
+        .def("get_temperature", &sink::get_temperature)
+        .def("get_clock_locked", &sink::get_clock_locked)
+        .def("set_hop_table", &sink::set_hop_table, py::arg("freqs"))
+        .def("hop", &sink::hop, py::arg("index"))
+        .def("get_last_hop_duration", &sink::get_last_hop_duration)
+        .def("get_hop_count", &sink::get_hop_count)
+        .def("set_tx_thread",
+             &sink::set_tx_thread,
+             py::arg("enable"),
+             py::arg("ring_size") = 0,
+             py::arg("fill_level") = 0.5,
+             py::arg("cpu") = -1)
+        .def("get_ring_size", &sink::get_ring_size)
+        .def("get_underruns", &sink::get_underruns)
+        .def("set_late_policy", &sink::set_late_policy, py::arg("policy"))
+        .def("get_late_count", &sink::get_late_count)
+        .def("get_last_lateness", &sink::get_last_lateness)
+        .def("set_sync_start", &sink::set_sync_start, py::arg("enable"), py::arg("fref_MHz") = 0)
+        .def("get_sync_offsets", &sink::get_sync_offsets)
+        .def("set_tcxo_dac", &sink::set_tcxo_dac, py::arg("dacVal") = 125);
+}
+
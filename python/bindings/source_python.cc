@@ -0,0 +1,119 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Lime Microsystems info@limemicro.com
+ *
+ * GNU Radio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * GNU Radio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <limesdr/source.h>
+
+void bind_source(py::module& m) {
+    using source = gr::limesdr::source;
+
+    py::class_<source, gr::block, gr::basic_block, std::shared_ptr<source>>(m, "source")
+        .def(py::init(&source::make),
+             py::arg("serial"),
+             py::arg("channel_mode"),
+             py::arg("filename"),
+             py::arg("enable_PPS_mode"),
+             py::arg("data_format") = 0)
+        .def("set_ext_clk", &source::set_ext_clk, py::arg("fref_Mhz"))
+        .def("disable_ext_clk", &source::disable_ext_clk)
+        .def("setFpgaDelaySamples", &source::setFpgaDelaySamples, py::arg("fpgaDelaySamples"))
+        .def("set_center_freq", &source::set_center_freq, py::arg("freq"), py::arg("chan") = 0)
+        .def("set_antenna", &source::set_antenna, py::arg("antenna"), py::arg("channel") = 0)
+        .def("set_nco", &source::set_nco, py::arg("nco_freq"), py::arg("channel"))
+        .def("set_bandwidth",
+             &source::set_bandwidth,
+             py::arg("analog_bandw"),
+             py::arg("channel") = 0)
+        .def("set_digital_filter",
+             &source::set_digital_filter,
+             py::arg("digital_bandw"),
+             py::arg("channel"))
+        .def("set_gain", &source::set_gain, py::arg("gain_dB"), py::arg("channel") = 0)
+        .def("set_sample_rate", &source::set_sample_rate, py::arg("rate"))
+        .def("set_oversampling", &source::set_oversampling, py::arg("oversample"))
+        .def("set_channelizer",
+             &source::set_channelizer,
+             py::arg("channel_freq"),
+             py::arg("bandwidth"),
+             py::arg("decimation"),
+             py::arg("channel") = 0)
+        .def("calibrate", &source::calibrate, py::arg("bandw"), py::arg("channel") = 0)
+        .def("set_calibration_cache", &source::set_calibration_cache, py::arg("enable"))
+        .def("set_iq_correction",
+             &source::set_iq_correction,
+             py::arg("enable"),
+             py::arg("tracking_step") = 0.01)
+        .def("get_iq_correction", &source::get_iq_correction, py::arg("channel") = 0)
+        .def("save_snapshot", &source::save_snapshot, py::arg("filename"))
+        .def("set_buffer_size", &source::set_buffer_size, py::arg("size"))
+        .def("set_rx_thread",
+             &source::set_rx_thread,
+             py::arg("enable"),
+             py::arg("ring_size") = 0,
+             py::arg("cpu") = -1)
+        .def("get_ring_size", &source::get_ring_size)
+        .def("get_ring_overflows", &source::get_ring_overflows)
+        .def("get_ring_dropped_samples", &source::get_ring_dropped_samples)
+        .def("set_recording", &source::set_recording, py::arg("filename"))
+        .def("get_recorded_samples", &source::get_recorded_samples)
+        .def("get_recording_dropped_samples", &source::get_recording_dropped_samples)
+        .def("set_latency_profile", &source::set_latency_profile, py::arg("profile"))
+        .def("set_throughput_vs_latency", &source::set_throughput_vs_latency, py::arg("value"))
+        .def("get_throughput_vs_latency", &source::get_throughput_vs_latency)
+        .def("get_fifo_size", &source::get_fifo_size)
+        .def("get_stream_latency", &source::get_stream_latency)
+        .def("set_telemetry_rate", &source::set_telemetry_rate, py::arg("rate_hz"))
+        .def("get_telemetry_rate", &source::get_telemetry_rate)
+        .def("set_health_monitor", &source::set_health_monitor, py::arg("rate_hz"))
+        .def("get_temperature", &source::get_temperature)
+        .def("get_clock_locked", &source::get_clock_locked)
+        .def("set_hop_table", &source::set_hop_table, py::arg("freqs"))
+        .def("hop", &source::hop, py::arg("index"))
+        .def("hop_at", &source::hop_at, py::arg("index"), py::arg("rx_time"))
+        .def("get_last_hop_duration", &source::get_last_hop_duration)
+        .def("get_hop_count", &source::get_hop_count)
+        .def("set_tag_bundle", &source::set_tag_bundle, py::arg("enable"))
+        .def("set_center_freq_at",
+             &source::set_center_freq_at,
+             py::arg("freq"),
+             py::arg("rx_time"))
+        .def("set_nco_at",
+             &source::set_nco_at,
+             py::arg("nco_freq"),
+             py::arg("channel"),
+             py::arg("rx_time"))
+        .def("clear_timed_commands", &source::clear_timed_commands)
+        .def("set_sync_start", &source::set_sync_start, py::arg("enable"), py::arg("fref_MHz") = 0)
+        .def("get_sync_offsets", &source::get_sync_offsets)
+        .def("set_pps_disciplined", &source::set_pps_disciplined, py::arg("enable"))
+        .def("set_pps_time", &source::set_pps_time, py::arg("seconds"))
+        .def("get_pps_rate_error", &source::get_pps_rate_error)
+        .def("get_pps_edges", &source::get_pps_edges)
+        .def("set_tcxo_dac", &source::set_tcxo_dac, py::arg("dacVal") = 125);
+
+    m.def("preopen_devices", &gr::limesdr::preopen_devices, py::arg("serials"));
+    m.def("quiesce_devices", &gr::limesdr::quiesce_devices);
+}
+
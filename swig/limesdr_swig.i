@@ -12,6 +12,8 @@
 #include "limesdr/sink.h"
 %}
 
+%template(limesdr_string_vector) std::vector<std::string>;
+
 %include "limesdr/source.h"
 GR_SWIG_BLOCK_MAGIC2(limesdr, source);
 